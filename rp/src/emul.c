@@ -8,6 +8,7 @@
 
 #include "emul.h"
 
+#include "perf.h"
 #include "reload/systems/oric/src/oric.h"
 
 // Include the target firmware binary.
@@ -55,6 +56,7 @@ size_t __not_in_flash_func(emul_addrlog_count)(void) { return addrlog_count; }
 static void __not_in_flash_func(emul_dma_irqHandlerLookup)(void) {
   uint32_t pending = dma_hw->ints1;
   dma_hw->ints1 = pending;
+  PERF_COUNT(PERF_DMA_IRQS);
 
   while (pending) {
     int chan = __builtin_ctz(pending);
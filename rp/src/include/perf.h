@@ -0,0 +1,72 @@
+/**
+ * File: perf.h
+ * Description: Per-frame hot path counters and cycle timers. They are built
+ * in with PERF_MODE=1, otherwise every macro expands to nothing.
+ */
+
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+
+// Event counters. Each one is bumped from a single core only.
+typedef enum {
+  PERF_TICK_BURSTS = 0,  // oric_tick() calls, an instruction cycle or a skip
+  PERF_IO_HITS,          // CPU accesses decoded to the I/O page
+  PERF_VIA_IRQS,         // Rising edges of the CPU IRQ line
+  PERF_PSG_WRITES,       // AY register writes
+  PERF_TAPE_READS,       // Level changes fetched by the tape player
+  PERF_FATFS_CALLS,      // f_read, f_write and f_sync of the drives
+  PERF_RENDER_LINES,     // Screen lines rendered (core 1)
+  PERF_DMA_IRQS,         // ROM emulation DMA interrupts
+  PERF_NUM_COUNTERS
+} perf_counter_t;
+
+// Cycle timers, read from the SysTick of the core they run on
+typedef enum {
+  PERF_T_CPU = 0,  // Emulation of a frame (core 0)
+  PERF_T_SDCARD,   // Disk and tape SD card updates between frames (core 0)
+  PERF_T_RENDER,   // Screen rendering (core 1)
+  PERF_NUM_TIMERS
+} perf_timer_t;
+
+#if defined(_PERF) && (_PERF != 0)
+
+#include "hardware/structs/systick.h"
+
+extern volatile uint32_t perf_counters[PERF_NUM_COUNTERS];
+extern volatile uint32_t perf_timers[PERF_NUM_TIMERS];
+
+// SysTick of the calling core, counting down from 2^24 - 1 at clk_sys
+static inline uint32_t perf_cycles(void) { return systick_hw->cvr; }
+
+#define PERF_COUNT(c) (perf_counters[(c)]++)
+#define PERF_BEGIN(t) const uint32_t _perf_t0_##t = perf_cycles()
+#define PERF_END(t) \
+  (perf_timers[(t)] += (_perf_t0_##t - perf_cycles()) & 0x00FFFFFFu)
+#define PERF_ADD(t, cycles) (perf_timers[(t)] += (cycles))
+#define PERF_INIT_CORE() perf_init_core()
+#define PERF_FRAME() perf_frame()
+#define PERF_DUMP() perf_dump()
+
+// Start the SysTick of the calling core
+void perf_init_core(void);
+// Close a frame on core 0, keeps what every counter and timer gained since
+// the previous frame in a ring of the last PERF_FRAMES frames
+void perf_frame(void);
+// Write the ring to the UART, rp/tools/perf_decode.py reads it
+void perf_dump(void);
+
+#else
+
+#define PERF_COUNT(c) ((void)0)
+#define PERF_BEGIN(t) ((void)0)
+#define PERF_END(t) ((void)0)
+#define PERF_ADD(t, cycles) ((void)0)
+#define PERF_INIT_CORE() ((void)0)
+#define PERF_FRAME() ((void)0)
+#define PERF_DUMP() ((void)0)
+
+#endif
+
+#endif  // PERF_H
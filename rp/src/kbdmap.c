@@ -136,6 +136,20 @@ void kbdmap_initOric(void) {
   kbdmap_st_gsx_to_ascii[0x62][0] = 0x145;
   kbdmap_st_gsx_to_ascii[0x62][1] = 0x145;
 
+  // Map CLR/HOME (0x47) to the tape program seek.
+  kbdmap_st_gsx_to_ascii[0x47][0] = 0x149;
+  kbdmap_st_gsx_to_ascii[0x47][1] = 0x149;
+
+  // Map keypad ( (0x63) to the performance HUD toggle.
+  kbdmap_st_gsx_to_ascii[0x63][0] = 0x14A;
+  kbdmap_st_gsx_to_ascii[0x63][1] = 0x14A;
+
+#if defined(_PERF) && (_PERF != 0)
+  // Map keypad ) (0x64) to the hot path statistics dump.
+  kbdmap_st_gsx_to_ascii[0x64][0] = 0x14B;
+  kbdmap_st_gsx_to_ascii[0x64][1] = 0x14B;
+#endif
+
   // Map arrow keys.
   kbdmap_st_gsx_to_ascii[0x4B][0] = 0x150;  // LEFT
   kbdmap_st_gsx_to_ascii[0x4B][1] = 0x150;
@@ -155,6 +169,11 @@ void kbdmap_initOric(void) {
   kbdmap_st_gsx_to_ascii_ctrl[0x1F] = 0x13;  // Ctrl+S
   kbdmap_st_gsx_to_ascii_ctrl[0x26] = 0x0C;  // Ctrl+L
   kbdmap_st_gsx_to_ascii_ctrl[0x31] = 0x0E;  // Ctrl+N
+
+#ifdef ORIC_PROFILE
+  // Map Ctrl+keypad * (0x66) to the PC profiler start and save.
+  kbdmap_st_gsx_to_ascii_ctrl[0x66] = 0x14C;
+#endif
 }
 
 bool __not_in_flash_func(kbdmap_isShift)(uint16_t scan_code) {
@@ -0,0 +1,107 @@
+/**
+ * File: perf.c
+ * Description: Ring of per-frame hot path statistics and its UART dump.
+ */
+
+#include "perf.h"
+
+#if defined(_PERF) && (_PERF != 0)
+
+#include <string.h>
+
+#include "hardware/clocks.h"
+#include "pico/stdlib.h"
+
+// Frames kept in the ring, a power of two
+#define PERF_FRAMES 256
+
+// Dump format version, bump it when the layout below changes
+#define PERF_DUMP_VERSION 1
+
+volatile uint32_t perf_counters[PERF_NUM_COUNTERS];
+volatile uint32_t perf_timers[PERF_NUM_TIMERS];
+
+// What a frame added to every counter and timer. Counters saturate at 16
+// bits, timers count clk_sys cycles.
+typedef struct {
+  uint16_t counters[PERF_NUM_COUNTERS];
+  uint32_t timers[PERF_NUM_TIMERS];
+} perf_frame_t;
+
+static perf_frame_t __not_in_flash() perf_ring[PERF_FRAMES];
+static uint32_t perf_num_frames;
+static uint32_t perf_last_counters[PERF_NUM_COUNTERS];
+static uint32_t perf_last_timers[PERF_NUM_TIMERS];
+
+static const char *const perf_names[PERF_NUM_COUNTERS + PERF_NUM_TIMERS] = {
+    "tick_bursts", "io_hits",    "via_irqs",     "psg_writes",
+    "tape_reads",  "fatfs",      "render_lines", "dma_irqs",
+    "cpu_time",    "sd_time",    "render_time"};
+
+void perf_init_core(void) {
+  systick_hw->rvr = 0x00FFFFFFu;
+  systick_hw->cvr = 0;
+  systick_hw->csr = 0x5;  // Enabled, processor clock
+}
+
+void __not_in_flash_func(perf_frame)(void) {
+  // Running totals are never reset, the other core may be bumping its own
+  perf_frame_t *f = &perf_ring[perf_num_frames & (PERF_FRAMES - 1)];
+  for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+    const uint32_t total = perf_counters[i];
+    const uint32_t delta = total - perf_last_counters[i];
+    perf_last_counters[i] = total;
+    f->counters[i] = (uint16_t)(delta > 0xFFFFu ? 0xFFFFu : delta);
+  }
+  for (int i = 0; i < PERF_NUM_TIMERS; i++) {
+    const uint32_t total = perf_timers[i];
+    f->timers[i] = total - perf_last_timers[i];
+    perf_last_timers[i] = total;
+  }
+  perf_num_frames++;
+}
+
+static void perf_put(const void *data, size_t len) {
+  // Raw bytes, no CR/LF translation
+  const uint8_t *p = (const uint8_t *)data;
+  for (size_t i = 0; i < len; i++) {
+    putchar_raw(p[i]);
+  }
+}
+
+// Little endian, as the RP2040 stores them
+static void perf_put_u16(uint16_t v) { perf_put(&v, sizeof(v)); }
+static void perf_put_u32(uint32_t v) { perf_put(&v, sizeof(v)); }
+
+// Layout, little endian:
+//   "PERF", u8 version, u8 counters, u8 timers, u8 0,
+//   u32 clk_sys Hz, u32 frames since boot, u16 frames that follow,
+//   the counter then timer names, each NUL terminated,
+//   per frame, oldest first: u16 per counter, u32 per timer,
+//   "FREP"
+void perf_dump(void) {
+  const uint32_t total = perf_num_frames;
+  const uint32_t num = total < PERF_FRAMES ? total : PERF_FRAMES;
+  const uint8_t header[8] = {'P', 'E', 'R', 'F', PERF_DUMP_VERSION,
+                             PERF_NUM_COUNTERS, PERF_NUM_TIMERS, 0};
+  perf_put(header, sizeof(header));
+  perf_put_u32(clock_get_hz(clk_sys));
+  perf_put_u32(total);
+  perf_put_u16((uint16_t)num);
+  for (int i = 0; i < PERF_NUM_COUNTERS + PERF_NUM_TIMERS; i++) {
+    perf_put(perf_names[i], strlen(perf_names[i]) + 1);
+  }
+  for (uint32_t n = total - num; n != total; n++) {
+    const perf_frame_t *f = &perf_ring[n & (PERF_FRAMES - 1)];
+    for (int i = 0; i < PERF_NUM_COUNTERS; i++) {
+      perf_put_u16(f->counters[i]);
+    }
+    for (int i = 0; i < PERF_NUM_TIMERS; i++) {
+      perf_put_u32(f->timers[i]);
+    }
+  }
+  perf_put("FREP", 4);
+  stdio_flush();
+}
+
+#endif
@@ -186,6 +186,11 @@
 // ~~~
 //     Set and get 6502 registers and flags.
 //
+// ~~~C
+// uint8_t mos6502cpu_opcode_length(uint8_t opcode)
+// ~~~
+//     Return the instruction length in bytes for an opcode.
+//
 //
 // ## zlib/libpng license
 //
@@ -300,6 +305,8 @@ void mos6502cpu_init(mos6502cpu_t* c, const mos6502cpu_desc_t* desc);
 void mos6502cpu_tick(mos6502cpu_t* c);
 // Perform mos6510cpu port IO (only call this if MOS6510CPU_CHECK_IO(c) is true)
 void mos6510cpu_iorq(mos6502cpu_t* c);
+// Instruction length in bytes of an opcode
+uint8_t mos6502cpu_opcode_length(uint8_t opcode);
 // Prepare mos6502cpu_t snapshot for saving
 void mos6502cpu_snapshot_onsave(mos6502cpu_t* snapshot);
 // Fixup mos6502cpu_t snapshot after loading
@@ -599,6 +606,30 @@ void __not_in_flash_func(mos6510cpu_iorq)(mos6502cpu_t* c) {
   }
 }
 
+// Instruction length in bytes, including undocumented opcodes
+static const uint8_t _mos6502cpu_op_len[256] = {
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 00
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 10
+    3, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 20
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 30
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 40
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 50
+    1, 2, 1, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 60
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 70
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // 80
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // 90
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // A0
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // B0
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // C0
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // D0
+    2, 2, 2, 2, 2, 2, 2, 2, 1, 2, 1, 2, 3, 3, 3, 3,  // E0
+    2, 2, 1, 2, 2, 2, 2, 2, 1, 3, 1, 3, 3, 3, 3, 3,  // F0
+};
+
+uint8_t mos6502cpu_opcode_length(uint8_t opcode) {
+  return _mos6502cpu_op_len[opcode];
+}
+
 void mos6502cpu_snapshot_onsave(mos6502cpu_t* snapshot) {
   CHIPS_ASSERT(snapshot);
   snapshot->in_cb = 0;
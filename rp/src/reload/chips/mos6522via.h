@@ -159,6 +159,10 @@ bool mos6522via_get_cb1(mos6522via_t* c);
 
 void mos6522via_set_cb1(mos6522via_t* c, bool state);
 
+// Set CB1 and flag an active edge right away instead of at the next tick,
+// returns the IRQ line
+bool mos6522via_edge_cb1(mos6522via_t* c, bool state);
+
 bool mos6522via_get_cb2(mos6522via_t* c);
 
 void mos6522via_set_cb2(mos6522via_t* c, bool state);
@@ -694,6 +698,22 @@ void mos6522via_set_cb1(mos6522via_t* c, bool state) {
   c->pb.c1_in = state;
 }
 
+bool mos6522via_edge_cb1(mos6522via_t* c, bool state) {
+  mos6522via_set_cb1(c, state);
+  if (c->pb.c1_triggered) {
+    _mos6522via_set_intr(c, MOS6522VIA_IRQ_CB1);
+    if (MOS6522VIA_PCR_CB2_AUTO_HS(c)) {
+      c->pb.c2_out = true;
+    }
+    if (c->intr.ier & MOS6522VIA_IRQ_CB1) {
+      c->intr.ifr |= (1 << 7);
+    }
+    // With input latching on port B the next tick still latches the edge
+    c->pb.c1_triggered = MOS6522VIA_ACR_PB_LATCH_ENABLE(c);
+  }
+  return 0 != (c->intr.ifr & (1 << 7));
+}
+
 inline bool mos6522via_get_cb2(mos6522via_t* c) { return c->pb.c2_out; }
 
 void mos6522via_set_cb2(mos6522via_t* c, bool state) {
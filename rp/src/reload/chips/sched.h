@@ -0,0 +1,136 @@
+#pragma once
+
+// sched.h
+//
+// Cycle based event scheduler. Each device owns one event slot and sets its
+// next deadline as an absolute tick count; the system runs the CPU until the
+// earliest deadline and only then services the devices that are due.
+//
+// With a handful of events a flat array beats a heap or a timing wheel: the
+// earliest deadline is cached in `next`, so checking for due events costs one
+// compare per cycle and the array is scanned only when an event fires or a
+// deadline moves.
+//
+// Tick counts wrap around, deadlines must lie less than 2^31 ticks ahead.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Maximum number of event slots
+#ifndef SCHED_MAX_EVENTS
+#define SCHED_MAX_EVENTS (8)
+#endif
+
+// Scheduler state
+typedef struct {
+  uint32_t next;                        // Earliest pending deadline
+  uint32_t pending;                     // Bit mask of pending events
+  uint32_t deadline[SCHED_MAX_EVENTS];  // Absolute tick of each event
+} sched_t;
+
+// Initialize a scheduler without pending events, now is the current tick
+void sched_init(sched_t* s, uint32_t now);
+
+// Set the absolute deadline of an event, replacing any pending one
+void sched_set(sched_t* s, int event, uint32_t tick);
+
+// Cancel a pending event
+void sched_cancel(sched_t* s, int event);
+
+// Pop the earliest event due at tick now, -1 if none is due
+int sched_pop(sched_t* s, uint32_t now);
+
+// Return true if an event is pending
+static inline bool sched_pending(const sched_t* s, int event) {
+  return (s->pending >> event) & 1;
+}
+
+// Return true if any event is due at tick now
+static inline bool sched_due(const sched_t* s, uint32_t now) {
+  return (int32_t)(now - s->next) >= 0;
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>  // memset
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+// Distance used for `next` while nothing is pending
+#define _SCHED_IDLE (0x40000000u)
+
+static void _sched_update_next(sched_t* s, uint32_t now) {
+  uint32_t next = now + _SCHED_IDLE;
+  for (uint32_t p = s->pending; p; p &= p - 1) {
+    const uint32_t tick = s->deadline[__builtin_ctz(p)];
+    if ((int32_t)(tick - next) < 0) {
+      next = tick;
+    }
+  }
+  s->next = next;
+}
+
+void sched_init(sched_t* s, uint32_t now) {
+  CHIPS_ASSERT(s);
+  memset(s, 0, sizeof(sched_t));
+  s->next = now + _SCHED_IDLE;
+}
+
+void sched_set(sched_t* s, int event, uint32_t tick) {
+  CHIPS_ASSERT(s && (event >= 0) && (event < SCHED_MAX_EVENTS));
+  const bool was_next =
+      sched_pending(s, event) && (s->deadline[event] == s->next);
+  s->deadline[event] = tick;
+  s->pending |= 1u << event;
+  if ((int32_t)(tick - s->next) < 0) {
+    s->next = tick;
+  } else if (was_next) {
+    _sched_update_next(s, tick);
+  }
+}
+
+void sched_cancel(sched_t* s, int event) {
+  CHIPS_ASSERT(s && (event >= 0) && (event < SCHED_MAX_EVENTS));
+  if (!sched_pending(s, event)) {
+    return;
+  }
+  s->pending &= ~(1u << event);
+  if (s->deadline[event] == s->next) {
+    _sched_update_next(s, s->next);
+  }
+}
+
+int sched_pop(sched_t* s, uint32_t now) {
+  CHIPS_ASSERT(s);
+  if (!sched_due(s, now)) {
+    return -1;
+  }
+  // Earliest due event, the lowest slot wins a tie
+  int event = -1;
+  for (uint32_t p = s->pending; p; p &= p - 1) {
+    const int e = __builtin_ctz(p);
+    if ((event < 0) || ((int32_t)(s->deadline[e] - s->deadline[event]) < 0)) {
+      event = e;
+    }
+  }
+  if (event < 0) {
+    // Nothing pending, push the idle deadline ahead
+    s->next = now + _SCHED_IDLE;
+    return -1;
+  }
+  s->pending &= ~(1u << event);
+  _sched_update_next(s, s->deadline[event]);
+  return event;
+}
+
+#endif  // CHIPS_IMPL
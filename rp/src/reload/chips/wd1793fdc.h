@@ -0,0 +1,712 @@
+#pragma once
+
+// wd1793fdc.h
+//
+// Western Digital WD1793 floppy disk controller. The disk is reached through
+// callbacks, so the chip knows nothing about image formats: the board lists
+// the ID fields of the track under the head and reads and writes bytes at the
+// opaque positions given in them.
+//
+// Data transfers run at double density speed (32 cycles per byte at 1 MHz)
+// and set LOST DATA when the CPU misses a byte, step rates follow the r1/r0
+// bits. Rotational latency is not emulated, a sector is found
+// WD1793FDC_SEARCH_CYCLES after the command. A board that fetches tracks in
+// the background reports -1 ID fields until the track is there, and the
+// commands that need it wait.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Register indices
+#define WD1793FDC_REG_CMD (0)     // Command (write) / status (read)
+#define WD1793FDC_REG_TRACK (1)   // Track register
+#define WD1793FDC_REG_SECTOR (2)  // Sector register
+#define WD1793FDC_REG_DATA (3)    // Data register
+
+// Status bits
+#define WD1793FDC_ST_BUSY (1 << 0)
+#define WD1793FDC_ST_INDEX (1 << 1)  // Type I commands
+#define WD1793FDC_ST_DRQ (1 << 1)    // Type II and III commands
+#define WD1793FDC_ST_TRACK0 (1 << 2)
+#define WD1793FDC_ST_LOST_DATA (1 << 2)
+#define WD1793FDC_ST_CRC_ERROR (1 << 3)
+#define WD1793FDC_ST_SEEK_ERROR (1 << 4)
+#define WD1793FDC_ST_RNF (1 << 4)  // Record not found
+#define WD1793FDC_ST_HEAD_LOADED (1 << 5)
+#define WD1793FDC_ST_RECORD_TYPE (1 << 5)  // Deleted data mark read
+#define WD1793FDC_ST_WRITE_PROTECT (1 << 6)
+#define WD1793FDC_ST_NOT_READY (1 << 7)
+
+// Cycles per data byte
+#ifndef WD1793FDC_BYTE_CYCLES
+#define WD1793FDC_BYTE_CYCLES (32)
+#endif
+
+// Cycles from a type II or III command to its ID field
+#ifndef WD1793FDC_SEARCH_CYCLES
+#define WD1793FDC_SEARCH_CYCLES (256)
+#endif
+
+#define WD1793FDC_REVOLUTION_CYCLES (200000)  // 300 rpm
+#define WD1793FDC_INDEX_CYCLES (4000)         // Index pulse width
+#define WD1793FDC_SETTLE_CYCLES (15000)       // Head settle time
+
+// ID field of a sector, as reported by the disk callbacks
+typedef struct {
+  uint8_t track;
+  uint8_t side;
+  uint8_t sector;
+  uint8_t size;  // Size code, the data field holds 128 << size bytes
+  uint8_t crc[2];
+  bool deleted;       // Data field has a deleted data address mark
+  uint32_t data_pos;  // Position of the first data byte, 0 if no data field
+} wd1793fdc_id_t;
+
+// Disk access callbacks, all act on the selected drive and side
+typedef struct {
+  void* user_data;
+  // Return true if a disk is inserted
+  bool (*ready)(void* user_data);
+  // Return true if the inserted disk is write protected
+  bool (*write_protected)(void* user_data);
+  // Move the head one track in (+1) or out (-1), or not at all (0), and
+  // return the head's track
+  uint8_t (*step)(void* user_data, int dir);
+  // Return the number of ID fields on the track under the head, -1 while the
+  // track is not available yet
+  int (*num_ids)(void* user_data);
+  // Get an ID field of the track under the head
+  bool (*get_id)(void* user_data, int index, wd1793fdc_id_t* id);
+  // Return the position of the raw track under the head and its length
+  uint32_t (*track_pos)(void* user_data, uint32_t* len);
+  // Read and write a byte
+  uint8_t (*read)(void* user_data, uint32_t pos);
+  void (*write)(void* user_data, uint32_t pos, uint8_t data);
+  // A command has finished, flush written data
+  void (*done)(void* user_data, bool track_written);
+} wd1793fdc_disk_t;
+
+// WD1793 state
+typedef struct {
+  uint8_t cmd;
+  uint8_t status;  // Error and busy bits, the rest is added on read
+  uint8_t track;
+  uint8_t sector;
+  uint8_t data;
+  bool type1;  // Status register shows the type I bits
+  bool intrq;
+  bool drq;
+  int8_t step_dir;
+  uint8_t phase;
+  int32_t delay;  // Cycles until the next phase
+  uint32_t pos;   // Disk position of the next byte
+  uint32_t count;  // Bytes left in the transfer
+  uint16_t crc;
+  int id_index;  // Next ID field for READ ADDRESS
+  bool rnf_pending;  // Sector not found, waiting for five revolutions
+  uint8_t id_buf[6];
+  uint8_t last_written;
+  bool written;
+  bool track_written;
+  uint32_t rotation;  // Cycles into the current revolution
+  wd1793fdc_disk_t disk;
+} wd1793fdc_t;
+
+// WD1793 interface
+
+// Initialize a new WD1793 instance
+void wd1793fdc_init(wd1793fdc_t* c, const wd1793fdc_disk_t* disk);
+// Reset an existing WD1793 instance
+void wd1793fdc_reset(wd1793fdc_t* c);
+// Tick the WD1793 by a number of cycles
+void wd1793fdc_tick(wd1793fdc_t* c, uint32_t cycles);
+// Read a register
+uint8_t wd1793fdc_read(wd1793fdc_t* c, uint8_t reg);
+// Write a register
+void wd1793fdc_write(wd1793fdc_t* c, uint8_t reg, uint8_t data);
+
+// Return true while a command is running
+static inline bool wd1793fdc_busy(const wd1793fdc_t* c) {
+  return (c->status & WD1793FDC_ST_BUSY) != 0;
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+// Command phases
+enum {
+  _WD1793FDC_IDLE = 0,
+  _WD1793FDC_STEP,
+  _WD1793FDC_VERIFY,
+  _WD1793FDC_SEARCH,
+  _WD1793FDC_READ,
+  _WD1793FDC_READ_CRC,
+  _WD1793FDC_WRITE_START,
+  _WD1793FDC_WRITE,
+  _WD1793FDC_WRITE_CRC,
+  _WD1793FDC_READ_ADDRESS,
+  _WD1793FDC_READ_TRACK,
+  _WD1793FDC_WRITE_TRACK_START,
+  _WD1793FDC_WRITE_TRACK,
+};
+
+// Step rates by r1/r0
+static const int32_t _wd1793fdc_step_cycles[4] = {6000, 12000, 20000, 30000};
+
+static uint16_t _wd1793fdc_crc(uint16_t crc, uint8_t data) {
+  crc ^= (uint16_t)data << 8;
+  for (int i = 0; i < 8; i++) {
+    crc = (uint16_t)((crc & 0x8000) ? ((crc << 1) ^ 0x1021) : (crc << 1));
+  }
+  return crc;
+}
+
+void wd1793fdc_init(wd1793fdc_t* c, const wd1793fdc_disk_t* disk) {
+  CHIPS_ASSERT(c && disk);
+  memset(c, 0, sizeof(*c));
+  c->disk = *disk;
+  c->type1 = true;
+  c->step_dir = 1;
+}
+
+void wd1793fdc_reset(wd1793fdc_t* c) {
+  CHIPS_ASSERT(c);
+  c->cmd = 0;
+  c->status = 0;
+  c->sector = 1;
+  c->type1 = true;
+  c->intrq = false;
+  c->drq = false;
+  c->rnf_pending = false;
+  c->phase = _WD1793FDC_IDLE;
+}
+
+static bool _wd1793fdc_ready(wd1793fdc_t* c) {
+  return c->disk.ready(c->disk.user_data);
+}
+
+static void _wd1793fdc_finish(wd1793fdc_t* c) {
+  c->status &= ~WD1793FDC_ST_BUSY;
+  c->phase = _WD1793FDC_IDLE;
+  c->drq = false;
+  c->intrq = true;
+  if (c->written) {
+    c->disk.done(c->disk.user_data, c->track_written);
+    c->written = false;
+    c->track_written = false;
+  }
+}
+
+// Deliver a byte to the CPU, flag LOST DATA if the last one was not taken
+static void _wd1793fdc_put_byte(wd1793fdc_t* c, uint8_t data) {
+  if (c->drq) {
+    c->status |= WD1793FDC_ST_LOST_DATA;
+  }
+  c->data = data;
+  c->drq = true;
+}
+
+static void _wd1793fdc_write_byte(wd1793fdc_t* c, uint8_t data) {
+  c->disk.write(c->disk.user_data, c->pos++, data);
+  c->written = true;
+}
+
+// Find the ID field of the sector register on the track under the head
+static bool _wd1793fdc_find_sector(wd1793fdc_t* c, wd1793fdc_id_t* id) {
+  const int num_ids = c->disk.num_ids(c->disk.user_data);
+  // C (bit 1) enables the side compare, S (bit 3) is the side to compare
+  const bool side_compare = (c->cmd & 0x02) != 0;
+  const uint8_t side = (c->cmd >> 3) & 1;
+  for (int i = 0; i < num_ids; i++) {
+    if (!c->disk.get_id(c->disk.user_data, i, id)) {
+      continue;
+    }
+    if ((id->track == c->track) && (id->sector == c->sector) &&
+        (!side_compare || (id->side == side)) && id->data_pos) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void _wd1793fdc_start_type1(wd1793fdc_t* c) {
+  c->type1 = true;
+  const int32_t step = _wd1793fdc_step_cycles[c->cmd & 3];
+  switch (c->cmd >> 4) {
+    case 0x0:
+      // RESTORE
+      c->track = 0xFF;
+      c->data = 0;
+      c->step_dir = -1;
+      break;
+    case 0x1:
+      // SEEK
+      break;
+    case 0x2:
+    case 0x3:
+      // STEP
+      break;
+    case 0x4:
+    case 0x5:
+      // STEP IN
+      c->step_dir = 1;
+      break;
+    default:
+      // STEP OUT
+      c->step_dir = -1;
+      break;
+  }
+  c->phase = _WD1793FDC_STEP;
+  c->delay = ((c->cmd >> 4) <= 1) ? 1 : step;
+}
+
+// One step of a type I command, returns true when the head is in place
+static bool _wd1793fdc_step(wd1793fdc_t* c) {
+  const uint8_t op = c->cmd >> 4;
+  if (op == 0x0) {
+    // RESTORE steps out until TRACK 0
+    if (c->disk.step(c->disk.user_data, 0) == 0) {
+      c->track = 0;
+      return true;
+    }
+    c->disk.step(c->disk.user_data, -1);
+    return false;
+  }
+  if (op == 0x1) {
+    // SEEK steps until the track register matches the data register
+    if (c->track == c->data) {
+      return true;
+    }
+    c->step_dir = (c->data > c->track) ? 1 : -1;
+    c->track = (uint8_t)(c->track + c->step_dir);
+    c->disk.step(c->disk.user_data, c->step_dir);
+    return false;
+  }
+  // STEP, STEP IN and STEP OUT move once, u updates the track register
+  if (c->cmd & 0x10) {
+    c->track = (uint8_t)(c->track + c->step_dir);
+  }
+  c->disk.step(c->disk.user_data, c->step_dir);
+  return true;
+}
+
+static void _wd1793fdc_start_type2(wd1793fdc_t* c) {
+  c->type1 = false;
+  if (!_wd1793fdc_ready(c)) {
+    c->status |= WD1793FDC_ST_NOT_READY;
+    _wd1793fdc_finish(c);
+    return;
+  }
+  const bool write = (c->cmd & 0xE0) == 0xA0;
+  if (write && c->disk.write_protected(c->disk.user_data)) {
+    c->status |= WD1793FDC_ST_WRITE_PROTECT;
+    _wd1793fdc_finish(c);
+    return;
+  }
+  c->phase = _WD1793FDC_SEARCH;
+  c->delay = WD1793FDC_SEARCH_CYCLES +
+             ((c->cmd & 0x04) ? WD1793FDC_SETTLE_CYCLES : 0);
+}
+
+static void _wd1793fdc_start_type3(wd1793fdc_t* c) {
+  c->type1 = false;
+  if (!_wd1793fdc_ready(c)) {
+    c->status |= WD1793FDC_ST_NOT_READY;
+    _wd1793fdc_finish(c);
+    return;
+  }
+  uint32_t len = 0;
+  switch (c->cmd & 0xF0) {
+    case 0xC0:
+      // READ ADDRESS
+      c->phase = _WD1793FDC_SEARCH;
+      c->delay = WD1793FDC_SEARCH_CYCLES;
+      break;
+    case 0xE0:
+      // READ TRACK
+      c->pos = c->disk.track_pos(c->disk.user_data, &len);
+      c->count = len;
+      c->phase = _WD1793FDC_READ_TRACK;
+      c->delay = WD1793FDC_SEARCH_CYCLES;
+      break;
+    default:
+      // WRITE TRACK
+      if (c->disk.write_protected(c->disk.user_data)) {
+        c->status |= WD1793FDC_ST_WRITE_PROTECT;
+        _wd1793fdc_finish(c);
+        return;
+      }
+      c->pos = c->disk.track_pos(c->disk.user_data, &len);
+      c->count = len;
+      c->drq = true;
+      c->phase = _WD1793FDC_WRITE_TRACK_START;
+      c->delay = 3 * WD1793FDC_BYTE_CYCLES;
+      break;
+  }
+}
+
+// Found the ID field of a type II command or READ ADDRESS
+static void _wd1793fdc_search(wd1793fdc_t* c) {
+  wd1793fdc_id_t id;
+  if ((c->cmd & 0xF0) == 0xC0) {
+    const int num_ids = c->disk.num_ids(c->disk.user_data);
+    if ((num_ids <= 0) || !c->disk.get_id(c->disk.user_data,
+                                          c->id_index % num_ids, &id)) {
+      c->status |= WD1793FDC_ST_RNF;
+      _wd1793fdc_finish(c);
+      return;
+    }
+    c->id_index = (c->id_index + 1) % num_ids;
+    c->id_buf[0] = id.track;
+    c->id_buf[1] = id.side;
+    c->id_buf[2] = id.sector;
+    c->id_buf[3] = id.size;
+    c->id_buf[4] = id.crc[0];
+    c->id_buf[5] = id.crc[1];
+    c->count = 6;
+    c->phase = _WD1793FDC_READ_ADDRESS;
+    c->delay = WD1793FDC_BYTE_CYCLES;
+    return;
+  }
+  if (!_wd1793fdc_find_sector(c, &id)) {
+    // The real chip gives up after five revolutions
+    if (!c->rnf_pending) {
+      c->rnf_pending = true;
+      c->delay = 5 * WD1793FDC_REVOLUTION_CYCLES;
+      return;
+    }
+    c->rnf_pending = false;
+    c->status |= WD1793FDC_ST_RNF;
+    _wd1793fdc_finish(c);
+    return;
+  }
+  c->pos = id.data_pos;
+  c->count = 128u << (id.size & 3);
+  if ((c->cmd & 0xE0) == 0x80) {
+    // READ SECTOR
+    if (id.deleted) {
+      c->status |= WD1793FDC_ST_RECORD_TYPE;
+    }
+    c->phase = _WD1793FDC_READ;
+    c->delay = WD1793FDC_BYTE_CYCLES;
+  } else {
+    // WRITE SECTOR, the first byte is due 22 bytes after the ID field
+    c->drq = true;
+    c->phase = _WD1793FDC_WRITE_START;
+    c->delay = 22 * WD1793FDC_BYTE_CYCLES;
+  }
+}
+
+// End of a sector, continue with the next one for multiple sector commands
+static void _wd1793fdc_sector_done(wd1793fdc_t* c) {
+  if (c->cmd & 0x10) {
+    c->sector++;
+    c->phase = _WD1793FDC_SEARCH;
+    c->delay = WD1793FDC_SEARCH_CYCLES;
+  } else {
+    _wd1793fdc_finish(c);
+  }
+}
+
+// True if the phase needs the track under the head
+static inline bool _wd1793fdc_uses_track(uint8_t phase) {
+  return (phase == _WD1793FDC_VERIFY) || (phase == _WD1793FDC_SEARCH) ||
+         (phase == _WD1793FDC_READ_TRACK) ||
+         (phase == _WD1793FDC_WRITE_TRACK_START);
+}
+
+static void _wd1793fdc_run_phase(wd1793fdc_t* c) {
+  if (_wd1793fdc_uses_track(c->phase) && _wd1793fdc_ready(c) &&
+      (c->disk.num_ids(c->disk.user_data) < 0)) {
+    // The track is still on its way, look again a little later
+    c->delay = WD1793FDC_INDEX_CYCLES;
+    return;
+  }
+  switch (c->phase) {
+    case _WD1793FDC_STEP:
+      if (_wd1793fdc_step(c)) {
+        if (c->cmd & 0x04) {
+          c->phase = _WD1793FDC_VERIFY;
+          c->delay = WD1793FDC_SETTLE_CYCLES;
+        } else {
+          _wd1793fdc_finish(c);
+        }
+      } else {
+        c->delay = _wd1793fdc_step_cycles[c->cmd & 3];
+      }
+      break;
+
+    case _WD1793FDC_VERIFY: {
+      // Look for an ID field with the track register's number
+      bool found = false;
+      if (_wd1793fdc_ready(c)) {
+        const int num_ids = c->disk.num_ids(c->disk.user_data);
+        wd1793fdc_id_t id;
+        for (int i = 0; (i < num_ids) && !found; i++) {
+          found = c->disk.get_id(c->disk.user_data, i, &id) &&
+                  (id.track == c->track);
+        }
+      }
+      if (!found) {
+        c->status |= WD1793FDC_ST_SEEK_ERROR;
+      }
+      _wd1793fdc_finish(c);
+      break;
+    }
+
+    case _WD1793FDC_SEARCH:
+      _wd1793fdc_search(c);
+      break;
+
+    case _WD1793FDC_READ:
+      _wd1793fdc_put_byte(c, c->disk.read(c->disk.user_data, c->pos++));
+      if (--c->count == 0) {
+        c->phase = _WD1793FDC_READ_CRC;
+        c->delay = 2 * WD1793FDC_BYTE_CYCLES;
+      } else {
+        c->delay = WD1793FDC_BYTE_CYCLES;
+      }
+      break;
+
+    case _WD1793FDC_READ_CRC:
+      _wd1793fdc_sector_done(c);
+      break;
+
+    case _WD1793FDC_WRITE_START:
+      if (c->drq) {
+        // The CPU did not deliver the first byte in time
+        c->status |= WD1793FDC_ST_LOST_DATA;
+        _wd1793fdc_finish(c);
+        break;
+      }
+      // Data address mark, the sync bytes before it are already there
+      c->crc = 0xFFFF;
+      for (int i = 0; i < 3; i++) {
+        c->crc = _wd1793fdc_crc(c->crc, 0xA1);
+      }
+      {
+        const uint8_t mark = (c->cmd & 0x01) ? 0xF8 : 0xFB;
+        c->crc = _wd1793fdc_crc(c->crc, mark);
+        c->disk.write(c->disk.user_data, c->pos - 1, mark);
+      }
+      c->phase = _WD1793FDC_WRITE;
+      // Fall through to write the first byte
+    case _WD1793FDC_WRITE: {
+      uint8_t data = c->data;
+      if (c->drq) {
+        c->status |= WD1793FDC_ST_LOST_DATA;
+        data = 0;
+      }
+      c->crc = _wd1793fdc_crc(c->crc, data);
+      _wd1793fdc_write_byte(c, data);
+      if (--c->count == 0) {
+        c->phase = _WD1793FDC_WRITE_CRC;
+        c->delay = 2 * WD1793FDC_BYTE_CYCLES;
+      } else {
+        c->drq = true;
+        c->delay = WD1793FDC_BYTE_CYCLES;
+      }
+      break;
+    }
+
+    case _WD1793FDC_WRITE_CRC:
+      _wd1793fdc_write_byte(c, (uint8_t)(c->crc >> 8));
+      _wd1793fdc_write_byte(c, (uint8_t)c->crc);
+      _wd1793fdc_sector_done(c);
+      break;
+
+    case _WD1793FDC_READ_ADDRESS:
+      _wd1793fdc_put_byte(c, c->id_buf[6 - c->count]);
+      if (--c->count == 0) {
+        // The track address ends up in the sector register
+        c->sector = c->id_buf[0];
+        c->phase = _WD1793FDC_READ_CRC;
+        c->delay = WD1793FDC_BYTE_CYCLES;
+      } else {
+        c->delay = WD1793FDC_BYTE_CYCLES;
+      }
+      break;
+
+    case _WD1793FDC_READ_TRACK:
+      if (c->count == 0) {
+        _wd1793fdc_finish(c);
+        break;
+      }
+      _wd1793fdc_put_byte(c, c->disk.read(c->disk.user_data, c->pos++));
+      c->count--;
+      c->delay = WD1793FDC_BYTE_CYCLES;
+      break;
+
+    case _WD1793FDC_WRITE_TRACK_START:
+      if (c->drq) {
+        c->status |= WD1793FDC_ST_LOST_DATA;
+        _wd1793fdc_finish(c);
+        break;
+      }
+      c->track_written = true;
+      c->last_written = 0;
+      c->phase = _WD1793FDC_WRITE_TRACK;
+      // Fall through to write the first byte
+    case _WD1793FDC_WRITE_TRACK: {
+      uint8_t data = c->data;
+      if (c->drq) {
+        c->status |= WD1793FDC_ST_LOST_DATA;
+        data = 0x4E;
+      }
+      c->drq = true;
+      c->delay = WD1793FDC_BYTE_CYCLES;
+      // F5 writes a sync byte and presets the CRC, F6 writes an index sync
+      // byte and F7 writes the two CRC bytes
+      if (data == 0xF5) {
+        if (c->last_written != 0xF5) {
+          c->crc = 0xFFFF;
+        }
+        c->crc = _wd1793fdc_crc(c->crc, 0xA1);
+        _wd1793fdc_write_byte(c, 0xA1);
+        c->count--;
+      } else if (data == 0xF6) {
+        _wd1793fdc_write_byte(c, 0xC2);
+        c->count--;
+      } else if (data == 0xF7) {
+        const uint16_t crc = c->crc;
+        _wd1793fdc_write_byte(c, (uint8_t)(crc >> 8));
+        if (c->count > 1) {
+          _wd1793fdc_write_byte(c, (uint8_t)crc);
+          c->count--;
+        }
+        c->count--;
+        c->delay += WD1793FDC_BYTE_CYCLES;
+      } else {
+        c->crc = _wd1793fdc_crc(c->crc, data);
+        _wd1793fdc_write_byte(c, data);
+        c->count--;
+      }
+      c->last_written = data;
+      if (c->count == 0) {
+        _wd1793fdc_finish(c);
+      }
+      break;
+    }
+
+    default:
+      break;
+  }
+}
+
+void wd1793fdc_tick(wd1793fdc_t* c, uint32_t cycles) {
+  c->rotation += cycles;
+  if (c->rotation >= WD1793FDC_REVOLUTION_CYCLES) {
+    c->rotation -= WD1793FDC_REVOLUTION_CYCLES;
+  }
+  if (c->phase == _WD1793FDC_IDLE) {
+    return;
+  }
+  c->delay -= (int32_t)cycles;
+  while ((c->delay <= 0) && (c->phase != _WD1793FDC_IDLE)) {
+    const int32_t overshoot = c->delay;
+    _wd1793fdc_run_phase(c);
+    c->delay += overshoot;
+  }
+}
+
+uint8_t wd1793fdc_read(wd1793fdc_t* c, uint8_t reg) {
+  switch (reg & 3) {
+    case WD1793FDC_REG_CMD: {
+      uint8_t status = c->status;
+      if (!_wd1793fdc_ready(c)) {
+        status |= WD1793FDC_ST_NOT_READY;
+      }
+      if (c->type1) {
+        status &= ~(WD1793FDC_ST_INDEX | WD1793FDC_ST_TRACK0);
+        status |= WD1793FDC_ST_HEAD_LOADED;
+        if (c->disk.write_protected(c->disk.user_data)) {
+          status |= WD1793FDC_ST_WRITE_PROTECT;
+        }
+        if (c->disk.step(c->disk.user_data, 0) == 0) {
+          status |= WD1793FDC_ST_TRACK0;
+        }
+        if (_wd1793fdc_ready(c) && (c->rotation < WD1793FDC_INDEX_CYCLES)) {
+          status |= WD1793FDC_ST_INDEX;
+        }
+      } else if (c->drq) {
+        status |= WD1793FDC_ST_DRQ;
+      }
+      // Reading the status clears the interrupt request
+      c->intrq = false;
+      return status;
+    }
+    case WD1793FDC_REG_TRACK:
+      return c->track;
+    case WD1793FDC_REG_SECTOR:
+      return c->sector;
+    default:
+      c->drq = false;
+      return c->data;
+  }
+}
+
+void wd1793fdc_write(wd1793fdc_t* c, uint8_t reg, uint8_t data) {
+  switch (reg & 3) {
+    case WD1793FDC_REG_CMD:
+      if ((data & 0xF0) == 0xD0) {
+        // FORCE INTERRUPT, only the immediate interrupt (I3) is supported
+        if (c->status & WD1793FDC_ST_BUSY) {
+          c->status &= ~WD1793FDC_ST_BUSY;
+          if (c->written) {
+            c->disk.done(c->disk.user_data, c->track_written);
+            c->written = false;
+            c->track_written = false;
+          }
+        } else {
+          c->type1 = true;
+          c->status = 0;
+        }
+        c->phase = _WD1793FDC_IDLE;
+        c->rnf_pending = false;
+        c->drq = false;
+        c->intrq = (data & 0x08) != 0;
+        break;
+      }
+      if (c->status & WD1793FDC_ST_BUSY) {
+        // Commands other than FORCE INTERRUPT are ignored while busy
+        break;
+      }
+      c->cmd = data;
+      c->status = WD1793FDC_ST_BUSY;
+      c->intrq = false;
+      c->drq = false;
+      if (!(data & 0x80)) {
+        _wd1793fdc_start_type1(c);
+      } else if (!(data & 0x40)) {
+        _wd1793fdc_start_type2(c);
+      } else {
+        _wd1793fdc_start_type3(c);
+      }
+      break;
+    case WD1793FDC_REG_TRACK:
+      c->track = data;
+      break;
+    case WD1793FDC_REG_SECTOR:
+      c->sector = data;
+      break;
+    default:
+      c->data = data;
+      c->drq = false;
+      break;
+  }
+}
+
+#endif  // CHIPS_IMPL
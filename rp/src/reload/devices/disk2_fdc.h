@@ -78,6 +78,10 @@ void disk2_fdc_reset(disk2_fdc_t* sys);
 // Tick the floppy disk controller
 void disk2_fdc_tick(disk2_fdc_t* sys);
 
+// Write back and prefetch tracks, call once per frame outside of the
+// emulation loop
+void disk2_fdc_update(disk2_fdc_t* sys);
+
 uint8_t disk2_fdc_read_byte(disk2_fdc_t* sys, uint8_t addr);
 
 void disk2_fdc_write_byte(disk2_fdc_t* sys, uint8_t addr, uint8_t byte);
@@ -129,6 +133,12 @@ void disk2_fdc_tick(disk2_fdc_t* sys) {
     // disk2_fdd_tick(&sys->fdd[1]);
 }
 
+void disk2_fdc_update(disk2_fdc_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    disk2_fdd_update(&sys->fdd[0]);
+    // disk2_fdd_update(&sys->fdd[1]);
+}
+
 uint8_t disk2_fdc_read_byte(disk2_fdc_t* sys, uint8_t addr) {
     _disk2_fdc_process_soft_switches(sys, addr);
     if (addr & 1) {
@@ -204,6 +214,7 @@ static void _disk2_fdc_process_soft_switches(disk2_fdc_t* sys, uint8_t addr) {
                         fdd->half_track--;
                     }
                 }
+                disk2_fdd_select_track(fdd);
             }
         } break;
     }
@@ -7,6 +7,11 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include "aconfig.h"
+#include "ff.h"
+#include "perf.h"
+#include "settings/settings.h"
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -21,6 +26,38 @@ extern "C" {
 #define DISK2_FDD_BYTES_PER_NIB_TRACK  (DISK2_FDD_SECTORS_PER_TRACK * DISK2_FDD_BYTES_PER_NIB_SECTOR)
 #define DISK2_FDD_NIB_IMAGE_SIZE       (DISK2_FDD_TRACKS_PER_DISK * DISK2_FDD_BYTES_PER_NIB_TRACK)
 
+// 6-and-2 encoding of a sector: 86 bytes of low bit pairs and 256 bytes of high bits
+#define DISK2_FDD_6AND2_AUX  86
+#define DISK2_FDD_6AND2_SIZE (DISK2_FDD_6AND2_AUX + DISK2_FDD_BYTES_PER_SECTOR)
+
+// Volume number written to the address fields of nibbled .dsk tracks
+#define DISK2_FDD_VOLUME 254
+
+// Nibbles searched after an address field for its data field
+#define DISK2_FDD_DATA_SEARCH 48
+
+// Track buffers: the track under the head and the next one in the stepping direction
+#define DISK2_FDD_TRACK_SLOTS 2
+
+// Calls to disk2_fdd_update() without a write before the current track is flushed
+#define DISK2_FDD_FLUSH_IDLE_UPDATES 50
+
+// Tracks are only read and written by disk2_fdd_update(), never from the
+// emulation loop. A step to a track that is in neither buffer just records it:
+// the drive returns sync nibbles and ignores writes until an update, with the
+// head at rest since the previous one, has loaded it. A seek across several
+// tracks therefore loads the track it ends on and no track on the way.
+//
+// Written tracks are written back one whole track per f_write() followed by
+// f_sync(). A dirty track reaches the SD card:
+//   - on the first update after the head steps to another track,
+//   - on the first update after the drive motor stops,
+//   - after DISK2_FDD_FLUSH_IDLE_UPDATES updates without a write (1s at 50 Hz),
+//   - when the disk is removed.
+// Power loss can lose at most the writes of the last second. A loss during a
+// flush can leave that single track torn; other tracks are always either fully
+// old or fully new.
+
 // Disk II floppy disk drive state
 typedef struct {
     bool valid;
@@ -31,10 +68,19 @@ typedef struct {
     bool image_dirty;
     bool write_protected;
     bool nib_image_loaded;
+    bool dsk_image;                              // nib_file holds DOS 3.3 ordered sectors
     uint8_t control_bits;
     uint8_t write_ready;
-    int nib_image_offset;
-    uint8_t* nib_image;
+    FIL nib_file;
+    uint8_t track;                               // Track under the head
+    uint8_t slot;                                // Buffer holding the track under the head, if any
+    bool stepped;                                // The head moved since the last update
+    int8_t slot_track[DISK2_FDD_TRACK_SLOTS];    // Track held by each buffer, -1 if none
+    int8_t prefetch_track;                       // Track to load by disk2_fdd_update(), -1 if none
+    bool slot_dirty[DISK2_FDD_TRACK_SLOTS];      // Buffer written since it was loaded
+    uint16_t idle_updates;                       // Updates since the last write
+    uint32_t bytes_written;                      // Statistics: nibbles written by the Oric
+    uint32_t tracks_flushed;                     // Statistics: tracks written back to the image
 } disk2_fdd_t;
 
 // Disk II floppy disk drive interface
@@ -50,8 +96,9 @@ void disk2_fdd_reset(disk2_fdd_t* sys);
 
 void disk2_fdd_tick(disk2_fdd_t* sys);
 
-// Insert a new disk file
-bool disk2_fdd_insert_disk(disk2_fdd_t* sys, uint8_t* nib_image);
+// Insert the dN.nib or dN.dsk disk image from the SD card, N is index + 1.
+// Read-only files are inserted write protected.
+bool disk2_fdd_insert_disk_sdcard(disk2_fdd_t* sys, int index);
 
 // Remove the disk file
 void disk2_fdd_remove_disk(disk2_fdd_t* sys);
@@ -59,6 +106,13 @@ void disk2_fdd_remove_disk(disk2_fdd_t* sys);
 // Return true if the disk is currently inserted
 bool disk2_fdd_is_disk_inserted(disk2_fdd_t* sys);
 
+// Make the track under the head current, call after half_track changes
+void disk2_fdd_select_track(disk2_fdd_t* sys);
+
+// Write back dirty tracks and load the track under the head or the next one
+// ahead of it, call once per frame outside of the emulation loop
+void disk2_fdd_update(disk2_fdd_t* sys);
+
 void disk2_fdd_set_motor_on(disk2_fdd_t* sys);
 
 void disk2_fdd_set_motor_off(disk2_fdd_t* sys);
@@ -82,6 +136,236 @@ void disk2_fdd_write_byte(disk2_fdd_t* sys, uint8_t byte);
 #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+// Only one drive is wired up, so its track buffers are static
+static uint8_t _disk2_fdd_tracks[DISK2_FDD_TRACK_SLOTS][DISK2_FDD_BYTES_PER_NIB_TRACK]
+    __attribute__((section(".oric_ram")));
+
+static void _disk2_fdd_flush_slots(disk2_fdd_t* sys) {
+    for (int i = 0; i < DISK2_FDD_TRACK_SLOTS; i++) {
+        sys->slot_track[i] = -1;
+        sys->slot_dirty[i] = false;
+    }
+    sys->prefetch_track = -1;
+}
+
+// 6-and-2 disk nibbles
+static const uint8_t _disk2_fdd_gcr62[64] = {
+    0x96, 0x97, 0x9A, 0x9B, 0x9D, 0x9E, 0x9F, 0xA6, 0xA7, 0xAB, 0xAC, 0xAD, 0xAE, 0xAF, 0xB2, 0xB3,
+    0xB4, 0xB5, 0xB6, 0xB7, 0xB9, 0xBA, 0xBB, 0xBC, 0xBD, 0xBE, 0xBF, 0xCB, 0xCD, 0xCE, 0xCF, 0xD3,
+    0xD6, 0xD7, 0xD9, 0xDA, 0xDB, 0xDC, 0xDD, 0xDE, 0xDF, 0xE5, 0xE6, 0xE7, 0xE9, 0xEA, 0xEB, 0xEC,
+    0xED, 0xEE, 0xEF, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF9, 0xFA, 0xFB, 0xFC, 0xFD, 0xFE, 0xFF,
+};
+
+// DOS 3.3 logical sector stored in each physical sector of a .dsk track
+static const uint8_t _disk2_fdd_dos_order[DISK2_FDD_SECTORS_PER_TRACK] = {
+    0x0, 0x7, 0xE, 0x6, 0xD, 0x5, 0xC, 0x4, 0xB, 0x3, 0xA, 0x2, 0x9, 0x1, 0x8, 0xF,
+};
+
+// The two low bits of each byte are stored swapped
+static const uint8_t _disk2_fdd_swap2[4] = {0, 2, 1, 3};
+
+// Disk nibble to 6-bit value, 0xFF for invalid nibbles
+static uint8_t _disk2_fdd_degcr62[256] __attribute__((section(".oric_ram")));
+static uint8_t _disk2_fdd_sector[DISK2_FDD_BYTES_PER_SECTOR] __attribute__((section(".oric_ram")));
+static uint8_t _disk2_fdd_6bit[DISK2_FDD_6AND2_SIZE] __attribute__((section(".oric_ram")));
+
+static void _disk2_fdd_init_tables(void) {
+    memset(_disk2_fdd_degcr62, 0xFF, sizeof(_disk2_fdd_degcr62));
+    for (uint8_t i = 0; i < 64; i++) {
+        _disk2_fdd_degcr62[_disk2_fdd_gcr62[i]] = i;
+    }
+}
+
+static inline uint8_t _disk2_fdd_nibble(const uint8_t* track, uint32_t pos) {
+    return track[pos % DISK2_FDD_BYTES_PER_NIB_TRACK];
+}
+
+static uint8_t* _disk2_fdd_put_bytes(uint8_t* p, uint8_t b0, uint8_t b1, uint8_t b2) {
+    p[0] = b0;
+    p[1] = b1;
+    p[2] = b2;
+    return p + 3;
+}
+
+static uint8_t* _disk2_fdd_put_4and4(uint8_t* p, uint8_t value) {
+    p[0] = (value >> 1) | 0xAA;
+    p[1] = value | 0xAA;
+    return p + 2;
+}
+
+// 342 data nibbles and the checksum nibble of a 256-byte sector
+static uint8_t* _disk2_fdd_encode_data(uint8_t* p, const uint8_t* data) {
+    uint8_t* v = _disk2_fdd_6bit;
+    for (int i = 0; i < DISK2_FDD_6AND2_AUX; i++) {
+        uint8_t aux = _disk2_fdd_swap2[data[i] & 3] | (_disk2_fdd_swap2[data[i + 86] & 3] << 2);
+        if (i + 172 < DISK2_FDD_BYTES_PER_SECTOR) {
+            aux |= _disk2_fdd_swap2[data[i + 172] & 3] << 4;
+        }
+        v[i] = aux;
+    }
+    for (int i = 0; i < DISK2_FDD_BYTES_PER_SECTOR; i++) {
+        v[DISK2_FDD_6AND2_AUX + i] = data[i] >> 2;
+    }
+    uint8_t prev = 0;
+    for (int i = 0; i < DISK2_FDD_6AND2_SIZE; i++) {
+        *p++ = _disk2_fdd_gcr62[v[i] ^ prev];
+        prev = v[i];
+    }
+    *p++ = _disk2_fdd_gcr62[prev];
+    return p;
+}
+
+// Decode the data field nibbles at pos, false on a bad nibble or checksum
+static bool _disk2_fdd_decode_data(const uint8_t* track, uint32_t pos, uint8_t* data) {
+    uint8_t* v = _disk2_fdd_6bit;
+    uint8_t prev = 0;
+    for (int i = 0; i <= DISK2_FDD_6AND2_SIZE; i++) {
+        const uint8_t x = _disk2_fdd_degcr62[_disk2_fdd_nibble(track, pos + i)];
+        if (x == 0xFF) {
+            return false;
+        }
+        if (i == DISK2_FDD_6AND2_SIZE) {
+            return x == prev;
+        }
+        prev ^= x;
+        v[i] = prev;
+        if (i >= DISK2_FDD_6AND2_AUX) {
+            const int n = i - DISK2_FDD_6AND2_AUX;
+            const uint8_t aux = v[n % DISK2_FDD_6AND2_AUX] >> ((n / DISK2_FDD_6AND2_AUX) * 2);
+            data[n] = (uint8_t)((prev << 2) | _disk2_fdd_swap2[aux & 3]);
+        }
+    }
+    return false;
+}
+
+// Build a 16-sector nibble track from the DOS 3.3 ordered sectors of a .dsk image
+static void _disk2_fdd_encode_track(disk2_fdd_t* sys, uint8_t slot, uint8_t track) {
+    uint8_t* p = _disk2_fdd_tracks[slot];
+    const FSIZE_t track_pos = (FSIZE_t)track * DISK2_FDD_BYTES_PER_TRACK;
+    for (uint8_t sector = 0; sector < DISK2_FDD_SECTORS_PER_TRACK; sector++) {
+        UINT bytes_read = 0;
+        FRESULT res = f_lseek(&sys->nib_file, track_pos + _disk2_fdd_dos_order[sector] * DISK2_FDD_BYTES_PER_SECTOR);
+        if (res == FR_OK) {
+            PERF_COUNT(PERF_FATFS_CALLS);
+            res = f_read(&sys->nib_file, _disk2_fdd_sector, DISK2_FDD_BYTES_PER_SECTOR, &bytes_read);
+        }
+        if ((res != FR_OK) || (bytes_read != DISK2_FDD_BYTES_PER_SECTOR)) {
+            DPRINTF("disk2_fdd: track %d sector %d read failed (%d)\n", track, sector, (int)res);
+            memset(_disk2_fdd_sector, 0, DISK2_FDD_BYTES_PER_SECTOR);
+        }
+        // 374 nibbles: gap, address field, gap, data field
+        memset(p, 0xFF, 6);
+        p += 6;
+        p = _disk2_fdd_put_bytes(p, 0xD5, 0xAA, 0x96);
+        p = _disk2_fdd_put_4and4(p, DISK2_FDD_VOLUME);
+        p = _disk2_fdd_put_4and4(p, track);
+        p = _disk2_fdd_put_4and4(p, sector);
+        p = _disk2_fdd_put_4and4(p, DISK2_FDD_VOLUME ^ track ^ sector);
+        p = _disk2_fdd_put_bytes(p, 0xDE, 0xAA, 0xEB);
+        memset(p, 0xFF, 5);
+        p += 5;
+        p = _disk2_fdd_put_bytes(p, 0xD5, 0xAA, 0xAD);
+        p = _disk2_fdd_encode_data(p, _disk2_fdd_sector);
+        p = _disk2_fdd_put_bytes(p, 0xDE, 0xAA, 0xEB);
+    }
+    CHIPS_ASSERT(p == _disk2_fdd_tracks[slot] + DISK2_FDD_BYTES_PER_NIB_TRACK);
+}
+
+// Decode every readable sector of a nibble track back into the .dsk image
+static FRESULT _disk2_fdd_decode_track(disk2_fdd_t* sys, uint8_t slot) {
+    const uint8_t* t = _disk2_fdd_tracks[slot];
+    const FSIZE_t track_pos = (FSIZE_t)sys->slot_track[slot] * DISK2_FDD_BYTES_PER_TRACK;
+    for (uint32_t pos = 0; pos < DISK2_FDD_BYTES_PER_NIB_TRACK; pos++) {
+        if ((t[pos] != 0xD5) || (_disk2_fdd_nibble(t, pos + 1) != 0xAA) || (_disk2_fdd_nibble(t, pos + 2) != 0x96)) {
+            continue;
+        }
+        const uint8_t sector = ((_disk2_fdd_nibble(t, pos + 7) << 1) | 1) & _disk2_fdd_nibble(t, pos + 8);
+        if (sector >= DISK2_FDD_SECTORS_PER_TRACK) {
+            continue;
+        }
+        // The data field follows the address field within a few sync nibbles
+        for (uint32_t d = pos + 14; d < pos + 14 + DISK2_FDD_DATA_SEARCH; d++) {
+            if ((_disk2_fdd_nibble(t, d) != 0xD5) || (_disk2_fdd_nibble(t, d + 1) != 0xAA)) {
+                continue;
+            }
+            if (_disk2_fdd_nibble(t, d + 2) != 0xAD) {
+                break;
+            }
+            if (_disk2_fdd_decode_data(t, d + 3, _disk2_fdd_sector)) {
+                UINT bytes_written = 0;
+                FRESULT res = f_lseek(&sys->nib_file, track_pos + _disk2_fdd_dos_order[sector] * DISK2_FDD_BYTES_PER_SECTOR);
+                if (res == FR_OK) {
+                    PERF_COUNT(PERF_FATFS_CALLS);
+                    res = f_write(&sys->nib_file, _disk2_fdd_sector, DISK2_FDD_BYTES_PER_SECTOR, &bytes_written);
+                }
+                if ((res == FR_OK) && (bytes_written != DISK2_FDD_BYTES_PER_SECTOR)) {
+                    res = FR_DISK_ERR;
+                }
+                if (res != FR_OK) {
+                    return res;
+                }
+            }
+            break;
+        }
+    }
+    return FR_OK;
+}
+
+// Write a dirty buffer back to the image, as one whole track for .nib images
+// and as the sectors decoded from it for .dsk images
+static void _disk2_fdd_write_track(disk2_fdd_t* sys, uint8_t slot) {
+    if (!sys->slot_dirty[slot]) {
+        return;
+    }
+    sys->slot_dirty[slot] = false;
+    const int8_t track = sys->slot_track[slot];
+    FRESULT res;
+    if (sys->dsk_image) {
+        res = _disk2_fdd_decode_track(sys, slot);
+    } else {
+        UINT bytes_written = 0;
+        res = f_lseek(&sys->nib_file, (FSIZE_t)track * DISK2_FDD_BYTES_PER_NIB_TRACK);
+        if (res == FR_OK) {
+            PERF_COUNT(PERF_FATFS_CALLS);
+            res = f_write(&sys->nib_file, _disk2_fdd_tracks[slot], DISK2_FDD_BYTES_PER_NIB_TRACK, &bytes_written);
+        }
+        if ((res == FR_OK) && (bytes_written != DISK2_FDD_BYTES_PER_NIB_TRACK)) {
+            res = FR_DISK_ERR;
+        }
+    }
+    if (res == FR_OK) {
+        PERF_COUNT(PERF_FATFS_CALLS);
+        res = f_sync(&sys->nib_file);
+    }
+    if (res != FR_OK) {
+        DPRINTF("disk2_fdd: track %d write failed (%d)\n", track, (int)res);
+        return;
+    }
+    sys->tracks_flushed++;
+}
+
+// Read a whole track into a buffer. A failed read leaves an unformatted track.
+// Only called between frames.
+static void _disk2_fdd_load_track(disk2_fdd_t* sys, uint8_t slot, uint8_t track) {
+    _disk2_fdd_write_track(sys, slot);
+    sys->slot_track[slot] = (int8_t)track;
+    if (sys->dsk_image) {
+        _disk2_fdd_encode_track(sys, slot, track);
+        return;
+    }
+    uint8_t* buf = _disk2_fdd_tracks[slot];
+    UINT bytes_read = 0;
+    FRESULT res = f_lseek(&sys->nib_file, (FSIZE_t)track * DISK2_FDD_BYTES_PER_NIB_TRACK);
+    if (res == FR_OK) {
+        PERF_COUNT(PERF_FATFS_CALLS);
+        res = f_read(&sys->nib_file, buf, DISK2_FDD_BYTES_PER_NIB_TRACK, &bytes_read);
+    }
+    if ((res != FR_OK) || (bytes_read != DISK2_FDD_BYTES_PER_NIB_TRACK)) {
+        DPRINTF("disk2_fdd: track %d read failed (%d)\n", track, (int)res);
+        memset(buf, 0, DISK2_FDD_BYTES_PER_NIB_TRACK);
+    }
+}
+
 void disk2_fdd_init(disk2_fdd_t* sys) {
     CHIPS_ASSERT(sys && !sys->valid);
     memset(sys, 0, sizeof(disk2_fdd_t));
@@ -95,10 +379,13 @@ void disk2_fdd_init(disk2_fdd_t* sys) {
     sys->control_bits = 0;
     sys->write_ready = 0x80;
     sys->nib_image_loaded = false;
+    _disk2_fdd_flush_slots(sys);
+    _disk2_fdd_init_tables();
 }
 
 void disk2_fdd_discard(disk2_fdd_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
+    disk2_fdd_remove_disk(sys);
     sys->valid = false;
 }
 
@@ -114,18 +401,63 @@ void disk2_fdd_tick(disk2_fdd_t* sys) {
     }
 }
 
-bool disk2_fdd_insert_disk(disk2_fdd_t* sys, uint8_t* nib_image) {
+bool disk2_fdd_insert_disk_sdcard(disk2_fdd_t* sys, int index) {
     CHIPS_ASSERT(sys && sys->valid);
-    sys->nib_image_offset = 0;
-    sys->nib_image = nib_image;
+    SettingsConfigEntry* folder = settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_FOLDER);
+    const char* folder_name = folder ? folder->value : "/oric";
+    char path[256];
+    FILINFO info;
+    bool dsk_image = false;
+    int path_len = snprintf(path, sizeof(path), "%s/d%d.nib", folder_name, index + 1);
+    if ((path_len <= 0) || ((size_t)path_len >= sizeof(path))) {
+        return false;
+    }
+    if ((f_stat(path, &info) != FR_OK) || (info.fsize != DISK2_FDD_NIB_IMAGE_SIZE)) {
+        // Fall back to a sector image, nibbled track by track
+        path[path_len - 3] = 'd';
+        path[path_len - 2] = 's';
+        path[path_len - 1] = 'k';
+        if ((f_stat(path, &info) != FR_OK) || (info.fsize != DISK2_FDD_DSK_IMAGE_SIZE)) {
+            return false;
+        }
+        dsk_image = true;
+    }
+
+    disk2_fdd_remove_disk(sys);
+    sys->dsk_image = dsk_image;
+    sys->write_protected = (info.fattrib & AM_RDO) != 0;
+    FRESULT res = FR_DENIED;
+    if (!sys->write_protected) {
+        res = f_open(&sys->nib_file, path, FA_READ | FA_WRITE);
+    }
+    if (res != FR_OK) {
+        sys->write_protected = true;
+        res = f_open(&sys->nib_file, path, FA_READ);
+    }
+    if (res != FR_OK) {
+        DPRINTF("disk2_fdd: open failed (%d): %s\n", (int)res, path);
+        return false;
+    }
     sys->nib_image_loaded = true;
+    sys->idle_updates = 0;
+    sys->track = sys->half_track / 2;
+    sys->slot = 0;
+    _disk2_fdd_load_track(sys, 0, sys->track);
+    DPRINTF("disk2_fdd: disk inserted: %s\n", path);
     return true;
 }
 
 void disk2_fdd_remove_disk(disk2_fdd_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
+    if (sys->nib_image_loaded) {
+        for (uint8_t i = 0; i < DISK2_FDD_TRACK_SLOTS; i++) {
+            _disk2_fdd_write_track(sys, i);
+        }
+        f_close(&sys->nib_file);
+    }
     sys->nib_image_loaded = false;
     sys->image_dirty = false;
+    _disk2_fdd_flush_slots(sys);
 }
 
 bool disk2_fdd_is_disk_inserted(disk2_fdd_t* sys) {
@@ -133,6 +465,68 @@ bool disk2_fdd_is_disk_inserted(disk2_fdd_t* sys) {
     return sys->nib_image_loaded;
 }
 
+// True if a buffer holds the track under the head
+static inline bool _disk2_fdd_track_ready(const disk2_fdd_t* sys) {
+    return sys->slot_track[sys->slot] == (int8_t)sys->track;
+}
+
+void disk2_fdd_select_track(disk2_fdd_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    const uint8_t track = sys->half_track / 2;
+    if (!sys->nib_image_loaded || (track == sys->track)) {
+        return;
+    }
+    const int dir = (track > sys->track) ? 1 : -1;
+    sys->track = track;
+    sys->stepped = true;
+    // A track in neither buffer waits for disk2_fdd_update()
+    if (sys->slot_track[sys->slot ^ 1] == track) {
+        sys->slot ^= 1;
+    }
+    const int next = track + dir;
+    sys->prefetch_track = ((next >= 0) && (next < DISK2_FDD_TRACKS_PER_DISK)) ? (int8_t)next : -1;
+}
+
+void disk2_fdd_update(disk2_fdd_t* sys) {
+    CHIPS_ASSERT(sys && sys->valid);
+    if (!sys->nib_image_loaded) {
+        return;
+    }
+    const bool ready = _disk2_fdd_track_ready(sys);
+    // The head left these tracks
+    for (uint8_t i = 0; i < DISK2_FDD_TRACK_SLOTS; i++) {
+        if (!ready || (i != sys->slot)) {
+            _disk2_fdd_write_track(sys, i);
+        }
+    }
+    if (sys->idle_updates < DISK2_FDD_FLUSH_IDLE_UPDATES) {
+        sys->idle_updates++;
+    }
+    if (!sys->motor_state || (sys->idle_updates >= DISK2_FDD_FLUSH_IDLE_UPDATES)) {
+        _disk2_fdd_write_track(sys, sys->slot);
+    }
+
+    // One track per update, and none while the head is still moving
+    const bool stepping = sys->stepped;
+    sys->stepped = false;
+    if (stepping) {
+        return;
+    }
+    if (!ready) {
+        sys->slot ^= 1;
+        _disk2_fdd_load_track(sys, sys->slot, sys->track);
+        return;
+    }
+    const int8_t track = sys->prefetch_track;
+    if (track < 0) {
+        return;
+    }
+    sys->prefetch_track = -1;
+    if (sys->slot_track[sys->slot ^ 1] != track) {
+        _disk2_fdd_load_track(sys, sys->slot ^ 1, (uint8_t)track);
+    }
+}
+
 void disk2_fdd_set_motor_on(disk2_fdd_t* sys) {
     CHIPS_ASSERT(sys && sys->valid);
     sys->motor_state = 0x20;
@@ -164,10 +558,11 @@ uint8_t disk2_fdd_read_byte(disk2_fdd_t* sys) {
                 return 0xFF;
             }
             _disk2_fdd_update_offset(sys);
-            return *(sys->nib_image + (sys->half_track / 2) * DISK2_FDD_BYTES_PER_NIB_TRACK + sys->offset);
+            // Sync nibbles until disk2_fdd_update() has loaded the track
+            return _disk2_fdd_track_ready(sys) ? _disk2_fdd_tracks[sys->slot][sys->offset] : 0xFF;
 
         case 1:
-            return sys->write_protected | sys->motor_state;
+            return (sys->write_protected ? 0x80 : 0) | sys->motor_state;
 
         case 2:
             return sys->write_ready;
@@ -185,10 +580,14 @@ void disk2_fdd_write_byte(disk2_fdd_t* sys, uint8_t byte) {
     }
 
     if (sys->motor_state && sys->control_bits == 3 && sys->write_ready) {
-        printf("disk2_fdd_write_byte: offset=%d, byte=%02x\n", sys->offset, byte);
-
         _disk2_fdd_update_offset(sys);
-        *(sys->nib_image + (sys->half_track / 2) * DISK2_FDD_BYTES_PER_NIB_TRACK + sys->offset) = byte;
+        if (!_disk2_fdd_track_ready(sys)) {
+            return;
+        }
+        _disk2_fdd_tracks[sys->slot][sys->offset] = byte;
+        sys->slot_dirty[sys->slot] = true;
+        sys->idle_updates = 0;
+        sys->bytes_written++;
         sys->image_dirty = true;
         sys->write_ready = 0;
     }
@@ -0,0 +1,603 @@
+#pragma once
+
+// microdisc.h
+//
+// Oric Microdisc floppy disk interface: a WD1793 at $0310-$0313, the control
+// and interrupt status register at $0314 and the DRQ status at $0318. The
+// board pages an 8K EPROM over $E000-$FFFF and can disable the BASIC ROM,
+// which exposes 16K of overlay RAM at $C000-$FFFF.
+//
+// Disks are MFM_DISK images named mN.dsk on the SD card, apart from the dN
+// Disk II and fN tape images. An image is never loaded as a whole: once the
+// head has stopped, microdisc_update() reads the track under it into RAM
+// between frames and indexes its ID fields there, so the WD1793 callbacks
+// never touch the SD card. Until the track has arrived the WD1793 keeps
+// searching, like a drive waiting for the disk to spin round. Written bytes
+// stay in the track buffer and are written back and synced by
+// microdisc_update() once the command is over, or before the track is
+// replaced.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "aconfig.h"
+#include "chips/wd1793fdc.h"
+#include "ff.h"
+#include "perf.h"
+#include "settings/settings.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MICRODISC_NUM_DRIVES (4)
+#define MICRODISC_EPROM_SIZE (0x2000)
+#define MICRODISC_OVERLAY_RAM_SIZE (0x4000)
+#define MICRODISC_MAX_TRACKS (84)
+#define MICRODISC_TRACK_SIZE (6400)  // Raw bytes per track in MFM_DISK images
+#define MICRODISC_MAX_IDS (32)       // ID fields indexed per track
+
+// Control register bits ($0314 write)
+#define MICRODISC_CTRL_IRQ_ENABLE (1 << 0)
+#define MICRODISC_CTRL_ROMDIS (1 << 1)  // Clear to disable the BASIC ROM
+#define MICRODISC_CTRL_DENSITY (1 << 3)
+#define MICRODISC_CTRL_SIDE (1 << 4)
+#define MICRODISC_CTRL_DRIVE (3 << 5)
+#define MICRODISC_CTRL_EPROM (1 << 7)  // Clear to enable the EPROM
+
+// Microdisc disk drive
+typedef struct {
+  bool inserted;
+  bool write_protected;
+  FIL file;
+  uint8_t num_sides;
+  uint8_t num_tracks;
+  uint8_t geometry;  // 1: sides one after the other, 2: interleaved
+  uint8_t head;      // Track under the head
+} microdisc_drive_t;
+
+// Raw track held in the track buffer
+typedef struct {
+  bool valid;  // The buffer holds the track below
+  uint8_t drive;
+  uint8_t side;
+  uint8_t track;
+  uint32_t offset;       // File offset of the track, 0 if it does not exist
+  uint32_t dirty_start;  // Written bytes of the buffer, none if start >= end
+  uint32_t dirty_end;
+  bool flush;  // A command wrote to the track and has finished
+  int num_ids;
+  wd1793fdc_id_t ids[MICRODISC_MAX_IDS];
+} microdisc_track_t;
+
+// Microdisc state
+typedef struct {
+  bool valid;
+  wd1793fdc_t fdc;
+  uint8_t ctrl;
+  bool paging_changed;  // Set when ROM or EPROM paging changed
+  const uint8_t* eprom;
+  uint8_t* overlay_ram;
+  uint8_t* track_data;  // MICRODISC_TRACK_SIZE bytes, outside the state
+  microdisc_drive_t drive[MICRODISC_NUM_DRIVES];
+  microdisc_track_t track;
+  bool stepped;  // The head moved since the last update
+
+  // Statistics
+  uint32_t track_loads;
+} microdisc_t;
+
+// Microdisc interface
+
+// Initialize a new Microdisc interface
+void microdisc_init(microdisc_t* sys, const uint8_t* eprom,
+                    uint8_t* overlay_ram, uint8_t* track_data);
+
+// Discard the Microdisc interface, closing all disk images
+void microdisc_discard(microdisc_t* sys);
+
+// Reset the Microdisc interface
+void microdisc_reset(microdisc_t* sys);
+
+// Tick the Microdisc interface by a number of cycles
+static inline void microdisc_tick(microdisc_t* sys, uint32_t cycles) {
+  wd1793fdc_tick(&sys->fdc, cycles);
+}
+
+// Write back the written track and load the track under the head, call once
+// per frame outside of the emulation loop
+void microdisc_update(microdisc_t* sys);
+
+// Read a register, addr is the offset from $0310
+uint8_t microdisc_read(microdisc_t* sys, uint8_t addr);
+
+// Write a register, addr is the offset from $0310
+void microdisc_write(microdisc_t* sys, uint8_t addr, uint8_t data);
+
+// Return true while the interface asserts the CPU IRQ line
+static inline bool microdisc_irq(const microdisc_t* sys) {
+  return sys->fdc.intrq && (sys->ctrl & MICRODISC_CTRL_IRQ_ENABLE);
+}
+
+// Return true if the BASIC ROM is enabled
+static inline bool microdisc_rom_enabled(const microdisc_t* sys) {
+  return (sys->ctrl & MICRODISC_CTRL_ROMDIS) != 0;
+}
+
+// Return true if the EPROM is paged in at $E000-$FFFF
+static inline bool microdisc_eprom_enabled(const microdisc_t* sys) {
+  return (sys->ctrl & MICRODISC_CTRL_EPROM) == 0;
+}
+
+// Insert disk image mN.dsk from the SD card folder into a drive, N is
+// index + 1
+bool microdisc_insert_disk_sdcard(microdisc_t* sys, int drive, int index);
+
+// Remove the disk image from a drive
+void microdisc_remove_disk(microdisc_t* sys, int drive);
+
+// Prepare a new Microdisc snapshot for saving
+void microdisc_snapshot_onsave(microdisc_t* snapshot);
+
+// Fix up the Microdisc snapshot after loading
+void microdisc_snapshot_onload(microdisc_t* snapshot, microdisc_t* sys);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>  // memcpy, memset
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+static inline microdisc_drive_t* _microdisc_selected(microdisc_t* sys) {
+  return &sys->drive[(sys->ctrl & MICRODISC_CTRL_DRIVE) >> 5];
+}
+
+static inline uint8_t _microdisc_side(const microdisc_t* sys) {
+  return (sys->ctrl & MICRODISC_CTRL_SIDE) ? 1 : 0;
+}
+
+static inline uint8_t _microdisc_selected_drive(const microdisc_t* sys) {
+  return (uint8_t)((sys->ctrl & MICRODISC_CTRL_DRIVE) >> 5);
+}
+
+// File offset of a raw track, 0 if the track does not exist
+static uint32_t _microdisc_track_offset(const microdisc_drive_t* drv,
+                                        uint8_t side, uint8_t head) {
+  if (!drv->inserted || (head >= drv->num_tracks) ||
+      (side >= drv->num_sides)) {
+    return 0;
+  }
+  uint32_t track;
+  if (drv->geometry == 1) {
+    track = (uint32_t)side * drv->num_tracks + head;
+  } else {
+    track = (uint32_t)head * drv->num_sides + side;
+  }
+  return 256u + track * MICRODISC_TRACK_SIZE;
+}
+
+// True if the track buffer holds the track under the head
+static inline bool _microdisc_track_loaded(microdisc_t* sys) {
+  const microdisc_track_t* t = &sys->track;
+  const uint8_t drive = _microdisc_selected_drive(sys);
+  return t->valid && (t->drive == drive) &&
+         (t->side == _microdisc_side(sys)) &&
+         (t->track == sys->drive[drive].head);
+}
+
+// Index of a track buffer position, -1 if pos is not in the buffer
+static inline int _microdisc_track_index(microdisc_t* sys, uint32_t pos) {
+  const microdisc_track_t* t = &sys->track;
+  if (!t->valid || (t->offset == 0) ||
+      (t->drive != _microdisc_selected_drive(sys)) || (pos < t->offset) ||
+      (pos >= t->offset + MICRODISC_TRACK_SIZE)) {
+    return -1;
+  }
+  return (int)(pos - t->offset);
+}
+
+// Index the ID fields of the track buffer, scanning the raw track for address
+// marks: A1 FE starts an ID field, A1 FB or A1 F8 a data field
+static void _microdisc_index_track(microdisc_t* sys) {
+  microdisc_track_t* t = &sys->track;
+  t->num_ids = 0;
+  if (t->offset == 0) {
+    return;
+  }
+  const uint8_t* data = sys->track_data;
+  wd1793fdc_id_t id;
+  memset(&id, 0, sizeof(id));
+  uint8_t prev = 0;
+  int field = -1;   // Next ID field byte, -1 outside an ID field
+  int dam_end = 0;  // End of the data mark search, 0 if not searching
+  for (int p = 0; p < MICRODISC_TRACK_SIZE; p++) {
+    const uint8_t b = data[p];
+    if (field >= 0) {
+      switch (field) {
+        case 0:
+          id.track = b;
+          break;
+        case 1:
+          id.side = b;
+          break;
+        case 2:
+          id.sector = b;
+          break;
+        case 3:
+          id.size = b;
+          break;
+        case 4:
+          id.crc[0] = b;
+          break;
+        default:
+          id.crc[1] = b;
+          break;
+      }
+      field = (field == 5) ? -1 : field + 1;
+      if (field < 0) {
+        dam_end = p + 44;
+      }
+    } else if ((prev == 0xA1) && (b == 0xFE)) {
+      if (dam_end && (t->num_ids < MICRODISC_MAX_IDS)) {
+        // The previous ID field has no data field
+        t->ids[t->num_ids++] = id;
+      }
+      memset(&id, 0, sizeof(id));
+      field = 0;
+      dam_end = 0;
+    } else if (dam_end && (prev == 0xA1) && ((b == 0xFB) || (b == 0xF8))) {
+      id.data_pos = t->offset + (uint32_t)p + 1;
+      id.deleted = (b == 0xF8);
+      if (t->num_ids < MICRODISC_MAX_IDS) {
+        t->ids[t->num_ids++] = id;
+      }
+      dam_end = 0;
+    } else if (dam_end && (p > dam_end)) {
+      if (t->num_ids < MICRODISC_MAX_IDS) {
+        t->ids[t->num_ids++] = id;
+      }
+      dam_end = 0;
+    }
+    prev = b;
+  }
+  if (dam_end && (t->num_ids < MICRODISC_MAX_IDS)) {
+    t->ids[t->num_ids++] = id;
+  }
+}
+
+// Write the written bytes of the track buffer back and sync the image
+static void _microdisc_flush(microdisc_t* sys) {
+  microdisc_track_t* t = &sys->track;
+  t->flush = false;
+  if (t->dirty_start >= t->dirty_end) {
+    return;
+  }
+  const uint32_t start = t->dirty_start;
+  const UINT len = (UINT)(t->dirty_end - start);
+  t->dirty_start = MICRODISC_TRACK_SIZE;
+  t->dirty_end = 0;
+  microdisc_drive_t* drv = &sys->drive[t->drive];
+  if (!t->valid || !drv->inserted) {
+    return;
+  }
+  UINT bytes_written = 0;
+  FRESULT res = f_lseek(&drv->file, t->offset + start);
+  if (res == FR_OK) {
+    PERF_COUNT(PERF_FATFS_CALLS);
+    res = f_write(&drv->file, &sys->track_data[start], len, &bytes_written);
+  }
+  if (res == FR_OK) {
+    PERF_COUNT(PERF_FATFS_CALLS);
+    res = f_sync(&drv->file);
+  }
+  if ((res != FR_OK) || (bytes_written != len)) {
+    DPRINTF("Microdisc: write failed (%d)\n", (int)res);
+  }
+}
+
+// Read a track into the track buffer and index it
+static void _microdisc_load_track(microdisc_t* sys, uint8_t drive,
+                                  uint8_t side, uint8_t head) {
+  microdisc_track_t* t = &sys->track;
+  microdisc_drive_t* drv = &sys->drive[drive];
+  t->valid = true;
+  t->drive = drive;
+  t->side = side;
+  t->track = head;
+  t->offset = _microdisc_track_offset(drv, side, head);
+  t->dirty_start = MICRODISC_TRACK_SIZE;
+  t->dirty_end = 0;
+  t->flush = false;
+  memset(sys->track_data, 0, MICRODISC_TRACK_SIZE);
+  if (t->offset) {
+    UINT bytes_read = 0;
+    if (f_lseek(&drv->file, t->offset) == FR_OK) {
+      PERF_COUNT(PERF_FATFS_CALLS);
+      (void)f_read(&drv->file, sys->track_data, MICRODISC_TRACK_SIZE,
+                   &bytes_read);
+    }
+  }
+  sys->track_loads++;
+  _microdisc_index_track(sys);
+}
+
+// WD1793 disk callbacks, they only use the track buffer
+
+static bool _microdisc_ready(void* user_data) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  return _microdisc_selected(sys)->inserted;
+}
+
+static bool _microdisc_write_protected(void* user_data) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  return _microdisc_selected(sys)->write_protected;
+}
+
+static uint8_t _microdisc_step(void* user_data, int dir) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  microdisc_drive_t* drv = _microdisc_selected(sys);
+  if ((dir < 0) && (drv->head > 0)) {
+    drv->head--;
+  } else if ((dir > 0) && (drv->head < MICRODISC_MAX_TRACKS - 1)) {
+    drv->head++;
+  }
+  sys->stepped |= (dir != 0);
+  return drv->head;
+}
+
+static int _microdisc_num_ids(void* user_data) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  if (!_microdisc_selected(sys)->inserted) {
+    return 0;
+  }
+  return _microdisc_track_loaded(sys) ? sys->track.num_ids : -1;
+}
+
+static bool _microdisc_get_id(void* user_data, int index, wd1793fdc_id_t* id) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  if (!_microdisc_track_loaded(sys) || (index < 0) ||
+      (index >= sys->track.num_ids)) {
+    return false;
+  }
+  *id = sys->track.ids[index];
+  return true;
+}
+
+static uint32_t _microdisc_track_pos(void* user_data, uint32_t* len) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  const uint8_t drive = _microdisc_selected_drive(sys);
+  const uint32_t offset = _microdisc_track_offset(
+      &sys->drive[drive], _microdisc_side(sys), sys->drive[drive].head);
+  *len = offset ? MICRODISC_TRACK_SIZE : 0;
+  return offset;
+}
+
+static uint8_t _microdisc_read_byte(void* user_data, uint32_t pos) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  const int i = _microdisc_track_index(sys, pos);
+  return (i < 0) ? 0xFF : sys->track_data[i];
+}
+
+static void _microdisc_write_byte(void* user_data, uint32_t pos,
+                                  uint8_t data) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  if (_microdisc_selected(sys)->write_protected) {
+    return;
+  }
+  const int i = _microdisc_track_index(sys, pos);
+  if (i < 0) {
+    return;
+  }
+  microdisc_track_t* t = &sys->track;
+  sys->track_data[i] = data;
+  if ((uint32_t)i < t->dirty_start) {
+    t->dirty_start = (uint32_t)i;
+  }
+  if ((uint32_t)i >= t->dirty_end) {
+    t->dirty_end = (uint32_t)i + 1;
+  }
+}
+
+static void _microdisc_done(void* user_data, bool track_written) {
+  microdisc_t* sys = (microdisc_t*)user_data;
+  sys->track.flush = true;
+  if (track_written) {
+    // A formatted track has new ID fields
+    _microdisc_index_track(sys);
+  }
+}
+
+void microdisc_init(microdisc_t* sys, const uint8_t* eprom,
+                    uint8_t* overlay_ram, uint8_t* track_data) {
+  CHIPS_ASSERT(sys && eprom && overlay_ram && track_data);
+  memset(sys, 0, sizeof(microdisc_t));
+  sys->valid = true;
+  sys->eprom = eprom;
+  sys->overlay_ram = overlay_ram;
+  sys->track_data = track_data;
+  const wd1793fdc_disk_t disk = {
+      .user_data = sys,
+      .ready = _microdisc_ready,
+      .write_protected = _microdisc_write_protected,
+      .step = _microdisc_step,
+      .num_ids = _microdisc_num_ids,
+      .get_id = _microdisc_get_id,
+      .track_pos = _microdisc_track_pos,
+      .read = _microdisc_read_byte,
+      .write = _microdisc_write_byte,
+      .done = _microdisc_done,
+  };
+  wd1793fdc_init(&sys->fdc, &disk);
+  microdisc_reset(sys);
+}
+
+void microdisc_discard(microdisc_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  for (int i = 0; i < MICRODISC_NUM_DRIVES; i++) {
+    microdisc_remove_disk(sys, i);
+  }
+  sys->valid = false;
+}
+
+void microdisc_reset(microdisc_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  wd1793fdc_reset(&sys->fdc);
+  // At power on the EPROM is paged in and the BASIC ROM is disabled
+  sys->ctrl = 0;
+  sys->paging_changed = true;
+}
+
+void microdisc_update(microdisc_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  const uint8_t drive = _microdisc_selected_drive(sys);
+  const bool wanted = _microdisc_track_loaded(sys);
+  // Written bytes go to the card when the command is over, or before the
+  // track makes room for another one
+  if (sys->track.flush || !wanted) {
+    _microdisc_flush(sys);
+  }
+  // A head still stepping would have every track on its way loaded
+  const bool stepping = sys->stepped;
+  sys->stepped = false;
+  if (!wanted && !stepping && sys->drive[drive].inserted) {
+    _microdisc_load_track(sys, drive, _microdisc_side(sys),
+                          sys->drive[drive].head);
+  }
+}
+
+uint8_t microdisc_read(microdisc_t* sys, uint8_t addr) {
+  CHIPS_ASSERT(sys && sys->valid);
+  addr &= 0x0F;
+  if (addr < 4) {
+    return wd1793fdc_read(&sys->fdc, addr);
+  }
+  if (addr == 4) {
+    // INTRQ, active low
+    return sys->fdc.intrq ? 0x7F : 0xFF;
+  }
+  if (addr == 8) {
+    // DRQ, active low
+    return sys->fdc.drq ? 0x7F : 0xFF;
+  }
+  return 0xFF;
+}
+
+void microdisc_write(microdisc_t* sys, uint8_t addr, uint8_t data) {
+  CHIPS_ASSERT(sys && sys->valid);
+  addr &= 0x0F;
+  if (addr < 4) {
+    wd1793fdc_write(&sys->fdc, addr, data);
+  } else if (addr == 4) {
+    const uint8_t paging = MICRODISC_CTRL_ROMDIS | MICRODISC_CTRL_EPROM;
+    if ((sys->ctrl ^ data) & paging) {
+      sys->paging_changed = true;
+    }
+    sys->ctrl = data;
+  }
+}
+
+bool microdisc_insert_disk_sdcard(microdisc_t* sys, int drive, int index) {
+  CHIPS_ASSERT(sys && sys->valid && (drive >= 0) &&
+               (drive < MICRODISC_NUM_DRIVES));
+  microdisc_remove_disk(sys, drive);
+  microdisc_drive_t* drv = &sys->drive[drive];
+
+  SettingsConfigEntry* folder =
+      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_FOLDER);
+  const char* folder_name = folder ? folder->value : "/oric";
+  const size_t name_len = strlen(folder_name);
+  const char* sep =
+      (name_len > 0 && folder_name[name_len - 1] == '/') ? "" : "/";
+  char path[256];
+  int path_len = snprintf(path, sizeof(path), "%s%sm%d.dsk", folder_name, sep,
+                          index + 1);
+  if (path_len <= 0 || (size_t)path_len >= sizeof(path)) {
+    DPRINTF("Microdisc: invalid disk path length\n");
+    return false;
+  }
+
+  drv->write_protected = false;
+  FRESULT res = f_open(&drv->file, path, FA_READ | FA_WRITE);
+  if (res != FR_OK) {
+    drv->write_protected = true;
+    res = f_open(&drv->file, path, FA_READ);
+  }
+  if (res != FR_OK) {
+    DPRINTF("Microdisc: open failed (%d): %s\n", (int)res, path);
+    return false;
+  }
+
+  uint8_t header[20];
+  UINT bytes_read = 0;
+  res = f_read(&drv->file, header, sizeof(header), &bytes_read);
+  if ((res != FR_OK) || (bytes_read != sizeof(header)) ||
+      (memcmp(header, "MFM_DISK", 8) != 0)) {
+    DPRINTF("Microdisc: not an MFM_DISK image: %s\n", path);
+    f_close(&drv->file);
+    return false;
+  }
+  const uint32_t sides = header[8] | (header[9] << 8);
+  const uint32_t tracks = header[12] | (header[13] << 8);
+  const uint32_t geometry = header[16];
+  if ((sides < 1) || (sides > 2) || (tracks < 1) ||
+      (tracks > MICRODISC_MAX_TRACKS)) {
+    DPRINTF("Microdisc: unsupported geometry %u/%u\n", (unsigned)sides,
+            (unsigned)tracks);
+    f_close(&drv->file);
+    return false;
+  }
+  drv->num_sides = (uint8_t)sides;
+  drv->num_tracks = (uint8_t)tracks;
+  drv->geometry = (geometry == 1) ? 1 : 2;
+  drv->inserted = true;
+  DPRINTF("Microdisc: drive %d: %s, %u sides, %u tracks%s\n", drive, path,
+          (unsigned)sides, (unsigned)tracks,
+          drv->write_protected ? ", write protected" : "");
+  return true;
+}
+
+void microdisc_remove_disk(microdisc_t* sys, int drive) {
+  CHIPS_ASSERT(sys && sys->valid && (drive >= 0) &&
+               (drive < MICRODISC_NUM_DRIVES));
+  microdisc_drive_t* drv = &sys->drive[drive];
+  if (!drv->inserted) {
+    return;
+  }
+  if (sys->track.valid && (sys->track.drive == drive)) {
+    _microdisc_flush(sys);
+    sys->track.valid = false;
+  }
+  f_close(&drv->file);
+  drv->inserted = false;
+}
+
+void microdisc_snapshot_onsave(microdisc_t* snapshot) {
+  CHIPS_ASSERT(snapshot);
+  snapshot->eprom = 0;
+  snapshot->overlay_ram = 0;
+  snapshot->track_data = 0;
+  snapshot->fdc.disk.user_data = 0;
+}
+
+void microdisc_snapshot_onload(microdisc_t* snapshot, microdisc_t* sys) {
+  CHIPS_ASSERT(snapshot && sys);
+  snapshot->eprom = sys->eprom;
+  snapshot->overlay_ram = sys->overlay_ram;
+  snapshot->track_data = sys->track_data;
+  snapshot->fdc.disk.user_data = sys;
+  // Open files and the track buffer belong to the running instance, the
+  // snapshot's heads get their tracks on the next microdisc_update()
+  memcpy(snapshot->drive, sys->drive, sizeof(sys->drive));
+  snapshot->track = sys->track;
+  snapshot->paging_changed = true;
+}
+
+#endif  // CHIPS_IMPL
@@ -0,0 +1,831 @@
+#pragma once
+
+// oric_hle.h
+//
+// Fast path for hot Oric ROM routines (CLS, scrolling, character output and
+// block moves). When the CPU reaches a known entry point at SYNC, the routine
+// runs to its RTS on an instruction-stepped 6502 core instead of the
+// cycle-stepped one. The ROM code itself is executed, so memory and register
+// results are bit-exact; only the per-cycle bus work is skipped. The caller
+// advances the rest of the machine by the returned cycle count, which is
+// either the routine's real cost or a configurable turbo cost.
+//
+// A run stops early, at an instruction boundary, when the next instruction
+// would touch the $03xx I/O page, is BRK/RTI or an undocumented opcode, when
+// an IRQ becomes pending with the I flag clear, or when the cycle budget is
+// exhausted. The cycle-stepped core then continues from there.
+//
+// Define ORIC_HLE_VERIFY to run the fast path as a dry run instead, let the
+// ROM execute normally and compare registers and written memory when the
+// routine returns.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "chips/mem.h"
+#include "chips/mos6502cpu.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Trap classes, each can be enabled and costed separately
+typedef enum {
+  ORIC_HLE_SCREEN = 0,  // CLS, scroll, character output
+  ORIC_HLE_MEMORY,      // Block moves
+  ORIC_HLE_NUM_CLASSES,
+} oric_hle_class_t;
+
+#define ORIC_HLE_CLASS_BIT(cls) (1u << (cls))
+
+// Charged cost in percent of the real cost (100 = cycle exact timing)
+#ifndef ORIC_HLE_TURBO_PERCENT
+#define ORIC_HLE_TURBO_PERCENT 100u
+#endif
+
+#ifndef ORIC_HLE_VERIFY_LOG_SIZE
+#define ORIC_HLE_VERIFY_LOG_SIZE 512
+#endif
+
+// A trapped ROM entry point
+typedef struct {
+  uint16_t pc;
+  uint8_t cls;
+} oric_hle_trap_t;
+
+// Trap table of a known ROM image
+typedef struct {
+  uint32_t crc;
+  const char* name;
+  const oric_hle_trap_t* traps;
+  int num_traps;
+} oric_hle_rom_t;
+
+// Oric ROM fast path state
+typedef struct {
+  bool valid;
+  uint8_t classes;  // Bit mask of enabled trap classes
+  uint8_t turbo[ORIC_HLE_NUM_CLASSES];  // Charged cost in percent
+  uint32_t rom_crc;
+  const oric_hle_rom_t* rom;  // Trap table of the loaded ROM, NULL if unknown
+  uint64_t page_mask;         // ROM pages $C0-$FF holding an enabled trap
+  bool video_written;         // Last run wrote to the video area
+  bool probe;                 // Loop probe running, memory is read-only
+  bool probe_wrote;           // The probed loop tried to write memory
+
+  // Statistics
+  uint32_t calls;
+  uint32_t aborts;          // Runs that stopped before the routine returned
+  uint32_t cycles_run;      // Real cycles executed by the fast path
+  uint32_t cycles_charged;  // Cycles charged to the machine
+
+#ifdef ORIC_HLE_VERIFY
+  struct {
+    bool dry;
+    bool pending;
+    bool overflow;
+    uint16_t ret_pc;
+    uint8_t ret_s;
+    uint8_t a, x, y, p;
+    uint16_t num_writes;
+    uint16_t addr[ORIC_HLE_VERIFY_LOG_SIZE];
+    uint8_t data[ORIC_HLE_VERIFY_LOG_SIZE];
+    uint32_t passed;
+    uint32_t failed;
+    uint32_t skipped;
+  } verify;
+#endif
+} oric_hle_t;
+
+// Oric ROM fast path interface
+
+// Identify the ROM by its CRC-32 and load its trap table
+void oric_hle_init(oric_hle_t* hle, const uint8_t* rom, uint16_t rom_size);
+
+// Enable the trap classes in mask (see ORIC_HLE_CLASS_BIT())
+void oric_hle_set_classes(oric_hle_t* hle, uint8_t mask);
+
+// Set the charged cost of a trap class in percent of its real cost
+void oric_hle_set_turbo(oric_hle_t* hle, oric_hle_class_t cls,
+                        uint8_t percent);
+
+// Return the enabled trap at pc, or NULL
+static inline const oric_hle_trap_t* oric_hle_find(const oric_hle_t* hle,
+                                                   uint16_t pc) {
+  if ((pc < 0xC000) ||
+      !(hle->page_mask & (1ull << ((pc >> 8) - 0xC0)))) {
+    return NULL;
+  }
+  for (int i = 0; i < hle->rom->num_traps; i++) {
+    const oric_hle_trap_t* trap = &hle->rom->traps[i];
+    if ((trap->pc == pc) && (hle->classes & ORIC_HLE_CLASS_BIT(trap->cls))) {
+      return trap;
+    }
+  }
+  return NULL;
+}
+
+// Run the trapped routine with the CPU stopped at SYNC on its entry point.
+// Returns the number of cycles to charge, 0 if nothing was executed.
+uint32_t oric_hle_run(oric_hle_t* hle, const oric_hle_trap_t* trap,
+                      mos6502cpu_t* c, mem_t* mem, uint32_t budget);
+
+// Run one iteration of the loop starting at the CPU's PC without changing
+// the machine. Returns the cycles of the iteration if it came back to its
+// start with no memory written and all registers unchanged, so that every
+// further iteration repeats it exactly until an interrupt arrives; 0
+// otherwise.
+uint32_t oric_hle_probe_loop(oric_hle_t* hle, const mos6502cpu_t* c,
+                             mem_t* mem, uint32_t max_cycles);
+
+#ifdef ORIC_HLE_VERIFY
+// Call at SYNC while a verification is pending
+void oric_hle_verify_check(oric_hle_t* hle, const mos6502cpu_t* c,
+                           mem_t* mem);
+#endif
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>  // memset
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+// Oric Atmos, BASIC 1.1
+static const oric_hle_trap_t _oric_hle_atmos_traps[] = {
+    {0xCCCE, ORIC_HLE_SCREEN},  // CLS
+    {0xF77C, ORIC_HLE_SCREEN},  // Print character
+    {0xFE4A, ORIC_HLE_SCREEN},  // Scroll screen up
+    {0xC3F4, ORIC_HLE_MEMORY},  // Block move
+};
+
+// Oric-1, BASIC 1.0
+static const oric_hle_trap_t _oric_hle_oric1_traps[] = {
+    {0xCBF0, ORIC_HLE_SCREEN},  // CLS
+    {0xF5C1, ORIC_HLE_SCREEN},  // Print character
+    {0xFD3E, ORIC_HLE_SCREEN},  // Scroll screen up
+    {0xC3F4, ORIC_HLE_MEMORY},  // Block move
+};
+
+static const oric_hle_rom_t _oric_hle_roms[] = {
+    {0xC3A92BEF, "Atmos BASIC 1.1", _oric_hle_atmos_traps,
+     (int)(sizeof(_oric_hle_atmos_traps) / sizeof(oric_hle_trap_t))},
+    {0xF18710B4, "Oric-1 BASIC 1.0", _oric_hle_oric1_traps,
+     (int)(sizeof(_oric_hle_oric1_traps) / sizeof(oric_hle_trap_t))},
+};
+
+static uint32_t _oric_hle_crc32(const uint8_t* data, uint32_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (uint32_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) {
+      crc = (crc >> 1) ^ (0xEDB88320 & (0 - (crc & 1)));
+    }
+  }
+  return ~crc;
+}
+
+static void _oric_hle_update_page_mask(oric_hle_t* hle) {
+  hle->page_mask = 0;
+  if (!hle->rom) {
+    return;
+  }
+  for (int i = 0; i < hle->rom->num_traps; i++) {
+    const oric_hle_trap_t* trap = &hle->rom->traps[i];
+    if (hle->classes & ORIC_HLE_CLASS_BIT(trap->cls)) {
+      hle->page_mask |= 1ull << ((trap->pc >> 8) - 0xC0);
+    }
+  }
+}
+
+void oric_hle_init(oric_hle_t* hle, const uint8_t* rom, uint16_t rom_size) {
+  CHIPS_ASSERT(hle && rom);
+  memset(hle, 0, sizeof(oric_hle_t));
+  hle->valid = true;
+  for (int i = 0; i < ORIC_HLE_NUM_CLASSES; i++) {
+    hle->turbo[i] = ORIC_HLE_TURBO_PERCENT;
+  }
+  hle->rom_crc = _oric_hle_crc32(rom, rom_size);
+  for (size_t i = 0; i < sizeof(_oric_hle_roms) / sizeof(oric_hle_rom_t);
+       i++) {
+    if (_oric_hle_roms[i].crc == hle->rom_crc) {
+      hle->rom = &_oric_hle_roms[i];
+    }
+  }
+  DPRINTF("Oric HLE: ROM CRC %08X, %s\n", (unsigned)hle->rom_crc,
+          hle->rom ? hle->rom->name : "unknown, traps disabled");
+}
+
+void oric_hle_set_classes(oric_hle_t* hle, uint8_t mask) {
+  CHIPS_ASSERT(hle && hle->valid);
+  hle->classes = mask;
+  _oric_hle_update_page_mask(hle);
+}
+
+void oric_hle_set_turbo(oric_hle_t* hle, oric_hle_class_t cls,
+                        uint8_t percent) {
+  CHIPS_ASSERT(hle && hle->valid && (cls < ORIC_HLE_NUM_CLASSES));
+  hle->turbo[cls] = (percent > 0) ? percent : 1;
+}
+
+// Accesses to the I/O page must go through the cycle-stepped core
+#define _ORIC_HLE_IO(a) (((a) & 0xFF00) == 0x0300)
+#define _ORIC_HLE_NZ(v) (c->nf = ((v) & 0x80) != 0, c->zf = ((v) & 0xFF) == 0)
+
+static inline uint8_t _oric_hle_rd(oric_hle_t* hle, mem_t* mem,
+                                   uint16_t addr) {
+#ifdef ORIC_HLE_VERIFY
+  if (hle->verify.dry) {
+    for (int i = hle->verify.num_writes - 1; i >= 0; i--) {
+      if (hle->verify.addr[i] == addr) {
+        return hle->verify.data[i];
+      }
+    }
+  }
+#else
+  (void)hle;
+#endif
+  return mem_rd(mem, addr);
+}
+
+static inline void _oric_hle_wr(oric_hle_t* hle, mem_t* mem, uint16_t addr,
+                                uint8_t data) {
+  if (hle->probe) {
+    hle->probe_wrote = true;
+    return;
+  }
+  if (addr >= 0x9800 && addr <= 0xBFDF) {
+    hle->video_written = true;
+  }
+#ifdef ORIC_HLE_VERIFY
+  if (hle->verify.dry) {
+    if (hle->verify.num_writes < ORIC_HLE_VERIFY_LOG_SIZE) {
+      hle->verify.addr[hle->verify.num_writes] = addr;
+      hle->verify.data[hle->verify.num_writes] = data;
+      hle->verify.num_writes++;
+    } else {
+      hle->verify.overflow = true;
+    }
+    return;
+  }
+#endif
+  mem_wr(mem, addr, data);
+}
+
+// Addressing modes of the instruction-stepped core
+typedef enum {
+  _ORIC_HLE_IMM,
+  _ORIC_HLE_ZP,
+  _ORIC_HLE_ZPX,
+  _ORIC_HLE_ZPY,
+  _ORIC_HLE_ABS,
+  _ORIC_HLE_ABX,
+  _ORIC_HLE_ABY,
+  _ORIC_HLE_IZX,
+  _ORIC_HLE_IZY,
+} _oric_hle_mode_t;
+
+// Group one (ORA, AND, EOR, ADC, STA, LDA, CMP, SBC) addressing by bits 2-4
+static const uint8_t _oric_hle_group1_modes[8] = {
+    _ORIC_HLE_IZX, _ORIC_HLE_ZP,  _ORIC_HLE_IMM, _ORIC_HLE_ABS,
+    _ORIC_HLE_IZY, _ORIC_HLE_ZPX, _ORIC_HLE_ABY, _ORIC_HLE_ABX,
+};
+
+// Read-modify-write (ASL, ROL, LSR, ROR, DEC, INC) addressing by bits 3-4
+static const uint8_t _oric_hle_rmw_modes[4] = {
+    _ORIC_HLE_ZP,
+    _ORIC_HLE_ABS,
+    _ORIC_HLE_ZPX,
+    _ORIC_HLE_ABX,
+};
+
+// Cycles of read instructions by addressing mode, without page crossing
+static const uint8_t _oric_hle_read_cycles[9] = {2, 3, 4, 4, 4, 4, 4, 6, 5};
+// Cycles of store instructions by addressing mode
+static const uint8_t _oric_hle_store_cycles[9] = {2, 3, 4, 4, 4, 5, 5, 6, 6};
+
+// Effective address of an operand. *dummy is set to the unfixed address the
+// cycle-stepped core reads first when an index crosses a page, or always for
+// indexed writes.
+static inline uint16_t _oric_hle_ea(oric_hle_t* hle, mos6502cpu_t* c,
+                                    mem_t* mem, uint8_t mode, uint8_t lo,
+                                    uint8_t hi, uint16_t* dummy) {
+  uint16_t base;
+  uint16_t ea;
+  switch (mode) {
+    case _ORIC_HLE_ZP:
+      ea = lo;
+      break;
+    case _ORIC_HLE_ZPX:
+      ea = (uint8_t)(lo + c->X);
+      break;
+    case _ORIC_HLE_ZPY:
+      ea = (uint8_t)(lo + c->Y);
+      break;
+    case _ORIC_HLE_ABS:
+      ea = (uint16_t)(lo | (hi << 8));
+      break;
+    case _ORIC_HLE_ABX:
+    case _ORIC_HLE_ABY:
+      base = (uint16_t)(lo | (hi << 8));
+      ea = (uint16_t)(base + ((mode == _ORIC_HLE_ABX) ? c->X : c->Y));
+      *dummy = (base & 0xFF00) | (ea & 0x00FF);
+      return ea;
+    case _ORIC_HLE_IZX:
+      ea = (uint16_t)(_oric_hle_rd(hle, mem, (uint8_t)(lo + c->X)) |
+                      (_oric_hle_rd(hle, mem, (uint8_t)(lo + c->X + 1)) << 8));
+      break;
+    case _ORIC_HLE_IZY:
+      base = (uint16_t)(_oric_hle_rd(hle, mem, lo) |
+                        (_oric_hle_rd(hle, mem, (uint8_t)(lo + 1)) << 8));
+      ea = (uint16_t)(base + c->Y);
+      *dummy = (base & 0xFF00) | (ea & 0x00FF);
+      return ea;
+    default:
+      ea = 0;
+      break;
+  }
+  *dummy = ea;
+  return ea;
+}
+
+// Instruction-stepped 6502 core. Stops before any instruction it cannot run
+// exactly; returns the executed cycles and sets *returned when the routine
+// returned through RTS with the stack pointer at ret_s. Also stops when the
+// PC reaches stop_pc, if it is not negative.
+static uint32_t _oric_hle_exec(oric_hle_t* hle, mos6502cpu_t* c, mem_t* mem,
+                               uint8_t ret_s, uint32_t budget, int32_t stop_pc,
+                               bool* returned) {
+  uint32_t cycles = 0;
+  *returned = false;
+  while (cycles < budget) {
+    if ((c->irq && !c->iflag) || c->nmi_pip || c->res) {
+      break;
+    }
+    const uint16_t pc = c->PC;
+    if (_ORIC_HLE_IO(pc) || _ORIC_HLE_IO(pc + 2)) {
+      break;
+    }
+    const uint8_t op = _oric_hle_rd(hle, mem, pc);
+    const uint8_t lo = _oric_hle_rd(hle, mem, (uint16_t)(pc + 1));
+    const uint8_t hi = _oric_hle_rd(hle, mem, (uint16_t)(pc + 2));
+    uint16_t next_pc = (uint16_t)(pc + mos6502cpu_opcode_length(op));
+    uint16_t ea = 0;
+    uint16_t dummy = 0;
+    uint8_t n = 2;
+    uint8_t v;
+
+    if (((op & 0x03) == 0x01) && (op != 0x89)) {
+      // Group one: ORA, AND, EOR, ADC, STA, LDA, CMP, SBC
+      const uint8_t mode = _oric_hle_group1_modes[(op >> 2) & 7];
+      const bool store = (op >> 5) == 4;
+      if (mode != _ORIC_HLE_IMM) {
+        ea = _oric_hle_ea(hle, c, mem, mode, lo, hi, &dummy);
+        const bool indexed = (mode == _ORIC_HLE_ABX) ||
+                             (mode == _ORIC_HLE_ABY) ||
+                             (mode == _ORIC_HLE_IZY);
+        if (_ORIC_HLE_IO(ea) ||
+            ((dummy != ea || (store && indexed)) && _ORIC_HLE_IO(dummy))) {
+          break;
+        }
+      }
+      if (store) {
+        n = _oric_hle_store_cycles[mode];
+        _oric_hle_wr(hle, mem, ea, c->A);
+      } else {
+        n = _oric_hle_read_cycles[mode] + (dummy != ea);
+        v = (mode == _ORIC_HLE_IMM) ? lo : _oric_hle_rd(hle, mem, ea);
+        switch (op >> 5) {
+          case 0:
+            c->A |= v;
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 1:
+            c->A &= v;
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 2:
+            c->A ^= v;
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 3:
+            _mos6502cpu_adc(c, v);
+            break;
+          case 5:
+            c->A = v;
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 6:
+            _mos6502cpu_cmp(c, c->A, v);
+            break;
+          default:
+            _mos6502cpu_sbc(c, v);
+            break;
+        }
+      }
+    } else if (((op & 0x07) == 0x06) && ((op & 0xC0) != 0x80)) {
+      // Read-modify-write: ASL, ROL, LSR, ROR, DEC, INC
+      const uint8_t mode = _oric_hle_rmw_modes[(op >> 3) & 3];
+      ea = _oric_hle_ea(hle, c, mem, mode, lo, hi, &dummy);
+      if (_ORIC_HLE_IO(ea) || _ORIC_HLE_IO(dummy)) {
+        break;
+      }
+      n = (mode == _ORIC_HLE_ZP)
+              ? 5
+              : ((mode == _ORIC_HLE_ABX) ? 7 : 6);
+      v = _oric_hle_rd(hle, mem, ea);
+      switch (op >> 5) {
+        case 0:
+          v = _mos6502cpu_asl(c, v);
+          break;
+        case 1:
+          v = _mos6502cpu_rol(c, v);
+          break;
+        case 2:
+          v = _mos6502cpu_lsr(c, v);
+          break;
+        case 3:
+          v = _mos6502cpu_ror(c, v);
+          break;
+        case 6:
+          v--;
+          _ORIC_HLE_NZ(v);
+          break;
+        default:
+          v++;
+          _ORIC_HLE_NZ(v);
+          break;
+      }
+      _oric_hle_wr(hle, mem, ea, v);
+    } else {
+      uint8_t mode = _ORIC_HLE_IMM;
+      switch (op) {
+        // Loads, compares and BIT outside group one
+        case 0xA2:
+        case 0xA0:
+        case 0xE0:
+        case 0xC0:
+          mode = _ORIC_HLE_IMM;
+          break;
+        case 0xA6:
+        case 0xA4:
+        case 0xE4:
+        case 0xC4:
+        case 0x24:
+        case 0x86:
+        case 0x84:
+          mode = _ORIC_HLE_ZP;
+          break;
+        case 0xAE:
+        case 0xAC:
+        case 0xEC:
+        case 0xCC:
+        case 0x2C:
+        case 0x8E:
+        case 0x8C:
+          mode = _ORIC_HLE_ABS;
+          break;
+        case 0xB4:
+        case 0x94:
+          mode = _ORIC_HLE_ZPX;
+          break;
+        case 0xB6:
+        case 0x96:
+          mode = _ORIC_HLE_ZPY;
+          break;
+        case 0xBC:
+          mode = _ORIC_HLE_ABX;
+          break;
+        case 0xBE:
+          mode = _ORIC_HLE_ABY;
+          break;
+        default:
+          mode = 0xFF;
+          break;
+      }
+      if (mode != 0xFF) {
+        // LDX, LDY, CPX, CPY, BIT, STX, STY
+        const bool store = (op & 0xE0) == 0x80;
+        if (mode != _ORIC_HLE_IMM) {
+          ea = _oric_hle_ea(hle, c, mem, mode, lo, hi, &dummy);
+          if (_ORIC_HLE_IO(ea) || _ORIC_HLE_IO(dummy)) {
+            break;
+          }
+        }
+        if (store) {
+          n = _oric_hle_store_cycles[mode];
+          _oric_hle_wr(hle, mem, ea, (op & 0x02) ? c->X : c->Y);
+        } else {
+          n = _oric_hle_read_cycles[mode] + (dummy != ea);
+          v = (mode == _ORIC_HLE_IMM) ? lo : _oric_hle_rd(hle, mem, ea);
+          switch (op & 0xE3) {
+            case 0xA2:
+              c->X = v;
+              _ORIC_HLE_NZ(c->X);
+              break;
+            case 0xA0:
+              c->Y = v;
+              _ORIC_HLE_NZ(c->Y);
+              break;
+            case 0xE0:
+              _mos6502cpu_cmp(c, c->X, v);
+              break;
+            case 0xC0:
+              _mos6502cpu_cmp(c, c->Y, v);
+              break;
+            default:
+              _mos6502cpu_bit(c, v);
+              break;
+          }
+        }
+      } else if ((op & 0x1F) == 0x10) {
+        // Branches: N, V, C, Z flag by bits 6-7, taken if equal to bit 5
+        bool flag;
+        switch (op >> 6) {
+          case 0:
+            flag = c->nf;
+            break;
+          case 1:
+            flag = c->vf;
+            break;
+          case 2:
+            flag = c->cf;
+            break;
+          default:
+            flag = c->zf;
+            break;
+        }
+        if (flag == ((op & 0x20) != 0)) {
+          const uint16_t target = (uint16_t)(next_pc + (int8_t)lo);
+          n = ((target ^ next_pc) & 0xFF00) ? 4 : 3;
+          next_pc = target;
+        }
+      } else {
+        bool supported = true;
+        switch (op) {
+          case 0x4C:  // JMP abs
+            n = 3;
+            next_pc = (uint16_t)(lo | (hi << 8));
+            break;
+          case 0x6C: {  // JMP (ind), the pointer wraps inside its page
+            const uint16_t ptr = (uint16_t)(lo | (hi << 8));
+            if (_ORIC_HLE_IO(ptr)) {
+              supported = false;
+              break;
+            }
+            n = 5;
+            next_pc = (uint16_t)(
+                _oric_hle_rd(hle, mem, ptr) |
+                (_oric_hle_rd(hle, mem,
+                              (ptr & 0xFF00) | ((ptr + 1) & 0x00FF))
+                 << 8));
+            break;
+          }
+          case 0x20:  // JSR
+            n = 6;
+            _oric_hle_wr(hle, mem, 0x0100 | c->S--, (uint8_t)((pc + 2) >> 8));
+            _oric_hle_wr(hle, mem, 0x0100 | c->S--, (uint8_t)(pc + 2));
+            next_pc = (uint16_t)(lo | (hi << 8));
+            break;
+          case 0x60: {  // RTS
+            const uint8_t pcl = _oric_hle_rd(hle, mem, 0x0100 | ++c->S);
+            const uint8_t pch = _oric_hle_rd(hle, mem, 0x0100 | ++c->S);
+            n = 6;
+            next_pc = (uint16_t)(((pch << 8) | pcl) + 1);
+            *returned = (c->S == ret_s);
+            break;
+          }
+          case 0x48:  // PHA
+            n = 3;
+            _oric_hle_wr(hle, mem, 0x0100 | c->S--, c->A);
+            break;
+          case 0x08:  // PHP
+            n = 3;
+            _oric_hle_wr(hle, mem, 0x0100 | c->S--, _get_flags(c) | 0x20);
+            break;
+          case 0x68:  // PLA
+            n = 4;
+            c->A = _oric_hle_rd(hle, mem, 0x0100 | ++c->S);
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 0x28:  // PLP
+            n = 4;
+            _set_flags(c, _oric_hle_rd(hle, mem, 0x0100 | ++c->S));
+            break;
+          case 0x0A:
+            c->A = _mos6502cpu_asl(c, c->A);
+            break;
+          case 0x2A:
+            c->A = _mos6502cpu_rol(c, c->A);
+            break;
+          case 0x4A:
+            c->A = _mos6502cpu_lsr(c, c->A);
+            break;
+          case 0x6A:
+            c->A = _mos6502cpu_ror(c, c->A);
+            break;
+          case 0xAA:
+            c->X = c->A;
+            _ORIC_HLE_NZ(c->X);
+            break;
+          case 0xA8:
+            c->Y = c->A;
+            _ORIC_HLE_NZ(c->Y);
+            break;
+          case 0x8A:
+            c->A = c->X;
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 0x98:
+            c->A = c->Y;
+            _ORIC_HLE_NZ(c->A);
+            break;
+          case 0xBA:
+            c->X = c->S;
+            _ORIC_HLE_NZ(c->X);
+            break;
+          case 0x9A:
+            c->S = c->X;
+            break;
+          case 0xE8:
+            c->X++;
+            _ORIC_HLE_NZ(c->X);
+            break;
+          case 0xC8:
+            c->Y++;
+            _ORIC_HLE_NZ(c->Y);
+            break;
+          case 0xCA:
+            c->X--;
+            _ORIC_HLE_NZ(c->X);
+            break;
+          case 0x88:
+            c->Y--;
+            _ORIC_HLE_NZ(c->Y);
+            break;
+          case 0x18:
+            c->cf = false;
+            break;
+          case 0x38:
+            c->cf = true;
+            break;
+          case 0x58:
+            c->iflag = false;
+            break;
+          case 0x78:
+            c->iflag = true;
+            break;
+          case 0xB8:
+            c->vf = false;
+            break;
+          case 0xD8:
+            c->df = false;
+            break;
+          case 0xF8:
+            c->df = true;
+            break;
+          case 0xEA:
+            break;
+          default:
+            // BRK, RTI and undocumented opcodes stay on the cycle-stepped
+            // core
+            supported = false;
+            break;
+        }
+        if (!supported) {
+          break;
+        }
+      }
+    }
+
+    c->PC = next_pc;
+    cycles += n;
+    if (*returned || hle->probe_wrote || ((int32_t)c->PC == stop_pc)) {
+      break;
+    }
+  }
+  return cycles;
+}
+
+uint32_t oric_hle_run(oric_hle_t* hle, const oric_hle_trap_t* trap,
+                      mos6502cpu_t* c, mem_t* mem, uint32_t budget) {
+  CHIPS_ASSERT(hle && hle->valid && trap && c && mem);
+  // The routine returns when RTS pops the caller's return address
+  const uint8_t ret_s = (uint8_t)(c->S + 2);
+  bool returned = false;
+  hle->video_written = false;
+
+#ifdef ORIC_HLE_VERIFY
+  if (hle->verify.pending) {
+    return 0;
+  }
+  static mos6502cpu_t shadow;
+  shadow = *c;
+  hle->verify.dry = true;
+  hle->verify.overflow = false;
+  hle->verify.num_writes = 0;
+  (void)_oric_hle_exec(hle, &shadow, mem, ret_s, budget, -1, &returned);
+  hle->verify.dry = false;
+  if (returned && !hle->verify.overflow) {
+    hle->verify.pending = true;
+    hle->verify.ret_pc = shadow.PC;
+    hle->verify.ret_s = shadow.S;
+    hle->verify.a = shadow.A;
+    hle->verify.x = shadow.X;
+    hle->verify.y = shadow.Y;
+    hle->verify.p = _get_flags(&shadow);
+  } else {
+    hle->verify.skipped++;
+  }
+  // The ROM routine runs on the cycle-stepped core for comparison
+  return 0;
+#else
+  const uint32_t cycles =
+      _oric_hle_exec(hle, c, mem, ret_s, budget, -1, &returned);
+  if (cycles == 0) {
+    return 0;
+  }
+  hle->calls++;
+  if (!returned) {
+    hle->aborts++;
+  }
+  uint32_t charged = (cycles * hle->turbo[trap->cls]) / 100u;
+  if (charged == 0) {
+    charged = 1;
+  }
+  hle->cycles_run += cycles;
+  hle->cycles_charged += charged;
+  return charged;
+#endif
+}
+
+uint32_t oric_hle_probe_loop(oric_hle_t* hle, const mos6502cpu_t* c,
+                             mem_t* mem, uint32_t max_cycles) {
+  CHIPS_ASSERT(hle && hle->valid && c && mem);
+  static mos6502cpu_t shadow;
+  shadow = *c;
+  bool returned = false;
+  hle->probe = true;
+  hle->probe_wrote = false;
+  const uint32_t cycles =
+      _oric_hle_exec(hle, &shadow, mem, (uint8_t)(c->S + 2), max_cycles,
+                     c->PC, &returned);
+  hle->probe = false;
+  if (hle->probe_wrote || returned || (shadow.PC != c->PC)) {
+    return 0;
+  }
+  if ((shadow.A != c->A) || (shadow.X != c->X) || (shadow.Y != c->Y) ||
+      (shadow.S != c->S) ||
+      (_get_flags(&shadow) != _get_flags((mos6502cpu_t*)c))) {
+    return 0;
+  }
+  return cycles;
+}
+
+#ifdef ORIC_HLE_VERIFY
+void oric_hle_verify_check(oric_hle_t* hle, const mos6502cpu_t* c,
+                           mem_t* mem) {
+  if ((c->PC != hle->verify.ret_pc) || (c->S != hle->verify.ret_s)) {
+    return;
+  }
+  hle->verify.pending = false;
+  mos6502cpu_t* cc = (mos6502cpu_t*)c;
+  bool ok = (c->A == hle->verify.a) && (c->X == hle->verify.x) &&
+            (c->Y == hle->verify.y) &&
+            ((_get_flags(cc) & 0xCF) == (hle->verify.p & 0xCF));
+  // Later writes to the same address win, check the log backwards
+  for (int i = hle->verify.num_writes - 1; ok && i >= 0; i--) {
+    bool superseded = false;
+    for (int j = i + 1; j < hle->verify.num_writes; j++) {
+      if (hle->verify.addr[j] == hle->verify.addr[i]) {
+        superseded = true;
+        break;
+      }
+    }
+    if (!superseded &&
+        (mem_rd(mem, hle->verify.addr[i]) != hle->verify.data[i])) {
+      DPRINTF("Oric HLE: mismatch at $%04X: %02X != %02X\n",
+              hle->verify.addr[i], mem_rd(mem, hle->verify.addr[i]),
+              hle->verify.data[i]);
+      ok = false;
+    }
+  }
+  if (ok) {
+    hle->verify.passed++;
+  } else {
+    hle->verify.failed++;
+    DPRINTF("Oric HLE: verify failed returning to $%04X\n", c->PC);
+  }
+}
+#endif
+
+#undef _ORIC_HLE_IO
+#undef _ORIC_HLE_NZ
+
+#endif  // CHIPS_IMPL
@@ -0,0 +1,234 @@
+#pragma once
+
+// oric_kbd.h
+//
+// Oric keyboard matrix as an 8x8 bitboard: one byte per row, bit n for
+// column n. The ROM selects a row through the VIA port B and columns through
+// the PSG port A, and the sense line is a single AND of the two, so any
+// number of keys can be down at the same time.
+//
+// Key codes are the ASCII codes of the unshifted and shifted keys plus the
+// special codes below. A key that needs Shift or Ctrl adds that modifier to
+// the matrix for as long as it is down. The rows are only rebuilt on key
+// events and when oric_kbd_update() releases a key.
+//
+// A key released in the frame it was pressed in stays down until the
+// second oric_kbd_update() after it, so the ROM, which scans the matrix once
+// per interrupt, never misses a short press.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ORIC_KEY_CTRL (0x146)
+#define ORIC_KEY_SHIFT (0x147)
+#define ORIC_KEY_RIGHT (0x14F)
+#define ORIC_KEY_LEFT (0x150)
+#define ORIC_KEY_DOWN (0x151)
+#define ORIC_KEY_UP (0x152)
+
+// Keyboard matrix state
+typedef struct {
+  uint8_t rows[8];      // Matrix seen by the ROM, modifiers included
+  uint8_t columns;      // Columns selected through the PSG port A
+  uint8_t down[8];      // Keys held down
+  uint8_t shifted[8];   // Keys held down that need Shift
+  uint8_t ctrled[8];    // Keys held down that need Ctrl
+  uint8_t fresh[8];     // Keys pressed since the last oric_kbd_update()
+  uint8_t released[8];  // Keys released but kept down a little longer
+} oric_kbd_t;
+
+// Initialize a keyboard with no key down
+void oric_kbd_init(oric_kbd_t* sys);
+// Press a key, returns false if it isn't on the Oric keyboard
+bool oric_kbd_key_down(oric_kbd_t* sys, int key);
+// Release a key
+void oric_kbd_key_up(oric_kbd_t* sys, int key);
+// Release the short presses that have been visible long enough, call once
+// per frame
+void oric_kbd_update(oric_kbd_t* sys);
+
+// Select the columns to sense, a bit set for every active column
+static inline void oric_kbd_set_columns(oric_kbd_t* sys, uint8_t mask) {
+  sys->columns = mask;
+}
+
+// True if a key of the row is down in one of the selected columns
+static inline bool oric_kbd_sense(const oric_kbd_t* sys, int row) {
+  return (sys->rows[row & 7] & sys->columns) != 0;
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>  // memset, strchr
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+// Matrix position of a key: bits 0-2 column, 3-5 row, 6 Shift, 7 Ctrl
+#define _ORIC_KBD_POS(column, row) ((uint8_t)(((row) << 3) | (column)))
+#define _ORIC_KBD_SHIFT (0x40)
+#define _ORIC_KBD_CTRL (0x80)
+#define _ORIC_KBD_NONE (0xFF)
+
+// Shift is column 4, row 4, Ctrl column 4, row 2
+#define _ORIC_KBD_SHIFT_POS _ORIC_KBD_POS(4, 4)
+#define _ORIC_KBD_CTRL_POS _ORIC_KBD_POS(4, 2)
+
+static const char _oric_kbd_keymap[] =
+    // no shift
+    //   01234567 (col)
+    "7N5V 1X3"   // row 0
+    "JTRF  QD"   // row 1
+    "M6B4 Z2C"   // row 2
+    "K9;-  \\'"  // row 3
+    " <>     "   // row 4
+    "UIOP  ]["   // row 5
+    "YHGE ASW"   // row 6
+    "8L0/   ="   // row 7
+
+    /* shift */
+    "&n%v !x#"
+    "jtrf  qd"
+    "m^b$ z@c"
+    "k(:_  |\""
+    " ,.     "
+    "uiop  }{"
+    "yhge asw"
+    "*l)?   +";
+
+// Keys outside the character map
+static const struct {
+  uint16_t key;
+  uint8_t pos;
+} _oric_kbd_special[] = {
+    {0x20, _ORIC_KBD_POS(0, 4)},                   // Space
+    {ORIC_KEY_LEFT, _ORIC_KBD_POS(5, 4)},          // Left
+    {ORIC_KEY_RIGHT, _ORIC_KBD_POS(7, 4)},         // Right
+    {ORIC_KEY_DOWN, _ORIC_KBD_POS(6, 4)},          // Down
+    {ORIC_KEY_UP, _ORIC_KBD_POS(3, 4)},            // Up
+    {0x08, _ORIC_KBD_POS(5, 5)},                   // Delete
+    {0x0D, _ORIC_KBD_POS(5, 7)},                   // Return
+    {ORIC_KEY_CTRL, _ORIC_KBD_CTRL_POS},           // Ctrl
+    {ORIC_KEY_SHIFT, _ORIC_KBD_SHIFT_POS},         // Shift
+    {0x14, _ORIC_KBD_POS(1, 1) | _ORIC_KBD_CTRL},  // Ctrl+T
+    {0x10, _ORIC_KBD_POS(3, 5) | _ORIC_KBD_CTRL},  // Ctrl+P
+    {0x06, _ORIC_KBD_POS(3, 1) | _ORIC_KBD_CTRL},  // Ctrl+F
+    {0x04, _ORIC_KBD_POS(7, 1) | _ORIC_KBD_CTRL},  // Ctrl+D
+    {0x11, _ORIC_KBD_POS(6, 1) | _ORIC_KBD_CTRL},  // Ctrl+Q
+    {0x13, _ORIC_KBD_POS(6, 6) | _ORIC_KBD_CTRL},  // Ctrl+S
+    {0x0C, _ORIC_KBD_POS(1, 7) | _ORIC_KBD_CTRL},  // Ctrl+L
+    {0x0E, _ORIC_KBD_POS(1, 0) | _ORIC_KBD_CTRL},  // Ctrl+N
+};
+
+// Matrix position of a key code, _ORIC_KBD_NONE if there is none. Only runs
+// on key events.
+static uint8_t _oric_kbd_find(int key) {
+  for (size_t i = 0;
+       i < sizeof(_oric_kbd_special) / sizeof(_oric_kbd_special[0]); i++) {
+    if (_oric_kbd_special[i].key == key) {
+      return _oric_kbd_special[i].pos;
+    }
+  }
+  if ((key <= 0x20) || (key >= 0x7F)) {
+    return _ORIC_KBD_NONE;
+  }
+  const char* c = strchr(_oric_kbd_keymap, key);
+  if (c == NULL) {
+    return _ORIC_KBD_NONE;
+  }
+  const int index = (int)(c - _oric_kbd_keymap);
+  return (uint8_t)((index & 63) | ((index & 64) ? _ORIC_KBD_SHIFT : 0));
+}
+
+// Rebuild the matrix from the keys down and the modifiers they need
+static void _oric_kbd_update_rows(oric_kbd_t* sys) {
+  uint8_t shift = 0;
+  uint8_t ctrl = 0;
+  for (int row = 0; row < 8; row++) {
+    sys->rows[row] = sys->down[row];
+    shift |= sys->shifted[row];
+    ctrl |= sys->ctrled[row];
+  }
+  if (shift) {
+    sys->rows[_ORIC_KBD_SHIFT_POS >> 3] |= 1u << (_ORIC_KBD_SHIFT_POS & 7);
+  }
+  if (ctrl) {
+    sys->rows[_ORIC_KBD_CTRL_POS >> 3] |= 1u << (_ORIC_KBD_CTRL_POS & 7);
+  }
+}
+
+static void _oric_kbd_release(oric_kbd_t* sys, int row, uint8_t bits) {
+  sys->down[row] &= ~bits;
+  sys->shifted[row] &= ~bits;
+  sys->ctrled[row] &= ~bits;
+}
+
+void oric_kbd_init(oric_kbd_t* sys) {
+  CHIPS_ASSERT(sys);
+  memset(sys, 0, sizeof(oric_kbd_t));
+}
+
+bool oric_kbd_key_down(oric_kbd_t* sys, int key) {
+  CHIPS_ASSERT(sys);
+  const uint8_t pos = _oric_kbd_find(key);
+  if (pos == _ORIC_KBD_NONE) {
+    return false;
+  }
+  const int row = (pos >> 3) & 7;
+  const uint8_t bit = (uint8_t)(1u << (pos & 7));
+  sys->down[row] |= bit;
+  sys->fresh[row] |= bit;
+  sys->released[row] &= ~bit;
+  // The same key may come back with other modifiers, '1' then '!'
+  sys->shifted[row] = (pos & _ORIC_KBD_SHIFT) ? (sys->shifted[row] | bit)
+                                              : (sys->shifted[row] & ~bit);
+  sys->ctrled[row] = (pos & _ORIC_KBD_CTRL) ? (sys->ctrled[row] | bit)
+                                            : (sys->ctrled[row] & ~bit);
+  _oric_kbd_update_rows(sys);
+  return true;
+}
+
+void oric_kbd_key_up(oric_kbd_t* sys, int key) {
+  CHIPS_ASSERT(sys);
+  const uint8_t pos = _oric_kbd_find(key);
+  if (pos == _ORIC_KBD_NONE) {
+    return;
+  }
+  const int row = (pos >> 3) & 7;
+  const uint8_t bit = (uint8_t)(1u << (pos & 7));
+  if (sys->fresh[row] & bit) {
+    sys->released[row] |= bit;
+    return;
+  }
+  _oric_kbd_release(sys, row, bit);
+  _oric_kbd_update_rows(sys);
+}
+
+void oric_kbd_update(oric_kbd_t* sys) {
+  CHIPS_ASSERT(sys);
+  bool changed = false;
+  for (int row = 0; row < 8; row++) {
+    const uint8_t due = sys->released[row] & ~sys->fresh[row];
+    if (due) {
+      _oric_kbd_release(sys, row, due);
+      changed = true;
+    }
+    sys->released[row] &= sys->fresh[row];
+    sys->fresh[row] = 0;
+  }
+  if (changed) {
+    _oric_kbd_update_rows(sys);
+  }
+}
+
+#endif  // CHIPS_IMPL
@@ -0,0 +1,190 @@
+#pragma once
+
+// oric_prof.h
+//
+// PC sampling profiler for the software running on the emulated Oric. Every
+// interval-th instruction fetch adds the PC to a histogram of 256 byte pages
+// and to a table of single addresses, so the hot loops of a game or of the
+// BASIC ROM show up without slowing the emulation down: between two samples
+// a SYNC costs one decrement and one branch.
+//
+// The address table is open addressed. A sample whose address finds no free
+// slot among ORIC_PROF_PROBES neighbours is only counted in its page, and in
+// `dropped`. The result is written to the SD card as profile.bin for
+// rp/tools/prof_decode.py, which maps the addresses to ROM symbols.
+//
+// Samples at $C000-$FFFF come from the ROM or, with a Microdisc that paged
+// the ROM out, from the overlay RAM behind it.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "aconfig.h"
+#include "ff.h"
+#include "settings/settings.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Instructions between two samples, a prime so the samples don't lock onto
+// a loop of the same length
+#ifndef ORIC_PROF_INTERVAL
+#define ORIC_PROF_INTERVAL 61u
+#endif
+
+// Slots of the address table, a power of two
+#ifndef ORIC_PROF_ADDRS
+#define ORIC_PROF_ADDRS 2048
+#endif
+
+// Slots tried for an address before the sample is dropped
+#define ORIC_PROF_PROBES 8
+
+// Profile file layout version, bump it when the layout changes
+#define ORIC_PROF_VERSION 1
+
+// Profiler state
+typedef struct {
+  bool running;
+  uint16_t interval;
+  uint16_t countdown;  // Instructions left to the next sample
+  uint32_t samples;
+  uint32_t dropped;  // Samples counted in their page only
+  uint32_t pages[256];
+  uint16_t addr[ORIC_PROF_ADDRS];
+  uint32_t count[ORIC_PROF_ADDRS];  // 0 marks a free slot
+} oric_prof_t;
+
+// Initialize a stopped profiler, interval 0 means ORIC_PROF_INTERVAL
+void oric_prof_init(oric_prof_t* sys, uint16_t interval);
+// Clear the histograms and start sampling
+void oric_prof_start(oric_prof_t* sys);
+// Stop sampling, the histograms are kept
+void oric_prof_stop(oric_prof_t* sys);
+// Take a sample, called when the countdown has run out
+void oric_prof_sample(oric_prof_t* sys, uint16_t pc);
+// Write the histograms to profile.bin in the app folder
+bool oric_prof_save_sdcard(const oric_prof_t* sys);
+
+// Count an instruction fetch at pc
+static inline void oric_prof_sync(oric_prof_t* sys, uint16_t pc) {
+  if (sys->running && (--sys->countdown == 0)) {
+    oric_prof_sample(sys, pc);
+  }
+}
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+/*-- IMPLEMENTATION ----------------------------------------------------------*/
+#ifdef CHIPS_IMPL
+#include <string.h>  // memset
+#ifndef CHIPS_ASSERT
+#include <assert.h>
+#define CHIPS_ASSERT(c) assert(c)
+#endif
+
+void oric_prof_init(oric_prof_t* sys, uint16_t interval) {
+  CHIPS_ASSERT(sys);
+  memset(sys, 0, sizeof(oric_prof_t));
+  sys->interval = interval ? interval : ORIC_PROF_INTERVAL;
+}
+
+void oric_prof_start(oric_prof_t* sys) {
+  CHIPS_ASSERT(sys && sys->interval);
+  sys->samples = 0;
+  sys->dropped = 0;
+  memset(sys->pages, 0, sizeof(sys->pages));
+  memset(sys->count, 0, sizeof(sys->count));
+  sys->countdown = sys->interval;
+  sys->running = true;
+}
+
+void oric_prof_stop(oric_prof_t* sys) {
+  CHIPS_ASSERT(sys);
+  sys->running = false;
+}
+
+void oric_prof_sample(oric_prof_t* sys, uint16_t pc) {
+  sys->countdown = sys->interval;
+  sys->samples++;
+  sys->pages[pc >> 8]++;
+  uint32_t slot = (pc ^ (pc >> 11)) & (ORIC_PROF_ADDRS - 1);
+  for (int i = 0; i < ORIC_PROF_PROBES; i++) {
+    if (sys->count[slot] == 0) {
+      sys->addr[slot] = pc;
+    }
+    if (sys->addr[slot] == pc) {
+      sys->count[slot]++;
+      return;
+    }
+    slot = (slot + 1) & (ORIC_PROF_ADDRS - 1);
+  }
+  sys->dropped++;
+}
+
+static bool _oric_prof_write(FIL* file, const void* data, UINT len) {
+  UINT bytes_written = 0;
+  return (f_write(file, data, len, &bytes_written) == FR_OK) &&
+         (bytes_written == len);
+}
+
+// Layout, little endian:
+//   "OPRF", u8 version, u8 0, u16 interval, u32 samples, u32 dropped,
+//   u32 pages[256], u32 number of addresses,
+//   per address: u16 address, u32 samples
+bool oric_prof_save_sdcard(const oric_prof_t* sys) {
+  CHIPS_ASSERT(sys);
+  SettingsConfigEntry* folder =
+      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_FOLDER);
+  char path[256];
+  snprintf(path, sizeof(path), "%s/profile.bin",
+           folder ? folder->value : "/oric");
+  FIL file;
+  FRESULT res = f_open(&file, path, FA_CREATE_ALWAYS | FA_WRITE);
+  if (res != FR_OK) {
+    DPRINTF("Oric profiler: open failed (%d): %s\n", (int)res, path);
+    return false;
+  }
+
+  uint32_t num_addrs = 0;
+  for (int i = 0; i < ORIC_PROF_ADDRS; i++) {
+    num_addrs += (sys->count[i] != 0);
+  }
+  uint8_t header[16] = {'O', 'P', 'R', 'F', ORIC_PROF_VERSION, 0,
+                        (uint8_t)sys->interval, (uint8_t)(sys->interval >> 8)};
+  memcpy(&header[8], &sys->samples, 4);
+  memcpy(&header[12], &sys->dropped, 4);
+  bool ok = _oric_prof_write(&file, header, sizeof(header)) &&
+            _oric_prof_write(&file, sys->pages, sizeof(sys->pages)) &&
+            _oric_prof_write(&file, &num_addrs, sizeof(num_addrs));
+  // Packed 6 byte records, a sector's worth per write
+  uint8_t buf[510];
+  UINT len = 0;
+  for (int i = 0; ok && (i < ORIC_PROF_ADDRS); i++) {
+    if (sys->count[i] == 0) {
+      continue;
+    }
+    memcpy(&buf[len], &sys->addr[i], 2);
+    memcpy(&buf[len + 2], &sys->count[i], 4);
+    len += 6;
+    if (len == sizeof(buf)) {
+      ok = _oric_prof_write(&file, buf, len);
+      len = 0;
+    }
+  }
+  if (ok && len) {
+    ok = _oric_prof_write(&file, buf, len);
+  }
+  ok = (f_close(&file) == FR_OK) && ok;
+  DPRINTF("Oric profiler: %lu samples, %lu addresses saved to %s (%s)\n",
+          (unsigned long)sys->samples, (unsigned long)num_addrs, path,
+          ok ? "ok" : "failed");
+  return ok;
+}
+
+#endif  // CHIPS_IMPL
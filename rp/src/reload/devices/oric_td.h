@@ -1,5 +1,53 @@
 #pragma once
 
+// oric_td.h
+//
+// Oric tape drive playing tapes from the SD card.
+//
+// ## Edge list tape format (.edg)
+//
+// A tape is the list of its half periods, each one flips the level. Lengths
+// are in units of unit_cycles (208 cycles for the standard Oric encoding).
+//
+//   header:  "OEDG", version (1), initial level (0 or 1), unit_cycles (u16 LE)
+//   0x01 count run...   count half periods, one varint length each
+//   0x02 count byte...  count TAP bytes, each one played as the 27 half
+//                       periods of an Oric byte cell
+//   0x03 level          block marker, a program starts here at that level
+//
+// Counts and lengths are LEB128 varints. A TAP byte takes one byte instead of
+// about four in the legacy bitstream, fN.tap and legacy fN.wav files are
+// converted to fN.edg the first time they are inserted.
+//
+// oric_td_update() decodes the edge list between frames into a queue of
+// level changes, so the tape event never reads the SD card.
+//
+// ## PCM WAV captures
+//
+// A fN.wav with a RIFF header is a PCM capture of a real cassette, 8 or 16
+// bit, any rate and channel count (only the first channel is used). It is
+// played as is, so turbo loaders and protected tapes keep their timing.
+// oric_td_update() decodes it between frames: a one pole high-pass filter
+// removes the DC offset and a zero-crossing detector with hysteresis turns
+// the samples into level changes, queued for the tape event like those of an
+// edge list.
+//
+// ## Recording
+//
+// CSAVE drives the tape output (VIA PB7) from timer 1. Every level change is
+// fed to oric_td_write_edge(), which decodes the half periods back into
+// bytes and follows the file framing: synchro, header, name and data. The
+// bytes of complete files go to a RAM buffer that oric_td_update() appends
+// to a TAP image in 512 byte writes, so the SD card is never touched from
+// oric_tick(). Only the fast encoding is decoded, CSAVE with the S (slow)
+// option is ignored.
+//
+// A recording extends fN.tap of the last inserted tape only when that tape
+// was made from fN.tap. After a PCM capture, a legacy bitstream or a native
+// edge list it goes to the first fN.tap with no tape image of any kind, so
+// a source is never changed behind its edge list, and later recordings are
+// appended there until another tape is inserted.
+
 #include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
@@ -7,6 +55,7 @@
 
 #include "aconfig.h"
 #include "ff.h"
+#include "perf.h"
 #include "settings/settings.h"
 
 #ifdef __cplusplus
@@ -20,18 +69,115 @@ extern "C" {
 #define ORIC_TD_PORT_PLAY (1 << 3)
 #define ORIC_TD_PORT_RECORD (1 << 4)
 
+// Cycles per unit of the standard Oric tape encoding
+#define ORIC_TD_UNIT_CYCLES (208)
+
+// Edge list records
+#define ORIC_TD_EDG_RUNS (0x01)
+#define ORIC_TD_EDG_BYTES (0x02)
+#define ORIC_TD_EDG_BLOCK (0x03)
+
+#define ORIC_TD_EDG_HEADER_SIZE (8)
+#define ORIC_TD_CELL_HALF_PERIODS (27)  // Half periods of an Oric byte cell
+
+// Read buffer of the edge list
+#ifndef ORIC_TD_BUFFER_SIZE
+#define ORIC_TD_BUFFER_SIZE (32)
+#endif
+
+// Level changes decoded ahead of the tape event, a power of 2
+#ifndef ORIC_TD_EDGES
+#define ORIC_TD_EDGES (256)
+#endif
+
+// Hysteresis of the zero-crossing detector, in 16 bit sample units
+#ifndef ORIC_TD_PCM_HYSTERESIS
+#define ORIC_TD_PCM_HYSTERESIS (1024)
+#endif
+
+// Recording buffer, a power of 2 and a multiple of ORIC_TD_REC_WRITE
+#ifndef ORIC_TD_REC_BUFFER
+#define ORIC_TD_REC_BUFFER (1024)
+#endif
+
+// Bytes written to the SD card at once while recording
+#define ORIC_TD_REC_WRITE (512)
+
+// Tapes the F keys can insert, f1 to f10
+#define ORIC_TD_MAX_TAPES (10)
+
+// Programs indexed on a tape
+#ifndef ORIC_TD_MAX_BLOCKS
+#define ORIC_TD_MAX_BLOCKS (16)
+#endif
+
+// A program on the tape, from the header after its block marker
+typedef struct {
+  uint32_t offset;  // Offset of the block marker in the edge list
+  uint16_t start;   // Load address
+  uint16_t end;     // Last address
+  uint8_t type;     // 0x00 BASIC, 0x80 machine code
+  char name[17];
+} oric_td_block_t;
+
 // Oric tape drive state
 typedef struct {
   uint8_t port;
   bool valid;
-  uint32_t pos;
-  uint32_t bit_pos;
-  uint32_t size;
-  uint8_t* wave_image;
+  uint32_t pos;   // Bytes of the edge list read so far
+  uint32_t size;  // Size of the edge list file
   FIL sd_file;
   bool sd_file_open;
-  uint8_t sd_byte;
-  bool sd_have_byte;
+  uint8_t level;         // Level of the next half period
+  uint16_t unit_cycles;  // Cycles per length unit
+  uint8_t rec;           // Record being played, ORIC_TD_EDG_*
+  uint32_t rec_left;     // Half periods or bytes left in the record
+  uint8_t cell_byte;     // TAP byte being played
+  uint8_t cell_pos;      // Next half period of its byte cell
+  uint8_t buf_pos;
+  uint8_t buf_len;
+  uint8_t buf[ORIC_TD_BUFFER_SIZE];
+  uint8_t num_blocks;  // Programs indexed at insert time
+  uint8_t block;       // Program under the head, or the next one
+  oric_td_block_t blocks[ORIC_TD_MAX_BLOCKS];
+  // Level changes decoded ahead
+  bool eof;             // The whole tape is decoded
+  uint16_t edge_head;   // Next free slot of edges
+  uint16_t edge_tail;   // Next level change to play
+  uint32_t underruns;   // Times playback found no decoded level change
+  uint32_t edges[ORIC_TD_EDGES];  // Cycles, level in bit 31
+  // PCM capture
+  bool pcm;              // Playing a PCM capture instead of an edge list
+  uint8_t pcm_frame;     // Bytes per sample frame, all channels
+  uint8_t pcm_bits;      // 8 or 16 bits per sample
+  uint8_t pcm_level;     // Level of the segment being measured
+  uint32_t pcm_left;     // Bytes of sample data left in the file
+  uint32_t pcm_step;     // Cycles per sample, 16.16 fixed point
+  uint32_t pcm_frac;     // Fraction of a cycle carried over, 16.16
+  uint32_t pcm_cycles;   // Length of the segment being measured
+  int32_t pcm_x;         // Previous input sample of the high-pass filter
+  int32_t pcm_y;         // Previous output of the high-pass filter
+  uint16_t pcm_blk_pos;  // Next byte of the sample block
+  uint16_t pcm_blk_len;
+  // Recording
+  int index;              // Last inserted tape
+  int rec_index;          // Tape recordings go to, -1 to pick a free one
+  uint32_t out_tick;      // Tick of the last tape output level change
+  bool out_busy;          // Decoding the bits of a byte
+  uint8_t out_count;      // Half periods decoded after the start bit
+  uint16_t out_bits;      // Data bits and parity, bit 0 first
+  uint8_t rec_state;      // File framing state
+  uint8_t rec_syncs;      // Synchro bytes in a row
+  uint8_t rec_hdr_pos;
+  uint8_t rec_hdr[9];     // File header, end and start address at 4..7
+  uint32_t rec_data_left;  // Data bytes left in the file
+  uint32_t rec_errors;    // Parity and framing errors of the recording
+  bool rec_done;          // A file is complete, flush it
+  bool rec_open;          // rec_file is open
+  uint16_t rec_head;
+  uint16_t rec_tail;
+  FIL rec_file;
+  uint8_t rec_buf[ORIC_TD_REC_BUFFER];
 } oric_td_t;
 
 // Oric tape drive interface
@@ -45,14 +191,32 @@ void oric_td_discard(oric_td_t* sys);
 // Reset the tape drive
 void oric_td_reset(oric_td_t* sys);
 
-// Tick the tape drive reading from SD card
-void oric_td_tick_sdcard(oric_td_t* sys);
+// Put the tape level under the head on ORIC_TD_PORT_READ and return the
+// cycles until the level changes, 0 at the end of the tape or with the motor
+// off
+uint32_t oric_td_next_edge_sdcard(oric_td_t* sys);
+
+// Decode the tape ahead of the tape event and write recorded files, call
+// between frames
+void oric_td_update(oric_td_t* sys);
 
-// Insert a new tape file from SD card
+// Move the head to the start of an indexed program
+bool oric_td_seek_block(oric_td_t* sys, int block);
+
+// Toggle the tape output level (ORIC_TD_PORT_WRITE) at tick now
+void oric_td_write_edge(oric_td_t* sys, uint32_t now);
+
+// Insert the tape fN.edg from SD card, N is index + 1. fN.tap or a legacy
+// fN.wav bitstream are converted to fN.edg first, a PCM fN.wav is played
+// directly.
 bool oric_td_insert_tape_sdcard(oric_td_t* sys, int index);
 
-// Convert TAP image into WAVE image stored on SD card
-bool oric_convert_tap_to_wave(const char* tap_path, const char* wave_path);
+// Convert TAP image into an edge list stored on SD card
+bool oric_convert_tap_to_edg(const char* tap_path, const char* edg_path);
+
+// Convert a legacy bitstream fN.wav (4-byte length, one bit per unit) into an
+// edge list stored on SD card
+bool oric_convert_wave_to_edg(const char* wave_path, const char* edg_path);
 
 // Remove the tape file from SD card
 void oric_td_remove_tape_sdcard(oric_td_t* sys);
@@ -79,86 +243,131 @@ void oric_td_snapshot_onload(oric_td_t* snapshot, oric_td_t* sys);
 #define CHIPS_ASSERT(c) assert(c)
 #endif
 
+// File framing states of the recording
+#define ORIC_TD_REC_SYNC (0)
+#define ORIC_TD_REC_HEADER (1)
+#define ORIC_TD_REC_NAME (2)
+#define ORIC_TD_REC_DATA (3)
+
+// Half period length of an Oric byte cell: a short half period, a 0 start
+// bit, 8 data bits from bit 0, parity and 3 stop bits. A bit is a short half
+// period followed by a short one for 1 and a long one for 0.
+static uint8_t oric_td_cell_run(uint8_t value, uint8_t pos) {
+  if (pos < 3) {
+    return (pos == 2) ? 2 : 1;
+  }
+  if ((pos & 1) || (pos > 20)) {
+    return 1;
+  }
+  uint8_t bit;
+  if (pos == 20) {
+    bit = (uint8_t)((1 + __builtin_popcount(value)) & 1);
+  } else {
+    bit = (value >> ((pos - 4) / 2)) & 1;
+  }
+  return bit ? 1 : 2;
+}
+
+// Items per record written by the converters
+#define ORIC_EDG_MAX_ITEMS 128
+
 typedef struct {
   FIL* out;
-  uint32_t wave_size;
-  uint8_t current_level;
-  uint8_t shifter;
-  uint8_t shift_count;
-} oric_tap_stream_t;
-
-static bool oric_tap_write_byte(oric_tap_stream_t* st, uint8_t value) {
+  uint32_t size;  // Bytes written
+  uint8_t level;  // Level of the next half period
+  uint8_t rec;    // Open record
+  uint16_t count;
+  uint16_t len;
+  uint8_t payload[ORIC_EDG_MAX_ITEMS * 5];
+} oric_edg_writer_t;
+
+static bool oric_edg_write(oric_edg_writer_t* w, const uint8_t* data,
+                           UINT len) {
   UINT bytes_written = 0;
-  FRESULT res = f_write(st->out, &value, 1, &bytes_written);
-  if (res != FR_OK || bytes_written != 1) {
+  FRESULT res = f_write(w->out, data, len, &bytes_written);
+  if (res != FR_OK || bytes_written != len) {
     return false;
   }
-  st->wave_size++;
+  w->size += len;
   return true;
 }
 
-static bool oric_tap_flush_output(oric_tap_stream_t* st) {
-  for (int i = 0; i < 8 - st->shift_count; i++) {
-    st->shifter = (uint8_t)((st->shifter << 1) | 1);
+static uint8_t oric_edg_put_varint(uint8_t* p, uint32_t value) {
+  uint8_t n = 0;
+  while (value >= 0x80) {
+    p[n++] = (uint8_t)(value | 0x80);
+    value >>= 7;
   }
-  return oric_tap_write_byte(st, st->shifter);
+  p[n++] = (uint8_t)value;
+  return n;
 }
 
-static bool oric_tap_output_half_period(oric_tap_stream_t* st,
-                                        uint8_t length) {
-  for (int i = 0; i < length; i++) {
-    st->shifter = (uint8_t)((st->shifter << 1) | st->current_level);
-    st->shift_count++;
-    if (st->shift_count == 8) {
-      st->shift_count = 0;
-      if (!oric_tap_write_byte(st, st->shifter)) {
-        return false;
-      }
-    }
+static bool oric_edg_flush(oric_edg_writer_t* w) {
+  if (w->count == 0) {
+    return true;
   }
-  st->current_level ^= 1;
-  return true;
-}
-
-static bool oric_tap_output_bit(oric_tap_stream_t* st, uint8_t bit) {
-  if (!oric_tap_output_half_period(st, 1)) {
+  uint8_t head[6];
+  head[0] = w->rec;
+  const uint8_t n = oric_edg_put_varint(&head[1], w->count);
+  w->count = 0;
+  if (!oric_edg_write(w, head, 1 + n)) {
     return false;
   }
-  return oric_tap_output_half_period(st, bit ? 1 : 2);
+  const uint16_t len = w->len;
+  w->len = 0;
+  return oric_edg_write(w, w->payload, len);
 }
 
-static bool oric_tap_output_byte(oric_tap_stream_t* st, uint8_t value) {
-  if (!oric_tap_output_half_period(st, 1)) {
-    return false;
-  }
-  if (!oric_tap_output_bit(st, 0)) {
-    return false;
-  }
-
-  uint8_t parity = 1;
-
-  for (int i = 0; i < 8; i++) {
-    uint8_t bit = value & 1;
-    parity = (uint8_t)(parity + bit);
-    if (!oric_tap_output_bit(st, bit)) {
+static bool oric_edg_open(oric_edg_writer_t* w, uint8_t rec) {
+  if ((w->rec != rec) || (w->count == ORIC_EDG_MAX_ITEMS)) {
+    if (!oric_edg_flush(w)) {
       return false;
     }
-    value >>= 1;
+    w->rec = rec;
   }
+  w->count++;
+  return true;
+}
+
+static bool oric_edg_begin(oric_edg_writer_t* w, FIL* out) {
+  memset(w, 0, sizeof(oric_edg_writer_t));
+  w->out = out;
+  const uint8_t header[ORIC_TD_EDG_HEADER_SIZE] = {
+      'O', 'E', 'D', 'G', 1, 0, ORIC_TD_UNIT_CYCLES & 0xFF,
+      ORIC_TD_UNIT_CYCLES >> 8};
+  return oric_edg_write(w, header, sizeof(header));
+}
 
-  if (!oric_tap_output_bit(st, parity & 1)) {
+static bool oric_tap_output_half_period(oric_edg_writer_t* w,
+                                        uint32_t length) {
+  if (!oric_edg_open(w, ORIC_TD_EDG_RUNS)) {
     return false;
   }
+  w->len += oric_edg_put_varint(&w->payload[w->len], length);
+  w->level ^= 1;
+  return true;
+}
 
-  if (!oric_tap_output_bit(st, 1)) {
+static bool oric_tap_output_byte(oric_edg_writer_t* w, uint8_t value) {
+  if (!oric_edg_open(w, ORIC_TD_EDG_BYTES)) {
     return false;
   }
-  if (!oric_tap_output_bit(st, 1)) {
+  w->payload[w->len++] = value;
+  w->level ^= ORIC_TD_CELL_HALF_PERIODS & 1;
+  return true;
+}
+
+static bool oric_tap_output_block(oric_edg_writer_t* w) {
+  if (!oric_edg_flush(w)) {
     return false;
   }
-  return oric_tap_output_bit(st, 1);
+  const uint8_t marker[2] = {ORIC_TD_EDG_BLOCK, w->level};
+  return oric_edg_write(w, marker, sizeof(marker));
 }
 
+// Statically allocated, the converters run on the small main stack
+static oric_edg_writer_t oric_edg_writer;
+
 #ifndef ORIC_TAP_INPUT_BUFFER_SIZE
 #define ORIC_TAP_INPUT_BUFFER_SIZE 256
 #endif
@@ -221,7 +430,10 @@ static bool oric_tap_find_synchro(oric_tap_input_t* in_state) {
   return false;
 }
 
-static bool oric_tap_output_big_synchro(oric_tap_stream_t* st) {
+static bool oric_tap_output_big_synchro(oric_edg_writer_t* st) {
+  if (!oric_tap_output_block(st)) {
+    return false;
+  }
   for (int i = 0; i < 259; i++) {
     if (!oric_tap_output_byte(st, 0x16)) {
       return false;
@@ -231,7 +443,7 @@ static bool oric_tap_output_big_synchro(oric_tap_stream_t* st) {
 }
 
 static bool oric_tap_output_file(oric_tap_input_t* in_state,
-                                 oric_tap_stream_t* st) {
+                                 oric_edg_writer_t* st) {
   uint8_t header[9];
   uint32_t i = 0;
 
@@ -299,125 +511,198 @@ static bool oric_tap_output_file(oric_tap_input_t* in_state,
   return true;
 }
 
-bool oric_convert_tap_to_wave(const char* tap_path, const char* wave_path) {
+bool oric_convert_tap_to_edg(const char* tap_path, const char* edg_path) {
   FIL in;
   FIL out;
   FRESULT res;
-  UINT bytes_written = 0;
   uint64_t start_time = GET_CURRENT_TIME();
 
-  if (!tap_path || !wave_path) {
-    DPRINTF("Oric TD: convert_tap_to_wave invalid path\n");
+  if (!tap_path || !edg_path) {
+    DPRINTF("Oric TD: convert_tap_to_edg invalid path\n");
     return false;
   }
 
   res = f_open(&in, tap_path, FA_READ);
   if (res != FR_OK) {
-    DPRINTF("Oric TD: convert_tap_to_wave open tap failed (%d): %s\n",
+    DPRINTF("Oric TD: convert_tap_to_edg open tap failed (%d): %s\n",
             (int)res,
             tap_path);
     return false;
   }
 
-  res = f_open(&out, wave_path, FA_CREATE_ALWAYS | FA_WRITE);
+  res = f_open(&out, edg_path, FA_CREATE_ALWAYS | FA_WRITE);
   if (res != FR_OK) {
-    DPRINTF("Oric TD: convert_tap_to_wave open wav failed (%d): %s\n",
+    DPRINTF("Oric TD: convert_tap_to_edg open edg failed (%d): %s\n",
             (int)res,
-            wave_path);
+            edg_path);
     f_close(&in);
     return false;
   }
 
-  uint8_t header[4] = {0, 0, 0, 0};
-  res = f_write(&out, header, sizeof(header), &bytes_written);
-  if (res != FR_OK || bytes_written != sizeof(header)) {
-    DPRINTF("Oric TD: convert_tap_to_wave header write failed (%d)\n",
-            (int)res);
-    f_close(&out);
-    f_close(&in);
-    return false;
+  oric_edg_writer_t* st = &oric_edg_writer;
+  bool ok = oric_edg_begin(st, &out);
+  for (int i = 0; ok && i < 5; i++) {
+    ok = oric_tap_output_half_period(st, 1);
   }
-
-  oric_tap_stream_t st = {
-      .out = &out,
-      .wave_size = 0,
-      .current_level = 0,
-      .shifter = 0,
-      .shift_count = 0,
-  };
-
-  for (int i = 0; i < 5; i++) {
-    if (!oric_tap_output_half_period(&st, 1)) {
-      DPRINTF("Oric TD: convert_tap_to_wave gap write failed\n");
-      f_close(&out);
-      f_close(&in);
-      return false;
-    }
+  if (!ok) {
+    DPRINTF("Oric TD: convert_tap_to_edg gap write failed\n");
   }
 
   uint32_t size = f_size(&in);
   oric_tap_input_t in_state;
   oric_tap_input_init(&in_state, &in, size);
   uint32_t last_log_pos = 0;
-  DPRINTF("Oric TD: convert_tap_to_wave start size=%lu\n",
+  DPRINTF("Oric TD: convert_tap_to_edg start size=%lu\n",
           (unsigned long)size);
-  while (in_state.pos < size) {
-    if (oric_tap_find_synchro(&in_state)) {
-      if (!oric_tap_output_big_synchro(&st)) {
-        DPRINTF("Oric TD: convert_tap_to_wave big synchro failed\n");
-        f_close(&out);
-        f_close(&in);
-        return false;
-      }
-      if (!oric_tap_output_file(&in_state, &st)) {
-        DPRINTF("Oric TD: convert_tap_to_wave file output failed\n");
-        f_close(&out);
-        f_close(&in);
-        return false;
-      }
-      if (in_state.pos - last_log_pos >= 4096) {
-        DPRINTF("Oric TD: convert_tap_to_wave progress %lu/%lu\n",
-                (unsigned long)in_state.pos,
-                (unsigned long)size);
-        last_log_pos = in_state.pos;
-      }
-    } else {
+  while (ok && in_state.pos < size) {
+    if (!oric_tap_find_synchro(&in_state)) {
       break;
     }
+    if (!oric_tap_output_big_synchro(st)) {
+      DPRINTF("Oric TD: convert_tap_to_edg big synchro failed\n");
+      ok = false;
+    } else if (!oric_tap_output_file(&in_state, st)) {
+      DPRINTF("Oric TD: convert_tap_to_edg file output failed\n");
+      ok = false;
+    }
+    if (in_state.pos - last_log_pos >= 4096) {
+      DPRINTF("Oric TD: convert_tap_to_edg progress %lu/%lu\n",
+              (unsigned long)in_state.pos,
+              (unsigned long)size);
+      last_log_pos = in_state.pos;
+    }
   }
 
-  if (!oric_tap_flush_output(&st)) {
-    DPRINTF("Oric TD: convert_tap_to_wave flush failed\n");
-    f_close(&out);
-    f_close(&in);
-    return false;
+  if (ok && !oric_edg_flush(st)) {
+    DPRINTF("Oric TD: convert_tap_to_edg flush failed\n");
+    ok = false;
   }
 
-  if (f_lseek(&out, 0) != FR_OK) {
-    DPRINTF("Oric TD: convert_tap_to_wave seek failed\n");
-    f_close(&out);
-    f_close(&in);
+  f_close(&out);
+  f_close(&in);
+  if (!ok) {
+    f_unlink(edg_path);
     return false;
   }
+  DPRINTF("Oric TD: convert_tap_to_edg done (%lu -> %lu bytes) in %lu ms\n",
+          (unsigned long)size,
+          (unsigned long)st->size,
+          (unsigned long)GET_CURRENT_TIME_INTERVAL_MS(start_time));
+  return true;
+}
+
+// Emit the oldest queued run, as a byte when the queue starts with a valid
+// byte cell, otherwise as a raw half period
+static bool oric_wave_emit(oric_edg_writer_t* w, uint32_t* q, uint32_t* n) {
+  uint32_t used = 1;
+  bool cell = *n >= ORIC_TD_CELL_HALF_PERIODS;
+  uint8_t value = 0;
+  for (uint8_t i = 0; cell && i < 8; i++) {
+    value |= (uint8_t)((q[4 + 2 * i] == 1) << i);
+  }
+  for (uint8_t i = 0; cell && i < ORIC_TD_CELL_HALF_PERIODS; i++) {
+    cell = q[i] == oric_td_cell_run(value, i);
+  }
+  bool ok;
+  if (cell) {
+    used = ORIC_TD_CELL_HALF_PERIODS;
+    ok = oric_tap_output_byte(w, value);
+  } else {
+    ok = oric_tap_output_half_period(w, q[0]);
+  }
+  *n -= used;
+  memmove(q, q + used, *n * sizeof(uint32_t));
+  return ok;
+}
 
-  header[0] = (uint8_t)(st.wave_size & 0xFFu);
-  header[1] = (uint8_t)((st.wave_size >> 8) & 0xFFu);
-  header[2] = (uint8_t)((st.wave_size >> 16) & 0xFFu);
-  header[3] = (uint8_t)((st.wave_size >> 24) & 0xFFu);
+bool oric_convert_wave_to_edg(const char* wave_path, const char* edg_path) {
+  FIL in;
+  FIL out;
+  FRESULT res;
+  uint64_t start_time = GET_CURRENT_TIME();
 
-  res = f_write(&out, header, sizeof(header), &bytes_written);
-  if (res != FR_OK || bytes_written != sizeof(header)) {
-    DPRINTF("Oric TD: convert_tap_to_wave size write failed (%d)\n",
-            (int)res);
-    f_close(&out);
+  res = f_open(&in, wave_path, FA_READ);
+  if (res != FR_OK) {
+    DPRINTF("Oric TD: convert_wave_to_edg open wav failed (%d): %s\n",
+            (int)res,
+            wave_path);
+    return false;
+  }
+  res = f_open(&out, edg_path, FA_CREATE_ALWAYS | FA_WRITE);
+  if (res != FR_OK) {
+    DPRINTF("Oric TD: convert_wave_to_edg open edg failed (%d): %s\n",
+            (int)res,
+            edg_path);
     f_close(&in);
     return false;
   }
 
+  oric_tap_input_t in_state;
+  oric_tap_input_init(&in_state, &in, f_size(&in));
+  uint8_t header[4];
+  bool ok = true;
+  for (int i = 0; ok && i < 4; i++) {
+    ok = oric_tap_read_byte(&in_state, &header[i]);
+  }
+  if (ok && (memcmp(header, "RIFF", 4) == 0)) {
+    DPRINTF("Oric TD: %s is not a legacy bitstream\n", wave_path);
+    ok = false;
+  }
+  uint32_t size =
+      header[0] | (header[1] << 8) | (header[2] << 16) | (header[3] << 24);
+  if (ok && (size > in_state.size - 4)) {
+    size = in_state.size - 4;
+  }
+
+  oric_edg_writer_t* w = &oric_edg_writer;
+  uint8_t first = 0;
+  ok = ok && oric_edg_begin(w, &out);
+  uint32_t q[ORIC_TD_CELL_HALF_PERIODS];
+  uint32_t n = 0;
+  int level = -1;
+  uint32_t run = 0;
+  for (uint32_t i = 0; ok && i < size; i++) {
+    uint8_t b;
+    ok = oric_tap_read_byte(&in_state, &b);
+    for (int bit_pos = 7; ok && bit_pos >= 0; bit_pos--) {
+      const int bit = (b >> bit_pos) & 1;
+      if (level < 0) {
+        level = bit;
+        first = (uint8_t)bit;
+      } else if (bit != level) {
+        q[n++] = run;
+        run = 0;
+        level = bit;
+        if (n == ORIC_TD_CELL_HALF_PERIODS) {
+          ok = oric_wave_emit(w, q, &n);
+        }
+      }
+      run++;
+    }
+  }
+  if (run) {
+    q[n++] = run;
+  }
+  while (ok && n) {
+    ok = oric_wave_emit(w, q, &n);
+  }
+  ok = ok && oric_edg_flush(w);
+  // Patch the initial level
+  ok = ok && (f_lseek(&out, 5) == FR_OK);
+  UINT bytes_written = 0;
+  ok = ok && (f_write(&out, &first, 1, &bytes_written) == FR_OK) &&
+       (bytes_written == 1);
+
   f_close(&out);
   f_close(&in);
-  DPRINTF("Oric TD: convert_tap_to_wave done (%lu bytes) in %lu ms\n",
-          (unsigned long)st.wave_size,
+  if (!ok) {
+    DPRINTF("Oric TD: convert_wave_to_edg failed: %s\n", wave_path);
+    f_unlink(edg_path);
+    return false;
+  }
+  DPRINTF("Oric TD: convert_wave_to_edg done (%lu -> %lu bytes) in %lu ms\n",
+          (unsigned long)in_state.size,
+          (unsigned long)w->size,
           (unsigned long)GET_CURRENT_TIME_INTERVAL_MS(start_time));
   return true;
 }
@@ -426,7 +711,7 @@ void oric_td_init(oric_td_t* sys) {
   CHIPS_ASSERT(sys && !sys->valid);
   memset(sys, 0, sizeof(oric_td_t));
   sys->valid = true;
-  sys->bit_pos = 7;
+  sys->rec_index = -1;
 }
 
 void oric_td_discard(oric_td_t* sys) {
@@ -439,110 +724,738 @@ void oric_td_reset(oric_td_t* sys) {
   sys->port = 0;
   sys->size = 0;
   sys->pos = 0;
-  sys->bit_pos = 7;
   sys->sd_file_open = false;
-  sys->sd_have_byte = false;
+  sys->out_busy = false;
+  sys->rec_state = ORIC_TD_REC_SYNC;
+  sys->rec_syncs = 0;
 }
 
-void oric_td_tick_sdcard(oric_td_t* sys) {
-  CHIPS_ASSERT(sys && sys->valid);
+// Level bit of a queued level change
+#define ORIC_TD_EDGE_LEVEL (1u << 31)
+
+// Cycles to hold the level when the decoder has fallen behind
+#define ORIC_TD_STALL_CYCLES (1024)
+
+static void oric_td_push_edge(oric_td_t* sys, uint32_t cycles,
+                              uint8_t level) {
+  sys->edges[sys->edge_head & (ORIC_TD_EDGES - 1)] =
+      cycles | (level ? ORIC_TD_EDGE_LEVEL : 0);
+  sys->edge_head++;
+}
+
+// Drop the queued level changes, decoding starts over from the reader
+static void oric_td_flush_edges(oric_td_t* sys) {
+  sys->edge_head = 0;
+  sys->edge_tail = 0;
+  sys->eof = false;
+}
+
+static bool oric_td_read_byte(oric_td_t* sys, uint8_t* value) {
+  if (sys->buf_pos >= sys->buf_len) {
+    PERF_COUNT(PERF_FATFS_CALLS);
+    UINT bytes_read = 0;
+    FRESULT res =
+        f_read(&sys->sd_file, sys->buf, sizeof(sys->buf), &bytes_read);
+    if (res != FR_OK || bytes_read == 0) {
+      return false;
+    }
+    sys->buf_pos = 0;
+    sys->buf_len = (uint8_t)bytes_read;
+  }
+  *value = sys->buf[sys->buf_pos++];
+  sys->pos++;
+  return true;
+}
+
+static bool oric_td_read_varint(oric_td_t* sys, uint32_t* value) {
+  uint32_t v = 0;
+  for (int shift = 0; shift < 32; shift += 7) {
+    uint8_t b;
+    if (!oric_td_read_byte(sys, &b)) {
+      return false;
+    }
+    v |= (uint32_t)(b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      *value = v;
+      return true;
+    }
+  }
+  return false;
+}
+
+// Length in units of the next half period, false at the end of the tape
+static bool oric_td_next_half_period(oric_td_t* sys, uint32_t* units) {
+  while (true) {
+    if (sys->rec_left == 0) {
+      uint8_t rec;
+      if (!oric_td_read_byte(sys, &rec)) {
+        return false;
+      }
+      if (rec == ORIC_TD_EDG_BLOCK) {
+        const uint32_t offset = sys->pos - 1;
+        uint8_t level;
+        if (!oric_td_read_byte(sys, &level)) {
+          return false;
+        }
+        sys->level = level & 1;
+        for (uint8_t i = 0; i < sys->num_blocks; i++) {
+          if (sys->blocks[i].offset == offset) {
+            sys->block = i;
+          }
+        }
+        continue;
+      }
+      if ((rec != ORIC_TD_EDG_RUNS) && (rec != ORIC_TD_EDG_BYTES)) {
+        DPRINTF("Oric TD: bad edge list record %02x at %lu\n", rec,
+                (unsigned long)sys->pos);
+        return false;
+      }
+      if (!oric_td_read_varint(sys, &sys->rec_left)) {
+        return false;
+      }
+      sys->rec = rec;
+      sys->cell_pos = ORIC_TD_CELL_HALF_PERIODS;
+      continue;
+    }
+    if (sys->rec == ORIC_TD_EDG_RUNS) {
+      sys->rec_left--;
+      return oric_td_read_varint(sys, units);
+    }
+    if (sys->cell_pos == ORIC_TD_CELL_HALF_PERIODS) {
+      if (!oric_td_read_byte(sys, &sys->cell_byte)) {
+        return false;
+      }
+      sys->cell_pos = 0;
+    }
+    *units = oric_td_cell_run(sys->cell_byte, sys->cell_pos++);
+    if (sys->cell_pos == ORIC_TD_CELL_HALF_PERIODS) {
+      sys->rec_left--;
+    }
+    return true;
+  }
+}
+
+// Decode the edge list into the queue of level changes
+static void oric_td_update_edg(oric_td_t* sys) {
   static uint32_t last_logged_pos = (uint32_t)-1;
-  if (!sys->sd_file_open) {
+  if (!sys->sd_file_open || sys->pcm || sys->eof) {
+    return;
+  }
+  while ((uint16_t)(sys->edge_head - sys->edge_tail) < ORIC_TD_EDGES) {
+    uint32_t units;
+    if ((sys->pos >= sys->size) || !oric_td_next_half_period(sys, &units)) {
+      sys->eof = true;
+      break;
+    }
+    oric_td_push_edge(sys, units * sys->unit_cycles, sys->level);
+    sys->level ^= 1;
+  }
+  if ((sys->pos / 1000u) != (last_logged_pos / 1000u)) {
+    DPRINTF("Oric TD: read pos=%lu\n", (unsigned long)sys->pos);
+    last_logged_pos = sys->pos;
+  }
+}
+
+// Bytes read from the PCM capture at once, a multiple of every frame size
+#define ORIC_TD_PCM_BLOCK (480)
+
+// Only touched from the main loop, one tape drive per system
+static uint8_t oric_td_pcm_block[ORIC_TD_PCM_BLOCK];
+
+static uint32_t oric_td_le(const uint8_t* p, int bytes) {
+  uint32_t value = 0;
+  for (int i = bytes - 1; i >= 0; i--) {
+    value = (value << 8) | p[i];
+  }
+  return value;
+}
+
+// Open a RIFF PCM capture and move to its sample data
+static bool oric_td_open_pcm(oric_td_t* sys, const char* path) {
+  FRESULT res = f_open(&sys->sd_file, path, FA_READ);
+  if (res != FR_OK) {
+    return false;
+  }
+  uint8_t chunk[16];
+  UINT bytes_read = 0;
+  res = f_read(&sys->sd_file, chunk, 12, &bytes_read);
+  if (res != FR_OK || bytes_read != 12 || memcmp(chunk, "RIFF", 4) != 0 ||
+      memcmp(&chunk[8], "WAVE", 4) != 0) {
+    f_close(&sys->sd_file);
+    return false;
+  }
+
+  uint32_t offset = 12;
+  uint32_t rate = 0;
+  sys->pcm_frame = 0;
+  while (true) {
+    res = f_read(&sys->sd_file, chunk, 8, &bytes_read);
+    if (res != FR_OK || bytes_read != 8) {
+      DPRINTF("Oric TD: wav without data chunk: %s\n", path);
+      f_close(&sys->sd_file);
+      return false;
+    }
+    const uint32_t size = oric_td_le(&chunk[4], 4);
+    offset += 8;
+    if (memcmp(chunk, "data", 4) == 0) {
+      sys->pcm_left = size;
+      break;
+    }
+    if ((memcmp(chunk, "fmt ", 4) == 0) && (size >= 16)) {
+      res = f_read(&sys->sd_file, chunk, 16, &bytes_read);
+      if (res != FR_OK || bytes_read != 16) {
+        f_close(&sys->sd_file);
+        return false;
+      }
+      const uint16_t format = (uint16_t)oric_td_le(&chunk[0], 2);
+      const uint16_t channels = (uint16_t)oric_td_le(&chunk[2], 2);
+      rate = oric_td_le(&chunk[4], 4);
+      sys->pcm_bits = (uint8_t)oric_td_le(&chunk[14], 2);
+      sys->pcm_frame = (uint8_t)(channels * (sys->pcm_bits / 8));
+      // WAVE_FORMAT_PCM or WAVE_FORMAT_EXTENSIBLE
+      if (((format != 1) && (format != 0xFFFE)) || (channels == 0) ||
+          (channels > 2) || (rate < 8000) ||
+          ((sys->pcm_bits != 8) && (sys->pcm_bits != 16))) {
+        DPRINTF("Oric TD: unsupported wav (fmt %u, %u ch, %lu Hz, %u bits)\n",
+                format, channels, (unsigned long)rate, sys->pcm_bits);
+        f_close(&sys->sd_file);
+        return false;
+      }
+    }
+    // Chunks are padded to an even size
+    offset += size + (size & 1);
+    if (f_lseek(&sys->sd_file, offset) != FR_OK) {
+      f_close(&sys->sd_file);
+      return false;
+    }
+  }
+  if (sys->pcm_frame == 0) {
+    DPRINTF("Oric TD: wav data before fmt chunk: %s\n", path);
+    f_close(&sys->sd_file);
+    return false;
+  }
+
+  // The Oric runs at 1 MHz, one cycle per microsecond
+  sys->pcm_step = (uint32_t)((1000000ull << 16) / rate);
+  sys->pcm_left -= sys->pcm_left % sys->pcm_frame;
+  sys->pcm = true;
+  sys->pcm_level = 0;
+  sys->pcm_frac = 0;
+  sys->pcm_cycles = 0;
+  sys->pcm_x = 0;
+  sys->pcm_y = 0;
+  oric_td_flush_edges(sys);
+  sys->pcm_blk_pos = 0;
+  sys->pcm_blk_len = 0;
+  sys->size = f_size(&sys->sd_file);
+  sys->pos = offset;
+  sys->sd_file_open = true;
+  DPRINTF("Oric TD: wav capture %lu Hz, %u bits, %lu bytes\n",
+          (unsigned long)rate, sys->pcm_bits, (unsigned long)sys->pcm_left);
+  return true;
+}
+
+static void oric_td_pcm_push(oric_td_t* sys) {
+  oric_td_push_edge(sys, sys->pcm_cycles, sys->pcm_level);
+  sys->pcm_cycles = 0;
+}
+
+static void oric_td_update_pcm(oric_td_t* sys) {
+  if (!sys->pcm || sys->eof) {
     return;
   }
-  if (!oric_td_is_motor_on(sys) || sys->size == 0 || sys->pos >= sys->size) {
+  while ((uint16_t)(sys->edge_head - sys->edge_tail) < ORIC_TD_EDGES) {
+    if (sys->pcm_blk_pos >= sys->pcm_blk_len) {
+      UINT want = ORIC_TD_PCM_BLOCK - (ORIC_TD_PCM_BLOCK % sys->pcm_frame);
+      if (want > sys->pcm_left) {
+        want = sys->pcm_left;
+      }
+      UINT bytes_read = 0;
+      PERF_COUNT(PERF_FATFS_CALLS);
+      if ((want == 0) ||
+          (f_read(&sys->sd_file, oric_td_pcm_block, want, &bytes_read) !=
+           FR_OK) ||
+          (bytes_read < sys->pcm_frame)) {
+        // The last segment ends with the capture
+        if (sys->pcm_cycles) {
+          oric_td_pcm_push(sys);
+        }
+        sys->eof = true;
+        return;
+      }
+      sys->pcm_left -= bytes_read;
+      sys->pos += bytes_read;
+      sys->pcm_blk_pos = 0;
+      sys->pcm_blk_len = (uint16_t)(bytes_read - bytes_read % sys->pcm_frame);
+    }
+
+    const uint8_t* p = &oric_td_pcm_block[sys->pcm_blk_pos];
+    sys->pcm_blk_pos += sys->pcm_frame;
+    int32_t x;
+    if (sys->pcm_bits == 8) {
+      x = ((int32_t)p[0] - 128) << 8;
+    } else {
+      x = (int16_t)(p[0] | (p[1] << 8));
+    }
+    // y[n] = x[n] - x[n-1] + (1 - 1/256) y[n-1], about 27 Hz at 44.1 kHz
+    const int32_t y = x - sys->pcm_x + sys->pcm_y - (sys->pcm_y >> 8);
+    sys->pcm_x = x;
+    sys->pcm_y = y;
+
+    sys->pcm_frac += sys->pcm_step;
+    sys->pcm_cycles += sys->pcm_frac >> 16;
+    sys->pcm_frac &= 0xFFFF;
+    if (sys->pcm_level ? (y < -ORIC_TD_PCM_HYSTERESIS)
+                       : (y > ORIC_TD_PCM_HYSTERESIS)) {
+      oric_td_pcm_push(sys);
+      sys->pcm_level ^= 1;
+    }
+  }
+}
+
+static void oric_td_rec_put(oric_td_t* sys, uint8_t value) {
+  if ((uint16_t)(sys->rec_head - sys->rec_tail) == ORIC_TD_REC_BUFFER) {
+    sys->rec_errors++;
     return;
   }
+  sys->rec_buf[sys->rec_head & (ORIC_TD_REC_BUFFER - 1)] = value;
+  sys->rec_head++;
+}
 
-  if (!sys->sd_have_byte) {
-    UINT bytes_read = 0;
-    FRESULT res = f_read(&sys->sd_file, &sys->sd_byte, 1, &bytes_read);
-    if (res != FR_OK || bytes_read != 1) {
-      sys->sd_have_byte = false;
-      sys->size = 0;
+static void oric_td_rec_end(oric_td_t* sys) {
+  sys->rec_state = ORIC_TD_REC_SYNC;
+  sys->rec_syncs = 0;
+  sys->port &= ~ORIC_TD_PORT_RECORD;
+}
+
+// Follow the file framing of a decoded byte. A file reaches the buffer once
+// its header is known to be valid.
+static void oric_td_rec_byte(oric_td_t* sys, uint8_t value) {
+  switch (sys->rec_state) {
+    case ORIC_TD_REC_SYNC:
+      if (value == 0x16) {
+        if (sys->rec_syncs < 3) {
+          sys->rec_syncs++;
+        }
+      } else if ((value == 0x24) && (sys->rec_syncs == 3)) {
+        sys->rec_hdr_pos = 0;
+        sys->rec_state = ORIC_TD_REC_HEADER;
+        sys->port |= ORIC_TD_PORT_RECORD;
+      } else {
+        sys->rec_syncs = 0;
+      }
+      break;
+
+    case ORIC_TD_REC_HEADER: {
+      sys->rec_hdr[sys->rec_hdr_pos++] = value;
+      if (sys->rec_hdr_pos < sizeof(sys->rec_hdr)) {
+        break;
+      }
+      const uint32_t start =
+          (uint32_t)sys->rec_hdr[6] * 256u + sys->rec_hdr[7];
+      const uint32_t end = (uint32_t)sys->rec_hdr[4] * 256u + sys->rec_hdr[5];
+      if (end < start) {
+        DPRINTF("Oric TD: recorded header invalid\n");
+        sys->rec_errors++;
+        oric_td_rec_end(sys);
+        break;
+      }
+      for (int i = 0; i < 3; i++) {
+        oric_td_rec_put(sys, 0x16);
+      }
+      oric_td_rec_put(sys, 0x24);
+      for (uint8_t i = 0; i < sizeof(sys->rec_hdr); i++) {
+        oric_td_rec_put(sys, sys->rec_hdr[i]);
+      }
+      sys->rec_data_left = end - start + 1;
+      sys->rec_state = ORIC_TD_REC_NAME;
+      break;
+    }
+
+    case ORIC_TD_REC_NAME:
+      oric_td_rec_put(sys, value);
+      if (value == 0) {
+        sys->rec_state = ORIC_TD_REC_DATA;
+      }
+      break;
+
+    case ORIC_TD_REC_DATA:
+      oric_td_rec_put(sys, value);
+      if (--sys->rec_data_left == 0) {
+        DPRINTF("Oric TD: recorded file, %lu errors\n",
+                (unsigned long)sys->rec_errors);
+        sys->rec_done = true;
+        oric_td_rec_end(sys);
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+// Half period of the tape output: a short one is 1 unit, a long one 2
+// units. After the start bit, every bit is a short half period followed by
+// a short one for 1 and a long one for 0, 8 data bits and the parity.
+void oric_td_write_edge(oric_td_t* sys, uint32_t now) {
+  CHIPS_ASSERT(sys && sys->valid);
+  sys->port ^= ORIC_TD_PORT_WRITE;
+  const uint32_t cycles = now - sys->out_tick;
+  sys->out_tick = now;
+  if (cycles >= 3 * ORIC_TD_UNIT_CYCLES) {
+    // Silence or the motor has just started
+    sys->out_busy = false;
+    return;
+  }
+  const bool is_short = cycles < (3 * ORIC_TD_UNIT_CYCLES) / 2;
+  if (!sys->out_busy) {
+    if (!is_short) {
+      // Second half of the start bit
+      sys->out_busy = true;
+      sys->out_count = 0;
+      sys->out_bits = 0;
+    }
+    return;
+  }
+  if ((sys->out_count & 1) == 0) {
+    if (!is_short) {
+      // Framing error, take it as the start bit of the next byte
+      sys->rec_errors++;
+      sys->out_count = 0;
+      sys->out_bits = 0;
+      return;
+    }
+  } else if (is_short) {
+    sys->out_bits |= (uint16_t)(1u << (sys->out_count >> 1));
+  }
+  if (++sys->out_count < 18) {
+    return;
+  }
+  sys->out_busy = false;
+  const uint8_t value = (uint8_t)sys->out_bits;
+  const uint8_t parity = (uint8_t)((1 + __builtin_popcount(value)) & 1);
+  if (parity != ((sys->out_bits >> 8) & 1)) {
+    sys->rec_errors++;
+  }
+  oric_td_rec_byte(sys, value);
+}
+
+// First tape slot with no fN.tap, fN.edg or fN.wav, -1 if all are taken
+static int oric_td_free_tape(const char* folder_name) {
+  static const char* const exts[] = {"tap", "edg", "wav"};
+  for (int index = 0; index < ORIC_TD_MAX_TAPES; index++) {
+    bool taken = false;
+    for (size_t i = 0; (i < 3) && !taken; i++) {
+      char path[256];
+      FILINFO info;
+      snprintf(path, sizeof(path), "%s/f%d.%s", folder_name, index + 1,
+               exts[i]);
+      taken = f_stat(path, &info) == FR_OK;
+    }
+    if (!taken) {
+      return index;
+    }
+  }
+  return -1;
+}
+
+// Append the recorded bytes to the TAP image of rec_index, one write per
+// call
+static void oric_td_update_record(oric_td_t* sys) {
+  uint16_t pending = (uint16_t)(sys->rec_head - sys->rec_tail);
+  SettingsConfigEntry* folder =
+      settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_FOLDER);
+  const char* folder_name = folder ? folder->value : "/oric";
+  if ((pending < ORIC_TD_REC_WRITE) && !(sys->rec_done && pending)) {
+    if (sys->rec_done && sys->rec_open) {
+      // Whole file written. If it went to the TAP image of the inserted
+      // tape, its cached edge list is out of date.
+      f_close(&sys->rec_file);
+      sys->rec_open = false;
+      sys->rec_done = false;
+      if (sys->rec_index == sys->index) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/f%d.edg", folder_name,
+                 sys->index + 1);
+        if (sys->sd_file_open && !sys->pcm) {
+          oric_td_remove_tape_sdcard(sys);
+        }
+        f_unlink(path);
+      }
+      DPRINTF("Oric TD: recording saved, insert tape %d to load it\n",
+              sys->rec_index + 1);
+    }
+    return;
+  }
+
+  if (!sys->rec_open) {
+    if (sys->rec_index < 0) {
+      sys->rec_index = oric_td_free_tape(folder_name);
+    }
+    if (sys->rec_index < 0) {
+      DPRINTF("Oric TD: no free tape for the recording\n");
+      sys->rec_tail = sys->rec_head;
+      sys->rec_done = false;
       return;
     }
-    sys->sd_have_byte = true;
+    char path[256];
+    snprintf(path, sizeof(path), "%s/f%d.tap", folder_name,
+             sys->rec_index + 1);
+    FRESULT res = f_open(&sys->rec_file, path, FA_OPEN_APPEND | FA_WRITE);
+    if (res != FR_OK) {
+      DPRINTF("Oric TD: recording open failed (%d): %s\n", (int)res, path);
+      sys->rec_tail = sys->rec_head;
+      sys->rec_done = false;
+      return;
+    }
+    sys->rec_open = true;
+    DPRINTF("Oric TD: recording to %s\n", path);
+  }
+
+  // The buffer size is a multiple of the write size, full writes never wrap
+  const uint16_t offset = sys->rec_tail & (ORIC_TD_REC_BUFFER - 1);
+  UINT len = ORIC_TD_REC_BUFFER - offset;
+  if (len > ORIC_TD_REC_WRITE) {
+    len = ORIC_TD_REC_WRITE;
+  }
+  if (len > pending) {
+    len = pending;
   }
+  UINT bytes_written = 0;
+  PERF_COUNT(PERF_FATFS_CALLS);
+  FRESULT res = f_write(&sys->rec_file, &sys->rec_buf[offset], len,
+                        &bytes_written);
+  if (res != FR_OK || bytes_written != len) {
+    DPRINTF("Oric TD: recording write failed (%d)\n", (int)res);
+    sys->rec_errors++;
+  }
+  sys->rec_tail += (uint16_t)len;
+}
+
+void oric_td_update(oric_td_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  oric_td_update_edg(sys);
+  oric_td_update_pcm(sys);
+  oric_td_update_record(sys);
+}
 
-  uint8_t b = sys->sd_byte;
-  b >>= sys->bit_pos;
-  if (b & 1) {
+uint32_t oric_td_next_edge_sdcard(oric_td_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  if (!sys->sd_file_open || !oric_td_is_motor_on(sys)) {
+    return 0;
+  }
+  if (sys->edge_head == sys->edge_tail) {
+    if (sys->eof) {
+      return 0;
+    }
+    // Decoder behind, hold the level until the next frame fills the queue
+    sys->underruns++;
+    return ORIC_TD_STALL_CYCLES;
+  }
+  const uint32_t edge = sys->edges[sys->edge_tail & (ORIC_TD_EDGES - 1)];
+  sys->edge_tail++;
+  if (edge & ORIC_TD_EDGE_LEVEL) {
     sys->port |= ORIC_TD_PORT_READ;
   } else {
     sys->port &= ~ORIC_TD_PORT_READ;
   }
-  if (sys->bit_pos == 0) {
-    sys->bit_pos = 7;
-    sys->pos++;
-    if ((sys->pos % 1000u) == 0u && sys->pos != last_logged_pos) {
-      DPRINTF("Oric TD: read pos=%lu\n", (unsigned long)sys->pos);
-      last_logged_pos = sys->pos;
+  return edge & ~ORIC_TD_EDGE_LEVEL;
+}
+
+// Move the edge list reader to a file offset
+static bool oric_td_rewind(oric_td_t* sys, uint32_t offset) {
+  if (f_lseek(&sys->sd_file, offset) != FR_OK) {
+    return false;
+  }
+  sys->pos = offset;
+  sys->size = f_size(&sys->sd_file);
+  sys->rec_left = 0;
+  sys->buf_pos = 0;
+  sys->buf_len = 0;
+  oric_td_flush_edges(sys);
+  return true;
+}
+
+// Skip bytes of the edge list, seeking past what is not buffered
+static bool oric_td_skip(oric_td_t* sys, uint32_t bytes) {
+  const uint32_t buffered = (uint32_t)(sys->buf_len - sys->buf_pos);
+  if (bytes <= buffered) {
+    sys->buf_pos += (uint8_t)bytes;
+    sys->pos += bytes;
+    return true;
+  }
+  return oric_td_rewind(sys, sys->pos + bytes);
+}
+
+// Index the programs of the tape. Every block marker is followed by the
+// synchro bytes, 0x24, the 9 byte header and the name, all in BYTES records.
+static void oric_td_scan_blocks(oric_td_t* sys) {
+  uint64_t start_time = GET_CURRENT_TIME();
+  sys->num_blocks = 0;
+  sys->block = 0;
+  oric_td_block_t* blk = NULL;
+  uint8_t header[9];
+  int field = -1;  // Next header byte, 9 and up for the name, -1 when done
+  uint8_t rec;
+  while (oric_td_read_byte(sys, &rec)) {
+    uint32_t count;
+    if (rec == ORIC_TD_EDG_BLOCK) {
+      if (sys->num_blocks == ORIC_TD_MAX_BLOCKS) {
+        break;
+      }
+      blk = &sys->blocks[sys->num_blocks++];
+      memset(blk, 0, sizeof(oric_td_block_t));
+      blk->offset = sys->pos - 1;
+      field = -2;  // Waiting for 0x24
+      if (!oric_td_skip(sys, 1)) {
+        break;
+      }
+      continue;
+    }
+    if (!oric_td_read_varint(sys, &count)) {
+      break;
+    }
+    if (rec == ORIC_TD_EDG_RUNS) {
+      uint32_t units;
+      while (count-- && oric_td_read_varint(sys, &units)) {
+      }
+      continue;
+    }
+    if (rec != ORIC_TD_EDG_BYTES) {
+      break;
+    }
+    for (; count && (field != -1); count--) {
+      uint8_t value;
+      if (!oric_td_read_byte(sys, &value)) {
+        break;
+      }
+      if (field == -2) {
+        field = (value == 0x24) ? 0 : -2;
+      } else if (field < (int)sizeof(header)) {
+        header[field++] = value;
+        if (field == sizeof(header)) {
+          blk->type = header[2];
+          blk->end = (uint16_t)(header[4] << 8 | header[5]);
+          blk->start = (uint16_t)(header[6] << 8 | header[7]);
+        }
+      } else if ((value == 0) ||
+                 (field - sizeof(header) == sizeof(blk->name) - 1)) {
+        field = -1;
+      } else {
+        blk->name[field++ - sizeof(header)] = (char)value;
+      }
+    }
+    if (!oric_td_skip(sys, count)) {
+      break;
     }
-    sys->sd_have_byte = false;
-  } else {
-    sys->bit_pos--;
   }
+  DPRINTF("Oric TD: indexed %u programs in %lu ms\n", sys->num_blocks,
+          (unsigned long)GET_CURRENT_TIME_INTERVAL_MS(start_time));
+  for (uint8_t i = 0; i < sys->num_blocks; i++) {
+    DPRINTF("Oric TD:  %u: %-16s %s %04x-%04x\n", i + 1, sys->blocks[i].name,
+            (sys->blocks[i].type & 0x80) ? "CODE " : "BASIC",
+            sys->blocks[i].start, sys->blocks[i].end);
+  }
+}
+
+bool oric_td_seek_block(oric_td_t* sys, int block) {
+  CHIPS_ASSERT(sys && sys->valid);
+  if (!sys->sd_file_open || sys->pcm || (block < 0) ||
+      (block >= sys->num_blocks)) {
+    return false;
+  }
+  if (!oric_td_rewind(sys, sys->blocks[block].offset)) {
+    return false;
+  }
+  sys->block = (uint8_t)block;
+  DPRINTF("Oric TD: seek to program %d at %lu\n", block + 1,
+          (unsigned long)sys->pos);
+  oric_td_update_edg(sys);
+  return true;
 }
 
 bool oric_td_insert_tape_sdcard(oric_td_t* sys, int index) {
   CHIPS_ASSERT(sys && sys->valid);
   oric_td_remove_tape_sdcard(sys);
-  sys->bit_pos = 7;
+  sys->index = index;
+  // A recording in progress keeps going to the file it opened
+  if (!sys->rec_open) {
+    sys->rec_index = -1;
+  }
 
   SettingsConfigEntry* folder =
       settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_FOLDER);
   const char* folder_name = folder ? folder->value : "/oric";
-  char wav_path[256];
-  char tap_path[256];
-  int wav_len =
-      snprintf(wav_path, sizeof(wav_path), "%s/f%d.wav", folder_name, index + 1);
-  int tap_len =
-      snprintf(tap_path, sizeof(tap_path), "%s/f%d.tap", folder_name, index + 1);
-  if (wav_len <= 0 || (size_t)wav_len >= sizeof(wav_path) || tap_len <= 0 ||
-      (size_t)tap_len >= sizeof(tap_path)) {
+  char edg_path[256];
+  char src_path[256];
+  int edg_len = snprintf(edg_path, sizeof(edg_path), "%s/f%d.edg",
+                         folder_name, index + 1);
+  int src_len = snprintf(src_path, sizeof(src_path), "%s/f%d.tap",
+                         folder_name, index + 1);
+  if (edg_len <= 0 || (size_t)edg_len >= sizeof(edg_path) || src_len <= 0 ||
+      (size_t)src_len >= sizeof(src_path)) {
     DPRINTF("Oric TD: invalid tape path length\n");
     return false;
   }
 
-  FRESULT res = f_open(&sys->sd_file, wav_path, FA_READ);
+  FILINFO info;
+  FRESULT res = f_stat(edg_path, &info);
+  const bool from_tap = f_stat(src_path, &info) == FR_OK;
   if (res != FR_OK) {
-    DPRINTF("Oric TD: wav open failed (%d): %s\n", (int)res, wav_path);
-    FILINFO info;
-    res = f_stat(tap_path, &info);
-    if (res != FR_OK) {
-      DPRINTF("Oric TD: tap missing (%d): %s\n", (int)res, tap_path);
-      return false;
-    }
-    DPRINTF("Oric TD: converting tap to wav: %s\n", tap_path);
-    if (!oric_convert_tap_to_wave(tap_path, wav_path)) {
-      DPRINTF("Oric TD: convert_tap_to_wave failed\n");
-      return false;
+    // Convert from the TAP image, or else from a legacy bitstream. PCM
+    // captures are played directly.
+    bool converted = false;
+    if (from_tap) {
+      DPRINTF("Oric TD: converting tap to edg: %s\n", src_path);
+      converted = oric_convert_tap_to_edg(src_path, edg_path);
+    } else {
+      memcpy(&src_path[src_len - 3], "wav", 3);
+      if (oric_td_open_pcm(sys, src_path)) {
+        return true;
+      }
+      if (f_stat(src_path, &info) == FR_OK) {
+        DPRINTF("Oric TD: converting wav to edg: %s\n", src_path);
+        converted = oric_convert_wave_to_edg(src_path, edg_path);
+      }
     }
-    res = f_open(&sys->sd_file, wav_path, FA_READ);
-    if (res != FR_OK) {
-      DPRINTF("Oric TD: wav open after convert failed (%d): %s\n",
-              (int)res,
-              wav_path);
+    if (!converted) {
+      DPRINTF("Oric TD: no tape image for f%d\n", index + 1);
       return false;
     }
   }
 
-  uint8_t header[4];
+  // Recordings extend the TAP image only if the tape was made from it
+  if (from_tap && !sys->rec_open) {
+    sys->rec_index = index;
+  }
+
+  res = f_open(&sys->sd_file, edg_path, FA_READ);
+  if (res != FR_OK) {
+    DPRINTF("Oric TD: edg open failed (%d): %s\n", (int)res, edg_path);
+    return false;
+  }
+
+  uint8_t header[ORIC_TD_EDG_HEADER_SIZE];
   UINT bytes_read = 0;
   res = f_read(&sys->sd_file, header, sizeof(header), &bytes_read);
-  if (res != FR_OK || bytes_read != sizeof(header)) {
-    DPRINTF("Oric TD: wav header read failed (%d)\n", (int)res);
+  if (res != FR_OK || bytes_read != sizeof(header) ||
+      memcmp(header, "OEDG", 4) != 0 || header[4] != 1) {
+    DPRINTF("Oric TD: edg header invalid (%d)\n", (int)res);
     f_close(&sys->sd_file);
     return false;
   }
 
-  sys->size =
-      header[0] | (header[1] << 8) | (header[2] << 16) | (header[3] << 24);
-  sys->pos = 0;
+  sys->unit_cycles = (uint16_t)(header[6] | (header[7] << 8));
+  sys->pos = sizeof(header);
+  oric_td_scan_blocks(sys);
+  if (!oric_td_rewind(sys, sizeof(header))) {
+    f_close(&sys->sd_file);
+    return false;
+  }
+  sys->level = header[5] & 1;
   sys->sd_file_open = true;
-  sys->sd_have_byte = false;
   DPRINTF("Oric TD: tape loaded size=%lu\n", (unsigned long)sys->size);
+  oric_td_update_edg(sys);
   return true;
 }
 
@@ -552,10 +1465,15 @@ void oric_td_remove_tape_sdcard(oric_td_t* sys) {
     f_close(&sys->sd_file);
     sys->sd_file_open = false;
   }
-  sys->sd_have_byte = false;
   sys->size = 0;
   sys->pos = 0;
-  sys->bit_pos = 7;
+  sys->rec_left = 0;
+  sys->buf_pos = 0;
+  sys->buf_len = 0;
+  sys->num_blocks = 0;
+  sys->block = 0;
+  sys->pcm = false;
+  oric_td_flush_edges(sys);
 }
 
 bool oric_td_is_motor_on(oric_td_t* sys) {
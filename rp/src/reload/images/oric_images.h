@@ -1,3 +0,0 @@
-#pragma once
-
-uint8_t* oric_nib_images[] = {};
@@ -29,7 +29,6 @@
 #include <string.h>
 
 #include "chips/chips_common.h"
-#include "images/oric_images.h"
 #include "pico/stdlib.h"
 #ifdef OLIMEX_NEO6502
 #include "chips/wdc65C02cpu.h"
@@ -38,12 +37,14 @@
 #endif
 #include "chips/ay38910psg.h"
 #include "chips/clk.h"
-#include "chips/kbd.h"
 #include "chips/mem.h"
 #include "chips/mos6522via.h"
+#include "chips/sched.h"
+#include "chips/wd1793fdc.h"
 #include "debug.h"
 #include "devices/disk2_fdc.h"
 #include "devices/disk2_fdd.h"
+#include "devices/microdisc.h"
 #include "devices/oric_fdc_rom.h"
 #include "devices/oric_td.h"
 #include "emul.h"
@@ -54,9 +55,11 @@
 #include "hardware/irq.h"
 #include "hardware/structs/bus_ctrl.h"
 #include "hardware/structs/ssi.h"
+#include "hardware/structs/systick.h"
 #include "hardware/vreg.h"
 #include "kbdmap.h"
 #include "oric.h"
+#include "perf.h"
 #include "pico/multicore.h"
 #include "settings/settings.h"
 
@@ -89,6 +92,39 @@ static char oric_msg_buf[32];
 #define ORIC_MSG_DISPLAY_SECONDS 3u
 #endif
 
+// Show the performance HUD at boot, keypad ( toggles it
+#ifndef ORIC_HUD
+#define ORIC_HUD false
+#endif
+
+// Performance HUD, refreshed once per second. Core 0 formats the text into
+// the buffer oric_hud_seq doesn't point at and then bumps the sequence.
+static volatile bool oric_hud_on = ORIC_HUD;
+static volatile uint32_t oric_hud_seq;
+static char oric_hud_buf[2][ORIC_OSD_MAX_ROWS * 40];
+
+// Running totals for the HUD, each core only writes its own
+static volatile uint32_t oric_frames;          // Emulated frames (core 0)
+static uint32_t oric_ay_writes;                // AY writes queued (core 0)
+static volatile uint32_t oric_render_cycles;   // Time rendering (core 1)
+static volatile uint32_t oric_render_frames;   // Render passes (core 1)
+static volatile uint32_t oric_skipped_frames;  // Never rendered (core 1)
+
+// ROM fast path trap classes, opt-in (see devices/oric_hle.h)
+#ifndef ORIC_HLE_CLASSES
+#define ORIC_HLE_CLASSES 0u
+#endif
+
+// Skip idle loops up to the next VIA interrupt
+#ifndef ORIC_IDLE_SKIP
+#define ORIC_IDLE_SKIP true
+#endif
+
+// Render each line right after the emulated beam instead of whole frames
+#ifndef ORIC_BEAM_RACING
+#define ORIC_BEAM_RACING false
+#endif
+
 static void oric_set_loading_msg(uint8_t fkey) {
   if (fkey < 1 || fkey > 10) {
     return;
@@ -102,6 +138,7 @@ inline void oric_ayQueuePush(uint16_t *queue, uint16_t *head, uint16_t value) {
   const uint16_t queue_words =
       (uint16_t)(ATARI_ST_VIA_QUEUE_SIZE_BYTES / sizeof(uint16_t));
   uint16_t idx = *head;
+  oric_ay_writes++;
   queue[idx] = value;
   uint16_t next_head = (uint16_t)((idx + 1u) & (queue_words - 1u));
   queue[next_head] = 0xFFFF;
@@ -117,11 +154,19 @@ static inline void flash_set_baud_div(uint16_t div) {
 uint8_t __attribute__((section(".oric_rom_in_ram")))
 __attribute__((aligned(4))) oric_rom[ORIC_ROM_SIZE] = {0};
 
+// Microdisc EPROM, loaded from microdis.rom when present
+static uint8_t __attribute__((section(".oric_ram")))
+__attribute__((aligned(4))) oric_microdisc_rom[MICRODISC_EPROM_SIZE];
+static bool oric_microdisc_rom_loaded = false;
+
 // Get oric_desc_t struct based on joystick type
 oric_desc_t oric_desc(void) {
   return (oric_desc_t){
       .td_enabled = true,
       .fdc_enabled = true,
+      .hle_classes = ORIC_HLE_CLASSES,
+      .idle_skip_enabled = ORIC_IDLE_SKIP,
+      .beam_racing = ORIC_BEAM_RACING,
       .audio =
           {
               .callback = {.func = NULL},
@@ -137,10 +182,22 @@ oric_desc_t oric_desc(void) {
 
 void app_init(void) {
   oric_desc_t desc = oric_desc();
+  if (oric_microdisc_rom_loaded) {
+    desc.fdc_enabled = false;
+    desc.microdisc_enabled = true;
+    desc.roms.microdisc_rom = (chips_range_t){
+        .ptr = oric_microdisc_rom, .size = sizeof(oric_microdisc_rom)};
+  }
   oric_init(&state.oric, &desc);
+  // Boot with the first disk in the drive when there is one
+  if (state.oric.fdc.valid) {
+    (void)disk2_fdd_insert_disk_sdcard(&state.oric.fdc.fdd[0], 0);
+  }
 }
 
-static int load_oric_rom_from_sd(void) {
+// Load a ROM image from the configured folder on the SD card
+static int load_rom_from_sd(const char *file_name, uint8_t *dst,
+                            UINT size) {
   SettingsConfigEntry *folder =
       settings_find_entry(aconfig_getContext(), ACONFIG_PARAM_FOLDER);
   const char *folderName = folder ? folder->value : "/oric";
@@ -148,9 +205,10 @@ static int load_oric_rom_from_sd(void) {
   size_t name_len = strlen(folderName);
   const char *sep =
       (name_len > 0 && folderName[name_len - 1] == '/') ? "" : "/";
-  int path_len = snprintf(path, sizeof(path), "%s%srom.img", folderName, sep);
+  int path_len =
+      snprintf(path, sizeof(path), "%s%s%s", folderName, sep, file_name);
   if (path_len <= 0 || (size_t)path_len >= sizeof(path)) {
-    DPRINTF("rom.img path too long\n");
+    DPRINTF("%s path too long\n", file_name);
     return ORIC_ROM_LOAD_ERR_PATH;
   }
 
@@ -161,21 +219,32 @@ static int load_oric_rom_from_sd(void) {
     return ORIC_ROM_LOAD_ERR_OPEN;
   }
 
-  memset(oric_rom, 0, sizeof(oric_rom));
+  memset(dst, 0, size);
   UINT bytes_read = 0;
-  res = f_read(&file, oric_rom, sizeof(oric_rom), &bytes_read);
+  res = f_read(&file, dst, size, &bytes_read);
   f_close(&file);
   if (res != FR_OK) {
     DPRINTF("Failed to read %s (%d)\n", path, res);
     return ORIC_ROM_LOAD_ERR_READ;
   }
-  if (bytes_read < sizeof(oric_rom)) {
-    DPRINTF("rom.img short read: %u bytes\n", (unsigned)bytes_read);
+  if (bytes_read < size) {
+    DPRINTF("%s short read: %u bytes\n", file_name, (unsigned)bytes_read);
     return ORIC_ROM_LOAD_ERR_SHORT;
   }
   return ORIC_ROM_LOAD_OK;
 }
 
+static int load_oric_rom_from_sd(void) {
+  return load_rom_from_sd("rom.img", oric_rom, sizeof(oric_rom));
+}
+
+// The Microdisc interface is only emulated when its EPROM is on the SD card
+static void load_microdisc_rom_from_sd(void) {
+  oric_microdisc_rom_loaded =
+      load_rom_from_sd("microdis.rom", oric_microdisc_rom,
+                       sizeof(oric_microdisc_rom)) == ORIC_ROM_LOAD_OK;
+}
+
 void __not_in_flash_func(kbd_raw_key_down)(int code) {
   if (isascii(code)) {
     if (isupper(code)) {
@@ -201,20 +270,21 @@ void __not_in_flash_func(kbd_raw_key_down)(int code) {
     {
       uint8_t index = code - 0x13A;
       oric_set_loading_msg((uint8_t)(index + 1));
-      int num_nib_images = CHIPS_ARRAY_SIZE(oric_nib_images);
-      if (index < num_nib_images) {
-        if (sys->fdc.valid) {
-          disk2_fdd_insert_disk(&sys->fdc.fdd[0], oric_nib_images[index]);
-        }
-      } else {
-        index -= num_nib_images;
-        if (sys->td.valid) {
-          bool inserted = oric_td_insert_tape_sdcard(&sys->td, index);
-          if (!inserted) {
-            DPRINTF("oric: failed to insert tape image %d\n", index);
-          } else {
-            DPRINTF("oric: tape image %d inserted\n", index);
-          }
+      if (sys->md.valid && microdisc_insert_disk_sdcard(&sys->md, 0, index)) {
+        DPRINTF("oric: disk image %d inserted\n", index);
+        break;
+      }
+      if (sys->fdc.valid &&
+          disk2_fdd_insert_disk_sdcard(&sys->fdc.fdd[0], index)) {
+        DPRINTF("oric: disk image %d inserted\n", index);
+        break;
+      }
+      if (sys->td.valid) {
+        bool inserted = oric_insert_tape(sys, index);
+        if (!inserted) {
+          DPRINTF("oric: failed to insert tape image %d\n", index);
+        } else {
+          DPRINTF("oric: tape image %d inserted\n", index);
         }
       }
       break;
@@ -228,8 +298,51 @@ void __not_in_flash_func(kbd_raw_key_down)(int code) {
       oric_reset(sys);
       break;
 
+    case 0x149:  // CLR/HOME, wind the tape to its next program
+    {
+      oric_td_t *td = &sys->td;
+      if (!td->valid || (td->num_blocks == 0)) {
+        break;
+      }
+      const int block = (td->block + 1) % td->num_blocks;
+      if (oric_seek_tape(sys, block)) {
+        (void)snprintf(oric_msg_buf, sizeof(oric_msg_buf), "TAPE %d/%d %s",
+                       block + 1, td->num_blocks, td->blocks[block].name);
+        oric_msg_until_us =
+            time_us_32() + (ORIC_MSG_DISPLAY_SECONDS * 1000u * 1000u);
+      }
+      break;
+    }
+
+    case 0x14A:  // Keypad (, performance HUD
+      oric_hud_on = !oric_hud_on;
+      break;
+
+    case 0x14B:  // Keypad ), hot path statistics of the last frames
+      PERF_DUMP();
+      break;
+
+#ifdef ORIC_PROFILE
+    case 0x14C:  // Ctrl+keypad *, start the PC profiler or save its result
+    {
+      oric_prof_t *prof = sys->prof;
+      if (!prof->running) {
+        oric_prof_start(prof);
+        (void)snprintf(oric_msg_buf, sizeof(oric_msg_buf), "PROFILE ON");
+      } else {
+        oric_prof_stop(prof);
+        const bool saved = oric_prof_save_sdcard(prof);
+        (void)snprintf(oric_msg_buf, sizeof(oric_msg_buf), "PROFILE %s",
+                       saved ? "SAVED" : "NOT SAVED");
+      }
+      oric_msg_until_us =
+          time_us_32() + (ORIC_MSG_DISPLAY_SECONDS * 1000u * 1000u);
+      break;
+    }
+#endif
+
     default:
-      kbd_key_down(&sys->kbd, code);
+      oric_kbd_key_down(&sys->kbd, code);
       break;
   }
 }
@@ -242,28 +355,149 @@ void __not_in_flash_func(kbd_raw_key_up)(int code) {
       code = toupper(code);
     }
   }
-  kbd_key_up(&state.oric.kbd, code);
+  oric_kbd_key_up(&state.oric.kbd, code);
 }
 
 void gamepad_state_update(uint8_t index, uint8_t hat_state,
                           uint32_t button_state) {}
 
+// Account a frame of core 0 that took frame_us out of budget_us, and format
+// the HUD text once per second while it is shown
+static void oric_hud_frame(uint32_t frame_us, uint32_t budget_us) {
+  static bool started = false;
+  static uint32_t second_us, ticks, render_cycles, render_frames, skipped;
+  static uint32_t frames, frame_us_sum, frame_us_max, keys_max;
+  static uint32_t ay_writes, ay_max;
+
+  oric_frames++;
+  frames++;
+  frame_us_sum += frame_us;
+  if (frame_us > frame_us_max) {
+    frame_us_max = frame_us;
+  }
+  const uint32_t keys = (uint32_t)emul_addrlog_count();
+  if (keys > keys_max) {
+    keys_max = keys;
+  }
+  // The ST drains the AY queue once per VBL, a frame's writes are its fill
+  const uint32_t ay = oric_ay_writes - ay_writes;
+  ay_writes = oric_ay_writes;
+  if (ay > ay_max) {
+    ay_max = ay;
+  }
+
+  const uint32_t now_us = time_us_32();
+  const uint32_t elapsed_us = now_us - second_us;
+  if (started && (elapsed_us < 1000000u)) {
+    return;
+  }
+  if (started && oric_hud_on) {
+    const uint32_t mhz_100 =
+        (uint32_t)(((uint64_t)(state.oric.system_ticks - ticks) * 100u) /
+                   elapsed_us);
+    const uint32_t avg_us = frame_us_sum / frames;
+    const uint32_t free_pct =
+        (avg_us < budget_us) ? ((budget_us - avg_us) * 100u) / budget_us : 0;
+    const uint32_t cycles_per_us = clock_get_hz(clk_sys) / 1000000u;
+    const uint32_t c1_cycles = oric_render_cycles - render_cycles;
+    const uint32_t c1_frames = oric_render_frames - render_frames;
+    const uint32_t c1_us =
+        c1_frames ? (c1_cycles / cycles_per_us) / c1_frames : 0;
+    const uint32_t c1_pct = (uint32_t)(((uint64_t)c1_cycles * 100u) /
+                                       ((uint64_t)cycles_per_us * elapsed_us));
+    const uint32_t seq = oric_hud_seq + 1;
+    (void)snprintf(
+        oric_hud_buf[seq & 1], sizeof(oric_hud_buf[0]),
+        "EMU %u.%02uMHZ SKIPPED %u\n"
+        "CORE0 %uUS MAX %uUS FREE %u%%\n"
+        "CORE1 %uUS/FRAME BUSY %u%%\n"
+        "KEYS %u AY %u/%u UNDERRUNS %u",
+        (unsigned)(mhz_100 / 100u), (unsigned)(mhz_100 % 100u),
+        (unsigned)(oric_skipped_frames - skipped), (unsigned)avg_us,
+        (unsigned)frame_us_max, (unsigned)free_pct, (unsigned)c1_us,
+        (unsigned)c1_pct, (unsigned)keys_max, (unsigned)ay_max,
+        (unsigned)(ATARI_ST_VIA_QUEUE_SIZE_BYTES / sizeof(uint16_t) - 1),
+        (unsigned)state.oric.td.underruns);
+    oric_hud_seq = seq;
+  }
+  started = true;
+  second_us = now_us;
+  ticks = state.oric.system_ticks;
+  render_cycles = oric_render_cycles;
+  render_frames = oric_render_frames;
+  skipped = oric_skipped_frames;
+  frames = 0;
+  frame_us_sum = 0;
+  frame_us_max = 0;
+  keys_max = 0;
+  ay_max = 0;
+}
+
+// Core 1 cycles since t0, read from its SysTick counting down, up to 2^24
+static inline uint32_t oric_core1_cycles(void) { return systick_hw->cvr; }
+static inline uint32_t oric_core1_since(uint32_t t0) {
+  return (t0 - systick_hw->cvr) & 0x00FFFFFFu;
+}
+
+// Account a render pass of core 1
+static void __not_in_flash_func(oric_render_done)(uint32_t cycles) {
+  static uint32_t last_frame = 0;
+  PERF_ADD(PERF_T_RENDER, cycles);
+  oric_render_cycles += cycles;
+  oric_render_frames++;
+  const uint32_t frame = oric_frames;
+  if ((frame - last_frame) > 1) {
+    oric_skipped_frames += frame - last_frame - 1;
+  }
+  last_frame = frame;
+}
+
 void __not_in_flash_func(core1_main()) {
+  // Free running cycle counter for the render time on the HUD
+  systick_hw->rvr = 0x00FFFFFFu;
+  systick_hw->csr = 0x5;  // Enabled, processor clock
+
   uint32_t next_update_us = time_us_32();
+  uint32_t hud_seq = 0;
   while (1) {
     uint32_t now_us = time_us_32();
     if ((int32_t)(now_us - next_update_us) >= 0) {
       uint32_t until_us = oric_msg_until_us;
       if (until_us != 0 && (int32_t)(until_us - now_us) > 0) {
+        // Draws only when the text changes, the box is kept over every frame
         oric_show_msg(&state.oric, oric_msg_buf);
-      } else {
-        if (until_us != 0) {
-          oric_msg_until_us = 0;
-        }
+      } else if (until_us != 0) {
+        oric_msg_until_us = 0;
+        oric_hide_msg(&state.oric);
+      }
+      if (!oric_hud_on) {
+        oric_hide_hud(&state.oric);
+      } else if (hud_seq != oric_hud_seq) {
+        hud_seq = oric_hud_seq;
+        oric_show_hud(&state.oric, oric_hud_buf[hud_seq & 1]);
+      }
+      if (!state.oric.beam.enabled) {
+        const uint32_t t0 = oric_core1_cycles();
         (void)oric_screen_update(&state.oric);
+        oric_render_done(oric_core1_since(t0));
       }
       next_update_us = now_us + 19968;
     }
+    // Follow the beam published by core 0
+    if (state.oric.beam.enabled) {
+      // Count only the steps that rendered lines, not the spinning
+      static uint32_t busy = 0;
+      const int line = state.oric.beam.render_line;
+      const uint32_t t0 = oric_core1_cycles();
+      const int done = oric_screen_race(&state.oric);
+      if (done || (line != state.oric.beam.render_line)) {
+        busy += oric_core1_since(t0);
+      }
+      if (done) {
+        oric_render_done(busy);
+        busy = 0;
+      }
+    }
   }
   __builtin_unreachable();
 }
@@ -272,10 +506,10 @@ int __not_in_flash_func(oric_main)() {
   // Erase the ROM area in RAM
   memset((void *)&__oric_rom_in_ram_start__, 0, 32 * 1024 * sizeof(uint8_t));
   int rom_load_result = load_oric_rom_from_sd();
+  load_microdisc_rom_from_sd();
 
   // SAFEGUARD START: Init translation table for Oric
   kbdmap_initOric();
-  build_oric_pat_lut();
 
   // SAFEGUARD END
 
@@ -301,7 +535,7 @@ int __not_in_flash_func(oric_main)() {
   vreg_set_voltage(RP2040_VOLTAGE);
   sleep_us(500);  // wait for voltage to stabilize
 
-#if defined(_DEBUG) && (_DEBUG != 0)
+#if (defined(_DEBUG) && (_DEBUG != 0)) || (defined(_PERF) && (_PERF != 0))
   // Initialize chosen serial port
   stdio_init_all();
   setvbuf(stdout, NULL, _IONBF,
@@ -311,6 +545,8 @@ int __not_in_flash_func(oric_main)() {
 
   if (rom_load_result != ORIC_ROM_LOAD_OK) {
     DPRINTF("rom.img load error: %d\n", rom_load_result);
+    memset(state.oric.fb, 0,
+           ATARI_ST_FRAMEBUFFER_SIZE_16WORDS * sizeof(uint16_t));
     oric_show_msg(&state.oric, "NO ROM FOUND");
     while (1) {
       state.oric.fb_toggle ^= 1u;
@@ -323,13 +559,41 @@ int __not_in_flash_func(oric_main)() {
 
   DPRINTF("Core 1 start\n");
   multicore_launch_core1(core1_main);
+  PERF_INIT_CORE();  // Core 1 starts its own SysTick
 
   uint32_t num_ticks = 19968;
+  uint32_t frame_end_ticks = state.oric.system_ticks;
   while (1) {
     uint32_t start_time_in_micros = time_us_32();
 
-    for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-      oric_tick(&state.oric);
+    // oric_tick() may advance several cycles when the ROM fast path runs
+    frame_end_ticks += num_ticks;
+    PERF_BEGIN(PERF_T_CPU);
+    oric_run(&state.oric, frame_end_ticks);
+    PERF_END(PERF_T_CPU);
+
+    // SD card reads and writes for the disk and tape drives happen between
+    // frames
+    PERF_BEGIN(PERF_T_SDCARD);
+    if (state.oric.fdc.valid) {
+      disk2_fdc_update(&state.oric.fdc);
+    }
+    if (state.oric.md.valid) {
+      microdisc_update(&state.oric.md);
+    }
+    oric_td_update(&state.oric.td);
+    PERF_END(PERF_T_SDCARD);
+
+    // Idle cycles skipped in this frame, reported once per second
+    static uint32_t idle_frames = 0;
+    static uint32_t idle_cycles = 0;
+    idle_cycles += oric_idle_end_frame(&state.oric);
+    if (++idle_frames == 50) {
+      DPRINTF("oric: idle %u%% (%u cycles skipped)\n",
+              (unsigned)((idle_cycles * 100u) / (num_ticks * idle_frames)),
+              (unsigned)idle_cycles);
+      idle_frames = 0;
+      idle_cycles = 0;
     }
 
     static bool shift_pressed = false;
@@ -374,10 +638,12 @@ int __not_in_flash_func(oric_main)() {
     }
 
     // oric_screen_update(&state.oric);
-    kbd_update(&state.oric.kbd, num_ticks);
+    oric_kbd_update(&state.oric.kbd);
 
     uint32_t end_time_in_micros = time_us_32();
     uint32_t execution_time = end_time_in_micros - start_time_in_micros;
+    oric_hud_frame(execution_time, num_ticks);
+    PERF_FRAME();
 
     int sleep_time = num_ticks - execution_time;
     if (sleep_time > 0) {
@@ -24,9 +24,10 @@
 // - chips/wdc65C02cpu.h | chips/mos6502cpu.h
 // - chips/mos6522via.h
 // - chips/ay38910psg.h
-// - chips/kbd.h
 // - chips/mem.h
 // - chips/clk.h
+// - chips/sched.h
+// - chips/wd1793fdc.h
 // - systems/oric_fdd.h
 // - systems/oric_fdc.h
 // - systems/oric_fdc_rom.h
@@ -70,19 +71,26 @@
 #endif
 #include "chips/ay38910psg.h"
 #include "chips/clk.h"
-#include "chips/kbd.h"
 #include "chips/mem.h"
 #include "chips/mos6522via.h"
+#include "chips/sched.h"
 #include "constants.h"
 #include "devices/disk2_fdc.h"
+#include "devices/microdisc.h"
+#include "devices/oric_hle.h"
+#include "devices/oric_kbd.h"
+#ifdef ORIC_PROFILE
+#include "devices/oric_prof.h"
+#endif
 #include "devices/oric_td.h"
+#include "perf.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 // Bump snapshot version when oric_t memory layout changes
-#define ORIC_SNAPSHOT_VERSION (1)
+#define ORIC_SNAPSHOT_VERSION (17)
 
 #define ORIC_FREQUENCY (1000000)      // 1 MHz
 #define ORIC_MAX_TAPE_SIZE (1 << 16)  // Max size of tape file in bytes
@@ -90,8 +98,25 @@ extern "C" {
 #define ORIC_SCREEN_WIDTH 240   // (240)
 #define ORIC_SCREEN_HEIGHT 224  // (224)
 
-#define ORIC_KEY_CTRL (0x146)
-#define ORIC_KEY_SHIFT (0x147)
+// Scheduler events, see _oric_run_events(). The VIA ticks every 4 cycles and
+// stays on a cycle counter divisor, only the sparse events are scheduled.
+typedef enum {
+  ORIC_EVENT_TAPE,  // Next level change of the tape input
+  ORIC_EVENT_FDC,   // Disk II motor-off timer
+  ORIC_EVENT_LINE,  // Raster line for the line-synchronous renderer
+} oric_event_t;
+
+#define ORIC_VIA_CYCLES (4)    // VIA timers run in steps of 4 cycles
+#define ORIC_FDC_CYCLES (128)  // Disk II timer period
+#define ORIC_LINE_CYCLES (64)  // Length of a raster line
+#define ORIC_FRAME_LINES (312)  // Raster lines per frame, the first 224 shown
+
+// Devices an oric_tick() variant serves, see oric_run(). A variant built
+// without a flag has the checks for that device compiled out.
+#define ORIC_RUN_MICRODISC (1u << 0)  // Microdisc attached
+#define ORIC_RUN_TAPE (1u << 1)       // Tape drive attached
+#define ORIC_RUN_FAST (1u << 2)       // ROM fast path and idle skip
+#define ORIC_RUN_ALL (ORIC_RUN_MICRODISC | ORIC_RUN_TAPE | ORIC_RUN_FAST)
 
 // ROM size (16 KB)
 #define ORIC_ROM_SIZE 0x4000u
@@ -120,20 +145,39 @@ extern uint8_t oric_rom[ORIC_ROM_SIZE];
 typedef struct {
   bool td_enabled;   // Set to true to enable tape drive emulation
   bool fdc_enabled;  // Set to true to enable floppy disk controller emulation
+  bool microdisc_enabled;  // Microdisc interface instead of the Disk II one
+  uint8_t hle_classes;  // ROM fast path trap classes to enable, 0 for none
+  bool idle_skip_enabled;  // Skip idle loops up to the next VIA interrupt
+  bool beam_racing;  // Render each line right after the emulated beam
   chips_debug_t debug;  // Optional debugging hook
   chips_audio_desc_t audio;
   struct {
     chips_range_t rom;
     chips_range_t boot_rom;
+    chips_range_t microdisc_rom;
   } roms;
 } oric_desc_t;
 
+// Text rows of an on screen box
+#define ORIC_OSD_MAX_ROWS (4)
+
+// Box of 6x8 glyph text drawn over a band of lines of the Oric display
+typedef struct {
+  bool active;
+  uint8_t top;       // First line of the band
+  uint8_t lines;     // Lines of the band
+  uint8_t word0;     // First and last + 1 plane word group of the box
+  uint8_t word1;
+  uint8_t num_rows;  // Text rows
+  uint16_t bits[ORIC_OSD_MAX_ROWS][8][15];  // Glyph pixels, one bit each
+} oric_osd_t;
+
 // Oric emulator state
 typedef struct {
   MOS6502CPU_T cpu;
   mos6522via_t via;
   ay38910psg_t psg;
-  kbd_t kbd;
+  oric_kbd_t kbd;
   mem_t mem;
   bool valid;
   chips_debug_t debug;
@@ -156,23 +200,81 @@ typedef struct {
 
   volatile bool screen_dirty;
 
+  // Lines of the last full render with cells under LATTR_BLINK, and the
+  // video attributes each line started with, to redraw them on their own
+  // when only the blink phase changes
+  uint32_t blink_lines[(224 + 31) / 32];
+  uint8_t line_pattr[224];
+  bool blink_rendered;  // Blink phase of the framebuffer
+
+  // Boxes drawn over the Oric display: messages and the performance HUD
+  struct {
+    oric_osd_t msg;
+    oric_osd_t hud;
+    char msg_text[32];
+  } osd;
+
   uint16_t extension;
 
   oric_td_t td;  // Tape drive
 
   disk2_fdc_t fdc;  // Disk II floppy disk controller
 
+  microdisc_t md;  // Microdisc floppy disk interface
+
+  oric_hle_t hle;  // Fast path for hot ROM routines
+  uint16_t basic_rom_size;  // Bytes of BASIC ROM visible from $C000
+
+#ifdef ORIC_PROFILE
+  oric_prof_t* prof;  // PC sampling profiler, kept out of the snapshot
+#endif
+
+  // Idle loop detection
+  struct {
+    bool enabled;
+    uint16_t last_pc;             // PC at the previous SYNC
+    uint16_t loop_pc;             // Target of the last backward jump
+    uint16_t reject_pc;           // Loop that failed its last probe
+    uint32_t frame_skipped;       // Cycles skipped in the current frame
+    uint32_t last_frame_skipped;  // Cycles skipped in the previous frame
+    uint32_t total_skipped;
+  } idle;
+
+  sched_t sched;  // Device deadlines on the system_ticks time line
+
+  // Line-synchronous rendering: core 0 publishes the raster position, core 1
+  // renders every line the beam has passed
+  struct {
+    bool enabled;
+    uint16_t line;          // Raster line of the beam (core 0)
+    uint32_t frame;         // Frames started by the beam (core 0)
+    volatile uint32_t pos;  // frame << 9 | line, published to core 1
+    uint32_t render_frame;  // Frame being rendered (core 1)
+    int render_line;        // Next line to render, 224 when done (core 1)
+    uint8_t pattr;          // Video attributes between lines (core 1)
+    bool blink_state;       // Blink phase of the frame (core 1)
+  } beam;
+
   uint32_t system_ticks;
+  uint32_t run_end;  // oric_run() picks a new variant when it gets here
 
 } oric_t;
 
-// SAFEGUARD START: LUT for Oric pattern bits
-static uint8_t oric_pat_lut[64][6] __attribute__((section(".oric_ram")));
-static uint16_t line_buff[120]
-    __attribute__((section(".oric_ram")));  // 240 pixels
+// SAFEGUARD START
+// RAM behind the BASIC ROM, paged in by the Microdisc
+static uint8_t oric_overlay_ram[MICRODISC_OVERLAY_RAM_SIZE]
+    __attribute__((section(".oric_rom_in_ram")));
+// Raw track under the Microdisc head
+static uint8_t oric_microdisc_track[MICRODISC_TRACK_SIZE]
+    __attribute__((section(".oric_ram")));
 
 // SAFEGUARD END
 
+#ifdef ORIC_PROFILE
+// Histograms of the PC sampling profiler, too big to carry in oric_t
+static oric_prof_t oric_prof;
+#endif
+
 // Oric interface
 
 // Initialize a new Oric instance
@@ -186,9 +288,19 @@ void oric_tick(oric_t* sys);
 
 int oric_main(void);
 
+// Insert the tape image fN.edg, fN.tap or fN.wav, N is index + 1
+bool oric_insert_tape(oric_t* sys, int index);
+// Move the tape to the start of an indexed program
+bool oric_seek_tape(oric_t* sys, int block);
+
 // Tick Oric instance for a given number of microseconds, return number of
 // executed ticks
 uint32_t oric_exec(oric_t* sys, uint32_t micro_seconds);
+// Tick until system_ticks reaches end_ticks, with the oric_tick() variant
+// built for the devices in use
+void oric_run(oric_t* sys, uint32_t end_ticks);
+// Close the idle accounting of a frame, returns the cycles skipped in it
+uint32_t oric_idle_end_frame(oric_t* sys);
 // Take a snapshot, patches pointers to zero or offsets, returns snapshot
 // version
 uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst);
@@ -196,7 +308,19 @@ uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst);
 bool oric_load_snapshot(oric_t* sys, uint32_t version, oric_t* src);
 
 int __not_in_flash_func(oric_screen_update)(oric_t* sys);
+// Render the lines the emulated beam has passed since the last call, returns
+// 1 when a frame is complete. Use instead of oric_screen_update() with
+// beam_racing set.
+int __not_in_flash_func(oric_screen_race)(oric_t* sys);
+// Show a message over the middle of the screen until oric_hide_msg(), the
+// Oric display keeps running around and underneath it
 void oric_show_msg(oric_t* sys, const char* msg);
+// Remove the message, the lines under it get the Oric display back
+void oric_hide_msg(oric_t* sys);
+// Show up to ORIC_OSD_MAX_ROWS lines of text, separated by '\n', in the top
+// left corner until oric_hide_hud()
+void oric_show_hud(oric_t* sys, const char* text);
+void oric_hide_hud(oric_t* sys);
 void oric_ayQueuePush(uint16_t* queue, uint16_t* head, uint16_t value);
 
 #ifdef __cplusplus
@@ -217,8 +341,7 @@ extern uint16_t oric_via_queue_head;
 static void _oric_psg_out(int port_id, uint8_t data, void* user_data);
 static uint8_t _oric_psg_in(int port_id, void* user_data);
 static void _oric_init_memorymap(oric_t* sys);
-static void _oric_init_key_map(oric_t* sys);
-static void build_oric_pat_lut(void);
+static void _oric_update_rom_paging(oric_t* sys);
 static uint8_t oric_no_rom_glyph_row(char c, int row);
 
 #define PATTR_50HZ (0x02)
@@ -257,7 +380,15 @@ void oric_init(oric_t* sys, const oric_desc_t* desc) {
 
   // setup memory map and keyboard matrix
   _oric_init_memorymap(sys);
-  _oric_init_key_map(sys);
+  oric_kbd_init(&sys->kbd);
+
+  oric_hle_init(&sys->hle, sys->rom, ORIC_ROM_SIZE);
+  oric_hle_set_classes(&sys->hle, desc->hle_classes);
+#ifdef ORIC_PROFILE
+  sys->prof = &oric_prof;
+  oric_prof_init(sys->prof, 0);
+#endif
+  sys->idle.enabled = desc->idle_skip_enabled;
 
   sys->blink_counter = 0;
   sys->pattr = 0;
@@ -269,12 +400,25 @@ void oric_init(oric_t* sys, const oric_desc_t* desc) {
     oric_td_init(&sys->td);
   }
 
-  // Optionally setup floppy disk controller
-  if (desc->fdc_enabled) {
+  // Optionally setup the Microdisc, it replaces the Disk II interface
+  if (desc->microdisc_enabled) {
+    CHIPS_ASSERT(desc->roms.microdisc_rom.ptr &&
+                 (desc->roms.microdisc_rom.size == MICRODISC_EPROM_SIZE));
+    microdisc_init(&sys->md, desc->roms.microdisc_rom.ptr, oric_overlay_ram,
+                   oric_microdisc_track);
+    _oric_update_rom_paging(sys);
+  } else if (desc->fdc_enabled) {
+    // Optionally setup floppy disk controller
     disk2_fdc_init(&sys->fdc);
-    if (CHIPS_ARRAY_SIZE(oric_nib_images) > 0) {
-      disk2_fdd_insert_disk(&sys->fdc.fdd[0], oric_nib_images[0]);
-    }
+  }
+
+  // The tape and the Disk II timer run on demand
+  sched_init(&sys->sched, sys->system_ticks);
+
+  sys->beam.enabled = desc->beam_racing;
+  if (sys->beam.enabled) {
+    sched_set(&sys->sched, ORIC_EVENT_LINE,
+              sys->system_ticks + ORIC_LINE_CYCLES);
   }
 }
 
@@ -283,6 +427,9 @@ void oric_discard(oric_t* sys) {
   if (sys->fdc.valid) {
     disk2_fdc_discard(&sys->fdc);
   }
+  if (sys->md.valid) {
+    microdisc_discard(&sys->md);
+  }
   if (sys->td.valid) {
     oric_td_discard(&sys->td);
   }
@@ -301,44 +448,64 @@ void oric_reset(oric_t* sys) {
   if (sys->fdc.valid) {
     disk2_fdc_reset(&sys->fdc);
   }
+  if (sys->md.valid) {
+    microdisc_reset(&sys->md);
+    _oric_update_rom_paging(sys);
+  }
   if (sys->td.valid) {
     oric_td_reset(&sys->td);
   }
   MOS6502CPU_RESET(&sys->cpu);
 }
 
-static void __not_in_flash_func(_oric_mem_rw)(oric_t* sys, uint16_t addr,
-                                              bool rw) {
-  if ((addr >= 0x0300) && (addr <= 0x03FF)) {
-    // Memory-mapped IO area
-    if ((addr >= 0x0300) && (addr <= 0x030F)) {
+// I/O page, dispatched by register group
+static void __not_in_flash_func(_oric_io_rw)(oric_t* sys, uint16_t addr,
+                                             bool rw) {
+  switch ((addr >> 4) & 0xF) {
+    case 0x0:
+      // VIA
       if (rw) {
         MOS6502CPU_SET_DATA(&sys->cpu, mos6522via_read(&sys->via, addr & 0xF));
       } else {
         mos6522via_write(&sys->via, addr & 0xF, MOS6502CPU_GET_DATA(&sys->cpu));
       }
-    } else if ((addr >= 0x0310) && (addr <= 0x031F)) {
-      if (sys->fdc.valid) {
+      break;
+
+    case 0x1:
+      if (sys->md.valid) {
+        // Microdisc WD1793 and control registers
+        if (rw) {
+          MOS6502CPU_SET_DATA(&sys->cpu, microdisc_read(&sys->md, addr & 0xF));
+        } else {
+          microdisc_write(&sys->md, addr & 0xF, MOS6502CPU_GET_DATA(&sys->cpu));
+          if (sys->md.paging_changed) {
+            sys->md.paging_changed = false;
+            _oric_update_rom_paging(sys);
+          }
+        }
+      } else if (sys->fdc.valid) {
         // Disk II FDC
         if (rw) {
-          // Memory read
           MOS6502CPU_SET_DATA(&sys->cpu,
                               disk2_fdc_read_byte(&sys->fdc, addr & 0xF));
         } else {
-          // Memory write
           disk2_fdc_write_byte(&sys->fdc, addr & 0xF,
                                MOS6502CPU_GET_DATA(&sys->cpu));
         }
-      } else {
-        if (rw) {
-          MOS6502CPU_SET_DATA(&sys->cpu, 0x00);
+        if (sys->fdc.fdd[0].motor_timer_ticks &&
+            !sched_pending(&sys->sched, ORIC_EVENT_FDC)) {
+          sched_set(&sys->sched, ORIC_EVENT_FDC,
+                    sys->system_ticks + ORIC_FDC_CYCLES);
         }
+      } else if (rw) {
+        MOS6502CPU_SET_DATA(&sys->cpu, 0x00);
       }
-    } else if ((addr >= 0x0320) && (addr <= 0x03FF)) {
+      break;
+
+    default:
       if (sys->fdc.valid) {
         // Disk II boot rom
         if (rw) {
-          // Memory read
           MOS6502CPU_SET_DATA(&sys->cpu,
                               sys->boot_rom[(addr & 0xFF) + sys->extension]);
         } else {
@@ -371,110 +538,364 @@ static void __not_in_flash_func(_oric_mem_rw)(oric_t* sys, uint16_t addr,
           // }
           // SAFEGUARD END
         }
-      } else {
-        if (rw) {
-          MOS6502CPU_SET_DATA(&sys->cpu, 0x00);
-        }
+      } else if (rw) {
+        MOS6502CPU_SET_DATA(&sys->cpu, 0x00);
       }
-    }
-  } else {
-    // Regular memory access
-    if (rw) {
-      // Memory read
-      MOS6502CPU_SET_DATA(&sys->cpu, mem_rd(&sys->mem, addr));
-    } else {
-      // Memory write
-      mem_wr(&sys->mem, addr, MOS6502CPU_GET_DATA(&sys->cpu));
+      break;
+  }
+}
 
-      if (addr >= 0x9800 && addr <= 0xBFDF) {
-        sys->screen_dirty = true;
-      }
+static void __not_in_flash_func(_oric_mem_rw)(oric_t* sys, uint16_t addr,
+                                              bool rw) {
+  if ((addr & 0xFF00) == 0x0300) {
+    PERF_COUNT(PERF_IO_HITS);
+    _oric_io_rw(sys, addr, rw);
+  } else if (rw) {
+    MOS6502CPU_SET_DATA(&sys->cpu, mem_rd(&sys->mem, addr));
+  } else {
+    mem_wr(&sys->mem, addr, MOS6502CPU_GET_DATA(&sys->cpu));
+    if (addr >= 0x9800 && addr <= 0xBFDF) {
+      sys->screen_dirty = true;
     }
   }
 }
 
 static uint8_t _last_motor_state = 0;
 
-void __not_in_flash_func(oric_tick)(oric_t* sys) {
-  MOS6502CPU_TICK(&sys->cpu);
+// VIA timers and everything wired to the VIA ports
+static __force_inline void _oric_via_event(oric_t* sys, const uint32_t run) {
+  // The Microdisc shares the IRQ line
+  bool irq = mos6522via_tick(&sys->via, ORIC_VIA_CYCLES);
+  if ((run & ORIC_RUN_MICRODISC) && sys->md.valid) {
+    microdisc_tick(&sys->md, ORIC_VIA_CYCLES);
+    irq |= microdisc_irq(&sys->md);
+  }
+  if (irq && !sys->cpu.irq) {
+    PERF_COUNT(PERF_VIA_IRQS);
+  }
+  MOS6502CPU_SET_IRQ(&sys->cpu, irq);
 
-  _oric_mem_rw(sys, sys->cpu.addr, sys->cpu.rw);
+  // Update PSG state
+  if (mos6522via_get_cb2(&sys->via)) {
+    const uint8_t psg_data = mos6522via_get_pa(&sys->via);
+    if (mos6522via_get_ca2(&sys->via)) {
+      ay38910psg_latch_address(&sys->psg, psg_data);
+    } else {
+      if (sys->psg.addr < 0xe) {
+        uint16_t packed =
+            (uint16_t)(((uint16_t)sys->psg.addr << 8) | psg_data);
+        oric_ayQueuePush(oric_via_queue, &oric_via_queue_head, packed);
+      }
+      PERF_COUNT(PERF_PSG_WRITES);
+      ay38910psg_write(&sys->psg, psg_data);
+    }
+  }
 
-  // Tick FDC
-  if (sys->fdc.valid && (sys->system_ticks & 127) == 0) {
-    disk2_fdc_tick(&sys->fdc);
+  if (!mos6522via_get_cb2(&sys->via)) {
+    mos6522via_set_pa(&sys->via, ay38910psg_read(&sys->psg));
   }
 
-  // Tick VIA
-  if ((sys->system_ticks & 3) == 0) {
-    MOS6502CPU_SET_IRQ(&sys->cpu, mos6522via_tick(&sys->via, 4));
+  // PB0..PB2: select keyboard matrix line, PB3 senses it
+  uint8_t pb = mos6522via_get_pb(&sys->via);
+  if (oric_kbd_sense(&sys->kbd, pb & 7)) {
+    mos6522via_set_pb(&sys->via, pb | (1 << 3));
+  } else {
+    mos6522via_set_pb(&sys->via, pb & ~(1 << 3));
+  }
 
-    // Update PSG state
-    if (mos6522via_get_cb2(&sys->via)) {
-      const uint8_t psg_data = mos6522via_get_pa(&sys->via);
-      if (mos6522via_get_ca2(&sys->via)) {
-        ay38910psg_latch_address(&sys->psg, psg_data);
+  if ((run & ORIC_RUN_TAPE) && sys->td.valid) {
+    uint8_t motor_state = pb & 0x40;
+    if (motor_state != _last_motor_state) {
+      if (motor_state) {
+        sys->td.port |= ORIC_TD_PORT_MOTOR;
+        sched_set(&sys->sched, ORIC_EVENT_TAPE, sys->system_ticks);
+        DPRINTF("oric: motor on\n");
       } else {
-        if (sys->psg.addr < 0xe) {
-          uint16_t packed =
-              (uint16_t)(((uint16_t)sys->psg.addr << 8) | psg_data);
-          oric_ayQueuePush(oric_via_queue, &oric_via_queue_head, packed);
-        }
-        ay38910psg_write(&sys->psg, psg_data);
+        sys->td.port &= ~ORIC_TD_PORT_MOTOR;
+        sched_cancel(&sys->sched, ORIC_EVENT_TAPE);
+        DPRINTF("oric: motor off\n");
       }
+      _last_motor_state = motor_state;
+      // The fast paths are off while the motor runs, switch variants
+      sys->run_end = sys->system_ticks;
     }
-
-    if (!mos6522via_get_cb2(&sys->via)) {
-      mos6522via_set_pa(&sys->via, ay38910psg_read(&sys->psg));
+    // Tape output, PB7 is driven by timer 1 while saving
+    if (motor_state && (((pb & 0x80) != 0) !=
+                        ((sys->td.port & ORIC_TD_PORT_WRITE) != 0))) {
+      oric_td_write_edge(&sys->td, sys->system_ticks);
     }
+  }
 
-    // PB0..PB2: select keyboard matrix line
-    uint8_t pb = mos6522via_get_pb(&sys->via);
-    uint8_t line = pb & 7;
-    if (line >= 0 && line <= 7) {
-      uint8_t line_mask = 1 << line;
-      if (kbd_scan_lines(&sys->kbd) == line_mask) {
-        mos6522via_set_pb(&sys->via, pb | (1 << 3));
-      } else {
-        mos6522via_set_pb(&sys->via, pb & ~(1 << 3));
-      }
-    }
+  // A latched CB1 edge from the tape is seen by one VIA tick only
+  sys->via.pb.c1_triggered = false;
+}
 
-    if (sys->td.valid) {
-      uint8_t motor_state = pb & 0x40;
-      if (motor_state != _last_motor_state) {
-        if (motor_state) {
-          sys->td.port |= ORIC_TD_PORT_MOTOR;
-          DPRINTF("oric: motor on\n");
-        } else {
-          sys->td.port &= ~ORIC_TD_PORT_MOTOR;
-          DPRINTF("oric: motor off\n");
+// Service every device whose deadline is system_ticks or earlier. Periodic
+// events are rearmed from their own deadline, so they never drift.
+static __force_inline void _oric_run_events(oric_t* sys, const uint32_t run) {
+  int event;
+  while ((event = sched_pop(&sys->sched, sys->system_ticks)) >= 0) {
+    const uint32_t deadline = sys->sched.deadline[event];
+    switch (event) {
+      case ORIC_EVENT_TAPE: {
+        // Only level changes reach CB1, flagged on the cycle of the edge
+        PERF_COUNT(PERF_TAPE_READS);
+        const uint32_t cycles = oric_td_next_edge_sdcard(&sys->td);
+        if (mos6522via_edge_cb1(&sys->via,
+                                (sys->td.port & ORIC_TD_PORT_READ) != 0)) {
+          MOS6502CPU_SET_IRQ(&sys->cpu, true);
+        }
+        if (cycles) {
+          sched_set(&sys->sched, ORIC_EVENT_TAPE, deadline + cycles);
         }
-        _last_motor_state = motor_state;
+        break;
       }
 
-      static uint8_t t2 = 0;
-      t2++;
-      if (t2 == 52) {
-        oric_td_tick_sdcard(&sys->td);
-        t2 = 0;
-      }
-      if (sys->td.port & ORIC_TD_PORT_READ) {
-        mos6522via_set_cb1(&sys->via, true);
-      } else {
-        mos6522via_set_cb1(&sys->via, false);
-      }
+      case ORIC_EVENT_FDC:
+        disk2_fdc_tick(&sys->fdc);
+        if (sys->fdc.fdd[0].motor_timer_ticks) {
+          sched_set(&sys->sched, ORIC_EVENT_FDC, deadline + ORIC_FDC_CYCLES);
+        }
+        break;
+
+      case ORIC_EVENT_LINE:
+        if (++sys->beam.line == ORIC_FRAME_LINES) {
+          sys->beam.line = 0;
+          sys->beam.frame++;
+        }
+        // One 32-bit store, core 1 never sees a torn position
+        sys->beam.pos = (sys->beam.frame << 9) | sys->beam.line;
+        sched_set(&sys->sched, ORIC_EVENT_LINE, deadline + ORIC_LINE_CYCLES);
+        break;
+
+      default:
+        break;
     }
   }
+}
 
+// Tick everything but the CPU for one cycle
+static __force_inline void _oric_tick_devices(oric_t* sys, const uint32_t run) {
+  if ((sys->system_ticks & (ORIC_VIA_CYCLES - 1)) == 0) {
+    _oric_via_event(sys, run);
+  }
+  if (sched_due(&sys->sched, sys->system_ticks)) {
+    _oric_run_events(sys, run);
+  }
   sys->system_ticks++;
 }
 
+// Advance everything but the CPU by a number of cycles, jumping from one VIA
+// tick or device deadline to the next
+static void __not_in_flash_func(_oric_advance)(oric_t* sys, uint32_t cycles) {
+  const uint32_t end = sys->system_ticks + cycles;
+  uint32_t tick = sys->system_ticks;
+  while ((int32_t)(tick - end) < 0) {
+    uint32_t next = (tick + ORIC_VIA_CYCLES - 1) & ~(ORIC_VIA_CYCLES - 1);
+    if ((int32_t)(sys->sched.next - next) < 0) {
+      next = ((int32_t)(sys->sched.next - tick) > 0) ? sys->sched.next : tick;
+    }
+    if ((int32_t)(next - end) >= 0) {
+      break;
+    }
+    sys->system_ticks = next;
+    _oric_tick_devices(sys, ORIC_RUN_ALL);
+    tick = sys->system_ticks;
+  }
+  sys->system_ticks = end;
+}
+
+// Cycles until the VIA can raise its next timer interrupt, minus a margin
+// for the 4-cycle VIA tick and its interrupt pipeline
+static uint32_t _oric_cycles_to_via_irq(oric_t* sys) {
+  const mos6522via_t* via = &sys->via;
+  // A flag set in the last VIA tick reaches the IRQ line at the next one
+  if ((via->intr.ifr & via->intr.ier & 0x7F) && !sys->cpu.iflag) {
+    return 0;
+  }
+  int32_t cycles = 20000;
+  if ((via->intr.ier & MOS6522VIA_IRQ_T1) &&
+      (MOS6522VIA_ACR_T1_CONTINUOUS(via) || !via->t1.t_bit) &&
+      (via->t1.counter < cycles)) {
+    cycles = via->t1.counter;
+  }
+  if ((via->intr.ier & MOS6522VIA_IRQ_T2) && !via->t2.t_bit &&
+      !MOS6522VIA_ACR_T2_COUNT_PB6(via) && (via->t2.counter < cycles)) {
+    cycles = via->t2.counter;
+  }
+  cycles -= 8;
+  return (cycles > 0) ? (uint32_t)cycles : 0;
+}
+
+// Run a trapped ROM routine on the fast path and bring the rest of the
+// machine up to date
+static void __not_in_flash_func(_oric_hle_trap)(oric_t* sys,
+                                               const oric_hle_trap_t* trap) {
+  // Tape input is sampled by the ROM cycle by cycle, keep it exact
+  if (sys->td.port & ORIC_TD_PORT_MOTOR) {
+    return;
+  }
+  // The traps are BASIC ROM addresses, ignore them while it is paged out
+  if ((uint16_t)(sys->cpu.PC - 0xC000) >= sys->basic_rom_size) {
+    return;
+  }
+  const uint32_t cycles = oric_hle_run(&sys->hle, trap, &sys->cpu, &sys->mem,
+                                       _oric_cycles_to_via_irq(sys));
+  if (cycles == 0) {
+    return;
+  }
+  if (sys->hle.video_written) {
+    sys->screen_dirty = true;
+  }
+  _oric_advance(sys, cycles);
+  // Restart the instruction fetch where the fast path stopped
+  sys->cpu.addr = sys->cpu.PC;
+  _oric_mem_rw(sys, sys->cpu.addr, true);
+}
+
+// Longest loop body in bytes considered for idle detection
+#ifndef ORIC_IDLE_MAX_LOOP
+#define ORIC_IDLE_MAX_LOOP 64u
+#endif
+
+// Detect a loop that only reads RAM or ROM and leaves the CPU unchanged,
+// and skip its iterations up to the next VIA interrupt
+static void __not_in_flash_func(_oric_idle_check)(oric_t* sys) {
+  const uint16_t pc = sys->cpu.addr;
+  const uint16_t last_pc = sys->idle.last_pc;
+  sys->idle.last_pc = pc;
+  // An interrupt leaves the loop, coming back to it is a new loop
+  if (sys->cpu.irq && !sys->cpu.iflag) {
+    sys->idle.loop_pc = 0;
+    return;
+  }
+  if ((uint16_t)(last_pc - pc) > ORIC_IDLE_MAX_LOOP) {
+    return;
+  }
+  // Wait for the second jump back to the same target. The CPU has left a
+  // rejected loop, probe it again when it comes back.
+  if (pc != sys->idle.loop_pc) {
+    sys->idle.loop_pc = pc;
+    sys->idle.reject_pc = 0;
+    return;
+  }
+  if (pc == sys->idle.reject_pc) {
+    return;
+  }
+  // The skip keeps only the VIA timers running: no PSG bus cycle, no tape
+  // input and no timer output on PB7
+  mos6522via_t* via = &sys->via;
+  if ((sys->td.port & ORIC_TD_PORT_MOTOR) || mos6522via_get_cb2(via) ||
+      MOS6522VIA_ACR_T1_SET_PB7(via)) {
+    return;
+  }
+  // Disk polling loops wait on the controller, run them cycle by cycle
+  if (sys->md.valid && wd1793fdc_busy(&sys->md.fdc)) {
+    return;
+  }
+  const uint32_t budget = _oric_cycles_to_via_irq(sys);
+  const uint32_t cycles =
+      oric_hle_probe_loop(&sys->hle, &sys->cpu, &sys->mem, 256);
+  if (cycles == 0) {
+    sys->idle.reject_pc = pc;
+    return;
+  }
+  const uint32_t skip = (budget / cycles) * cycles;
+  if (skip) {
+    _oric_advance(sys, skip);
+    sys->idle.frame_skipped += skip;
+  }
+}
+
+// One CPU cycle, run is a constant so every variant keeps only the checks
+// for its devices
+static __force_inline void _oric_tick(oric_t* sys, const uint32_t run) {
+  MOS6502CPU_TICK(&sys->cpu);
+  _oric_mem_rw(sys, sys->cpu.addr, sys->cpu.rw);
+
+  if (sys->cpu.sync) {
+#ifdef ORIC_PROFILE
+    oric_prof_sync(sys->prof, sys->cpu.addr);
+#endif
+#ifdef ORIC_HLE_VERIFY
+    if (sys->hle.verify.pending) {
+      oric_hle_verify_check(&sys->hle, &sys->cpu, &sys->mem);
+    }
+#endif
+    if ((run & ORIC_RUN_FAST) && sys->hle.page_mask) {
+      const oric_hle_trap_t* trap = oric_hle_find(&sys->hle, sys->cpu.addr);
+      if (trap) {
+        _oric_hle_trap(sys, trap);
+      }
+    }
+    if ((run & ORIC_RUN_FAST) && sys->idle.enabled) {
+      _oric_idle_check(sys);
+    }
+  }
+
+  _oric_tick_devices(sys, run);
+}
+
+void __not_in_flash_func(oric_tick)(oric_t* sys) {
+  _oric_tick(sys, ORIC_RUN_ALL);
+}
+
+// Devices the next cycles have to serve
+static inline uint32_t _oric_run_devices(const oric_t* sys) {
+  uint32_t run = 0;
+  if (sys->md.valid) {
+    run |= ORIC_RUN_MICRODISC;
+  }
+  if (sys->td.valid) {
+    run |= ORIC_RUN_TAPE;
+  }
+  // The ROM fast path and the idle skip both stand aside for the tape
+  if (!(sys->td.port & ORIC_TD_PORT_MOTOR)) {
+    run |= ORIC_RUN_FAST;
+  }
+  return run;
+}
+
+// Tick one variant up to run_end
+#define _ORIC_RUN_LOOP(sys, run)                                  \
+  while ((int32_t)((sys)->system_ticks - (sys)->run_end) < 0) { \
+    PERF_COUNT(PERF_TICK_BURSTS);                                 \
+    _oric_tick((sys), (run));                                     \
+  }
+
+void __not_in_flash_func(oric_run)(oric_t* sys, uint32_t end_ticks) {
+  // A device change moves run_end back to system_ticks to end the loop
+  while ((int32_t)(sys->system_ticks - end_ticks) < 0) {
+    sys->run_end = end_ticks;
+    switch (_oric_run_devices(sys)) {
+      case ORIC_RUN_TAPE | ORIC_RUN_FAST:  // Tape stopped, no Microdisc
+        _ORIC_RUN_LOOP(sys, ORIC_RUN_TAPE | ORIC_RUN_FAST);
+        break;
+
+      case ORIC_RUN_TAPE:  // Tape playing or recording, no Microdisc
+        _ORIC_RUN_LOOP(sys, ORIC_RUN_TAPE);
+        break;
+
+      case ORIC_RUN_FAST:  // No tape drive, no Microdisc
+        _ORIC_RUN_LOOP(sys, ORIC_RUN_FAST);
+        break;
+
+      default:  // Microdisc, every device checked at run time
+        while ((int32_t)(sys->system_ticks - sys->run_end) < 0) {
+          PERF_COUNT(PERF_TICK_BURSTS);
+          oric_tick(sys);
+        }
+        break;
+    }
+  }
+}
+
+
 // PSG OUT callback (nothing to do here)
 static void _oric_psg_out(int port_id, uint8_t data, void* user_data) {
   oric_t* sys = (oric_t*)user_data;
   if (port_id == AY38910PSG_PORT_A) {
-    kbd_set_active_columns(&sys->kbd, data ^ 0xFF);
+    oric_kbd_set_columns(&sys->kbd, data ^ 0xFF);
   } else {
     // This shouldn't happen since the AY-3-8912 only has one IO port
   }
@@ -488,14 +909,6 @@ static uint8_t _oric_psg_in(int port_id, void* user_data) {
   return 0xFF;
 }
 
-static void build_oric_pat_lut(void) {
-  for (int pat = 0; pat < 64; pat++) {
-    for (int b = 0; b < 6; b++) {
-      oric_pat_lut[pat][b] = (pat & (0x20 >> b)) ? 1 : 0;
-    }
-  }
-}
-
 static uint8_t oric_no_rom_glyph_row(char c, int row) {
   if (c >= 'a' && c <= 'z') {
     c = (char)(c - 'a' + 'A');
@@ -561,6 +974,21 @@ static uint8_t oric_no_rom_glyph_row(char c, int row) {
                                        0x33, 0x33, 0x3C, 0x00};
       return glyph[row & 7];
     }
+    case 'H': {
+      static const uint8_t glyph[8] = {0x33, 0x33, 0x33, 0x3F,
+                                       0x33, 0x33, 0x33, 0x00};
+      return glyph[row & 7];
+    }
+    case 'S': {
+      static const uint8_t glyph[8] = {0x1E, 0x33, 0x30, 0x1E,
+                                       0x03, 0x33, 0x1E, 0x00};
+      return glyph[row & 7];
+    }
+    case 'T': {
+      static const uint8_t glyph[8] = {0x3F, 0x0C, 0x0C, 0x0C,
+                                       0x0C, 0x0C, 0x0C, 0x00};
+      return glyph[row & 7];
+    }
     case '0': {
       static const uint8_t glyph[8] = {0x1E, 0x33, 0x33, 0x33,
                                        0x33, 0x33, 0x1E, 0x00};
@@ -616,231 +1044,606 @@ static uint8_t oric_no_rom_glyph_row(char c, int row) {
                                        0x00, 0x0C, 0x0C, 0x00};
       return glyph[row & 7];
     }
+    case 'B': {
+      static const uint8_t glyph[8] = {0x3E, 0x33, 0x33, 0x3E,
+                                       0x33, 0x33, 0x3E, 0x00};
+      return glyph[row & 7];
+    }
+    case 'C': {
+      static const uint8_t glyph[8] = {0x1E, 0x33, 0x30, 0x30,
+                                       0x30, 0x33, 0x1E, 0x00};
+      return glyph[row & 7];
+    }
+    case 'K': {
+      static const uint8_t glyph[8] = {0x33, 0x36, 0x3C, 0x38,
+                                       0x3C, 0x36, 0x33, 0x00};
+      return glyph[row & 7];
+    }
+    case 'P': {
+      static const uint8_t glyph[8] = {0x3E, 0x33, 0x33, 0x3E,
+                                       0x30, 0x30, 0x30, 0x00};
+      return glyph[row & 7];
+    }
+    case 'V': {
+      static const uint8_t glyph[8] = {0x33, 0x33, 0x33, 0x33,
+                                       0x33, 0x1E, 0x0C, 0x00};
+      return glyph[row & 7];
+    }
+    case 'W': {
+      static const uint8_t glyph[8] = {0x33, 0x33, 0x33, 0x33,
+                                       0x37, 0x3F, 0x33, 0x00};
+      return glyph[row & 7];
+    }
+    case 'X': {
+      static const uint8_t glyph[8] = {0x33, 0x33, 0x1E, 0x0C,
+                                       0x1E, 0x33, 0x33, 0x00};
+      return glyph[row & 7];
+    }
+    case 'Y': {
+      static const uint8_t glyph[8] = {0x33, 0x33, 0x33, 0x1E,
+                                       0x0C, 0x0C, 0x0C, 0x00};
+      return glyph[row & 7];
+    }
+    case 'Z': {
+      static const uint8_t glyph[8] = {0x3F, 0x03, 0x06, 0x0C,
+                                       0x18, 0x30, 0x3F, 0x00};
+      return glyph[row & 7];
+    }
+    case '/': {
+      static const uint8_t glyph[8] = {0x03, 0x03, 0x06, 0x0C,
+                                       0x18, 0x30, 0x30, 0x00};
+      return glyph[row & 7];
+    }
+    case '%': {
+      static const uint8_t glyph[8] = {0x31, 0x33, 0x06, 0x0C,
+                                       0x18, 0x33, 0x23, 0x00};
+      return glyph[row & 7];
+    }
+    case ':': {
+      static const uint8_t glyph[8] = {0x00, 0x0C, 0x0C, 0x00,
+                                       0x0C, 0x0C, 0x00, 0x00};
+      return glyph[row & 7];
+    }
+    case '-': {
+      static const uint8_t glyph[8] = {0x00, 0x00, 0x00, 0x1E,
+                                       0x00, 0x00, 0x00, 0x00};
+      return glyph[row & 7];
+    }
     case ' ':
     default:
       return 0x00;
   }
 }
 
-void oric_show_msg(oric_t* sys, const char* msg) {
-  CHIPS_ASSERT(sys && sys->valid);
-  if (!msg || *msg == '\0') {
-    return;
+// Render state of one screen line
+typedef struct {
+  uint32_t p0;      // Bitplanes of the cells not written yet, the newest
+  uint32_t p1;      // cell in the low bits
+  uint32_t p2;
+  int pending;      // Bits of p0..p2 not written yet
+  uint16_t* dst;    // Next group of plane words
+  uint8_t lattr;    // Line attributes
+  uint8_t fgcol;
+  uint8_t bgcol;
+  uint8_t pattr;    // Video attributes, carried from line to line
+  bool blink;       // Blink phase that hides the foreground
+  bool blinks;      // Some cell of the line is under LATTR_BLINK
+} _oric_line_t;
+
+// Append a 6 pixel cell. A plane takes the pattern where its foreground
+// color bit is set and the inverted pattern where its background color bit
+// is set.
+static inline void _oric_line_put(_oric_line_t* l, uint32_t pat, uint8_t c_fg,
+                                  uint8_t c_bg) {
+  const uint32_t on = pat & 0x3F;
+  const uint32_t off = on ^ 0x3F;
+  l->p0 = (l->p0 << 6) | (on & -(uint32_t)(c_fg & 1)) |
+          (off & -(uint32_t)(c_bg & 1));
+  l->p1 = (l->p1 << 6) | (on & -(uint32_t)((c_fg >> 1) & 1)) |
+          (off & -(uint32_t)((c_bg >> 1) & 1));
+  l->p2 = (l->p2 << 6) | (on & -(uint32_t)((c_fg >> 2) & 1)) |
+          (off & -(uint32_t)((c_bg >> 2) & 1));
+
+  // 6 pixel cells straddle the 16 pixel plane words, write a word once it
+  // is complete
+  l->pending += 6;
+  if (l->pending >= 16) {
+    l->pending -= 16;
+    l->dst[0] = (uint16_t)(l->p0 >> l->pending);
+    l->dst[1] = (uint16_t)(l->p1 >> l->pending);
+    l->dst[2] = (uint16_t)(l->p2 >> l->pending);
+    l->dst += ATARI_ST_BITCOLORS_PER_PIXEL;
   }
-  uint16_t* restrict fb = sys->fb;
-  memset(fb, 0, ATARI_ST_FRAMEBUFFER_SIZE_16WORDS * sizeof(uint16_t));
-
-  const int glyph_w = 6;
-  const int glyph_h = 8;
-  const uint8_t fg = 0x07;
-  const int len = (int)strlen(msg);
-  int start_x = (ORIC_SCREEN_WIDTH - (len * glyph_w)) / 2;
-  int start_y = (ORIC_SCREEN_HEIGHT - glyph_h) / 2;
-  if (start_x < 0) start_x = 0;
-  if (start_y < 0) start_y = 0;
-
-  for (int y = 0; y < glyph_h; y++) {
-    int screen_y = start_y + y;
-    if (screen_y >= ORIC_SCREEN_HEIGHT) {
-      break;
+}
+
+// Append any cell: serial attributes, inverse and blink
+static inline void _oric_line_cell(_oric_line_t* l, uint8_t ch, uint8_t pat) {
+  if (!(ch & 0x60)) {
+    pat = 0x00;
+    switch (ch & 0x18) {
+      case 0x00:
+        l->fgcol = ch & 7;
+        break;
+      case 0x08:
+        l->lattr = ch & 7;
+        break;
+      case 0x10:
+        l->bgcol = ch & 7;
+        break;
+      case 0x18:
+        l->pattr = ch & 7;
+        break;
     }
-    memset(line_buff, 0, sizeof(line_buff));
+  }
 
-    for (int i = 0; i < len; i++) {
-      uint8_t row_bits = oric_no_rom_glyph_row(msg[i], y);
-      int base_x = start_x + (i * glyph_w);
-      for (int bit = 0; bit < glyph_w; bit++) {
-        if (row_bits & (1u << (glyph_w - 1 - bit))) {
-          int x = base_x + bit;
-          if (x < 0 || x >= ORIC_SCREEN_WIDTH) {
-            continue;
-          }
-          int idx = x >> 1;
-          uint16_t packed = line_buff[idx];
-          if ((x & 1) == 0) {
-            packed = (uint16_t)((packed & 0xFFF0u) | fg);
-          } else {
-            packed = (uint16_t)((packed & 0xF0FFu) | ((uint16_t)fg << 8));
-          }
-          line_buff[idx] = packed;
+  uint8_t c_fg = l->fgcol;
+  uint8_t c_bg = l->bgcol;
+
+  if (ch & 0x80) {  // inverse
+    c_bg ^= 0x07;
+    c_fg ^= 0x07;
+  }
+  if (l->lattr & LATTR_BLINK) {
+    l->blinks = true;
+    if (l->blink) {
+      c_fg = c_bg;
+    }
+  }
+  _oric_line_put(l, pat, c_fg, c_bg);
+}
+
+// HIRES line. Plain pixel bytes ($20-$7F) between two attribute or inverse
+// bytes share one color pair, so every plane is the pattern through the same
+// AND and XOR masks. Returns where the line leaves HIRES, 40 if it doesn't.
+static int __not_in_flash_func(_oric_render_hires)(_oric_line_t* l,
+                                                    const uint8_t* row) {
+  int x = 0;
+  while (x < 40) {
+    const uint8_t c_bg = l->bgcol;
+    uint8_t c_fg = l->fgcol;
+    if (l->lattr & LATTR_BLINK) {
+      l->blinks = true;
+      if (l->blink) {
+        c_fg = c_bg;
+      }
+    }
+    const uint32_t and0 = -(uint32_t)((c_fg ^ c_bg) & 1);
+    const uint32_t and1 = -(uint32_t)(((c_fg ^ c_bg) >> 1) & 1);
+    const uint32_t and2 = -(uint32_t)(((c_fg ^ c_bg) >> 2) & 1);
+    const uint32_t xor0 = -(uint32_t)(c_bg & 1);
+    const uint32_t xor1 = -(uint32_t)((c_bg >> 1) & 1);
+    const uint32_t xor2 = -(uint32_t)((c_bg >> 2) & 1);
+
+    uint8_t ch;
+    while ((x < 40) && ((uint8_t)((ch = row[x]) - 0x20) < 0x60)) {
+      // 8 cells from a word boundary fill 3 plane words exactly
+      if ((l->pending == 0) && (x <= 32)) {
+        const uint8_t* b = &row[x];
+        uint8_t other = 0;
+        for (int i = 0; i < 8; i++) {
+          other |= (uint8_t)((uint8_t)(b[i] - 0x20) >= 0x60);
         }
+        if (!other) {
+          const uint32_t w0 = ((b[0] & 0x3Fu) << 10) | ((b[1] & 0x3Fu) << 4) |
+                              ((b[2] & 0x3Fu) >> 2);
+          const uint32_t w1 = ((b[2] & 0x03u) << 14) | ((b[3] & 0x3Fu) << 8) |
+                              ((b[4] & 0x3Fu) << 2) | ((b[5] & 0x3Fu) >> 4);
+          const uint32_t w2 = ((b[5] & 0x0Fu) << 12) | ((b[6] & 0x3Fu) << 6) |
+                              (b[7] & 0x3Fu);
+          uint16_t* restrict d = l->dst;
+          d[0] = (uint16_t)((w0 & and0) ^ xor0);
+          d[1] = (uint16_t)((w0 & and1) ^ xor1);
+          d[2] = (uint16_t)((w0 & and2) ^ xor2);
+          d[3] = (uint16_t)((w1 & and0) ^ xor0);
+          d[4] = (uint16_t)((w1 & and1) ^ xor1);
+          d[5] = (uint16_t)((w1 & and2) ^ xor2);
+          d[6] = (uint16_t)((w2 & and0) ^ xor0);
+          d[7] = (uint16_t)((w2 & and1) ^ xor1);
+          d[8] = (uint16_t)((w2 & and2) ^ xor2);
+          l->dst += 3 * ATARI_ST_BITCOLORS_PER_PIXEL;
+          x += 8;
+          continue;
+        }
+      }
+      l->p0 = (l->p0 << 6) | (((ch & and0) ^ xor0) & 0x3F);
+      l->p1 = (l->p1 << 6) | (((ch & and1) ^ xor1) & 0x3F);
+      l->p2 = (l->p2 << 6) | (((ch & and2) ^ xor2) & 0x3F);
+      l->pending += 6;
+      if (l->pending >= 16) {
+        l->pending -= 16;
+        l->dst[0] = (uint16_t)(l->p0 >> l->pending);
+        l->dst[1] = (uint16_t)(l->p1 >> l->pending);
+        l->dst[2] = (uint16_t)(l->p2 >> l->pending);
+        l->dst += ATARI_ST_BITCOLORS_PER_PIXEL;
       }
+      x++;
+    }
+    if (x == 40) {
+      break;
     }
 
-    uint16_t* restrict dst_line =
-        fb + (screen_y * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS);
-    for (int word = 0; word < 15; word++) {
-      uint16_t p0 = 0;
-      uint16_t p1 = 0;
-      uint16_t p2 = 0;
-      uint16_t bit = 0x8000;
-      uint16_t* p = dst_line + (word * ATARI_ST_BITCOLORS_PER_PIXEL);
-      int base_word = word * 8;
-
-      for (int i = 0; i < 8; i++) {
-        uint16_t packed = line_buff[base_word + i];
-        uint8_t c0 = packed & 0x0F;
-        uint8_t c1 = (packed >> 8) & 0x0F;
-
-        if (c0 & 0x01) p0 |= bit;
-        if (c0 & 0x02) p1 |= bit;
-        if (c0 & 0x04) p2 |= bit;
-        bit >>= 1;
-
-        if (c1 & 0x01) p0 |= bit;
-        if (c1 & 0x02) p1 |= bit;
-        if (c1 & 0x04) p2 |= bit;
-        bit >>= 1;
-      }
+    // Attribute or inverse byte ends the run
+    _oric_line_cell(l, ch, ch);
+    x++;
+    if (!(l->pattr & PATTR_HIRES)) {
+      break;
+    }
+  }
+  return x;
+}
+
+// Render screen line y, returns the video attributes for the next line
+static uint8_t __not_in_flash_func(_oric_render_line)(oric_t* sys, int y,
+                                                      uint8_t pattr,
+                                                      bool blink_state,
+                                                      bool* blinks) {
+  PERF_COUNT(PERF_RENDER_LINES);
+  const uint8_t* restrict ram = sys->ram;
+  _oric_line_t l = {
+      .dst = sys->fb + (y * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS),
+      .fgcol = 7,
+      .pattr = pattr,
+      .blink = blink_state,
+  };
+
+  int x = 0;
+  if ((pattr & PATTR_HIRES) && y < 200) {
+    x = _oric_render_hires(&l, &ram[0xA000 + y * 40]);
+  }
+  // Text lines, and the rest of a line that has left HIRES
+  for (; x < 40; x++) {
+    uint8_t ch, pat;
+
+    if ((l.pattr & PATTR_HIRES) && y < 200) {
+      ch = pat = ram[0xA000 + y * 40 + x];
+    } else {
+      ch = ram[0xBB80 + (y >> 3) * 40 + x];
+      int off = (l.lattr & LATTR_DSIZE ? y >> 1 : y) & 7;
+      const uint8_t* base;
 
-      p[0] = p0;
-      p[1] = p1;
-      p[2] = p2;
+      if (l.pattr & PATTR_HIRES) {
+        base = (l.lattr & LATTR_ALT) ? (ram + 0x9C00) : (ram + 0x9800);
+      } else {
+        base = (l.lattr & LATTR_ALT) ? (ram + 0xB800) : (ram + 0xB400);
+      }
+      pat = base[((ch & 0x7F) << 3) | off];
     }
+    _oric_line_cell(&l, ch, pat);
   }
+  *blinks = l.blinks;
+  return l.pattr;
+}
 
+// Tell the ST a new frame is ready
+static void __not_in_flash_func(_oric_present_frame)(oric_t* sys) {
   sys->fb_toggle ^= 1u;
   uint8_t* fb_base = (uint8_t*)&__rom_in_ram_start__;
   uint32_t* fb_toggle_fb = (uint32_t*)(fb_base + 0x0FFC);
   *fb_toggle_fb = sys->fb_toggle ? 0xFFFFFFFF : 0x0;
-  sys->screen_dirty = false;
 }
 
-int __not_in_flash_func(oric_screen_update)(oric_t* sys) {
-  bool dirty = sys->screen_dirty;
-  if (!dirty) return 0;
+// Boxes have a margin of one glyph width left and right and _ORIC_OSD_MARGIN
+// lines above, below and between the text rows
+#define _ORIC_OSD_GLYPH_W (6)
+#define _ORIC_OSD_GLYPH_H (8)
+#define _ORIC_OSD_MARGIN (2)
+#define _ORIC_OSD_ROW_LINES (_ORIC_OSD_GLYPH_H + _ORIC_OSD_MARGIN)
+
+// Lay out the rows of text at line top, centered or from the left edge
+static void _oric_osd_layout(oric_osd_t* osd, const char* text, int top,
+                             bool center) {
+  const int max_len = ORIC_SCREEN_WIDTH / _ORIC_OSD_GLYPH_W - 2;
+  const char* rows[ORIC_OSD_MAX_ROWS];
+  int lens[ORIC_OSD_MAX_ROWS];
+  int num_rows = 0;
+  int width = 0;
+  while (num_rows < ORIC_OSD_MAX_ROWS) {
+    const char* end = strchr(text, '\n');
+    int len = end ? (int)(end - text) : (int)strlen(text);
+    if (len > max_len) {
+      len = max_len;
+    }
+    rows[num_rows] = text;
+    lens[num_rows++] = len;
+    if (len > width) {
+      width = len;
+    }
+    if (!end) {
+      break;
+    }
+    text = end + 1;
+  }
 
-  bool blink_state = (sys->blink_counter & 0x20) != 0;
-  sys->blink_counter = (sys->blink_counter + 1) & 0x3F;
+  const int start_x =
+      center ? (ORIC_SCREEN_WIDTH - (width * _ORIC_OSD_GLYPH_W)) / 2
+             : _ORIC_OSD_GLYPH_W;
+  const int box_x1 = start_x + ((width + 1) * _ORIC_OSD_GLYPH_W);
+  osd->word0 = (uint8_t)((start_x - _ORIC_OSD_GLYPH_W) >> 4);
+  osd->word1 = (uint8_t)(box_x1 > ORIC_SCREEN_WIDTH ? ORIC_SCREEN_WIDTH >> 4
+                                                    : (box_x1 + 15) >> 4);
+  osd->top = (uint8_t)top;
+  osd->lines = (uint8_t)((num_rows * _ORIC_OSD_ROW_LINES) + _ORIC_OSD_MARGIN);
+  osd->num_rows = (uint8_t)num_rows;
+
+  memset(osd->bits, 0, sizeof(osd->bits));
+  for (int r = 0; r < num_rows; r++) {
+    for (int row = 0; row < _ORIC_OSD_GLYPH_H; row++) {
+      for (int i = 0; i < lens[r]; i++) {
+        const uint8_t row_bits = oric_no_rom_glyph_row(rows[r][i], row);
+        const int base_x = start_x + (i * _ORIC_OSD_GLYPH_W);
+        for (int bit = 0; bit < _ORIC_OSD_GLYPH_W; bit++) {
+          const int x = base_x + bit;
+          if (row_bits & (1u << (_ORIC_OSD_GLYPH_W - 1 - bit))) {
+            osd->bits[r][row][x >> 4] |= (uint16_t)(0x8000u >> (x & 15));
+          }
+        }
+      }
+    }
+  }
+}
 
-  uint8_t pattr = sys->pattr;
-  uint8_t* restrict ram = sys->ram;
+// Draw the part of a box that lies on lines y0..y1-1 over the rendered Oric
+// display, white text on black
+static void __not_in_flash_func(_oric_osd_draw_box)(oric_t* sys,
+                                                     const oric_osd_t* osd,
+                                                     int y0, int y1) {
+  if (!osd->active) {
+    return;
+  }
+  if (y0 < osd->top) {
+    y0 = osd->top;
+  }
+  if (y1 > osd->top + osd->lines) {
+    y1 = osd->top + osd->lines;
+  }
+  for (int y = y0; y < y1; y++) {
+    const int rel = y - osd->top - _ORIC_OSD_MARGIN;
+    const int r = rel / _ORIC_OSD_ROW_LINES;
+    const int row = rel % _ORIC_OSD_ROW_LINES;
+    const uint16_t* bits =
+        ((rel >= 0) && (row < _ORIC_OSD_GLYPH_H)) ? osd->bits[r][row] : NULL;
+    uint16_t* dst = sys->fb + (y * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS) +
+                    (osd->word0 * ATARI_ST_BITCOLORS_PER_PIXEL);
+    for (int w = osd->word0; w < osd->word1; w++) {
+      const uint16_t pixels = bits ? bits[w] : 0;
+      dst[0] = pixels;
+      dst[1] = pixels;
+      dst[2] = pixels;
+      dst += ATARI_ST_BITCOLORS_PER_PIXEL;
+    }
+  }
+}
 
-  uint16_t* restrict fb = sys->fb;
+// Draw every box over lines y0..y1-1, the message on top of the HUD
+static void __not_in_flash_func(_oric_osd_draw)(oric_t* sys, int y0, int y1) {
+  _oric_osd_draw_box(sys, &sys->osd.hud, y0, y1);
+  _oric_osd_draw_box(sys, &sys->osd.msg, y0, y1);
+}
 
-  for (int y = 0; y < 224; y++) {
-    uint16_t* restrict dst_line =
-        fb + (y * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS);
+// Render lines y0..y1-1 again from the attributes of the last full render,
+// with the boxes still shown on top
+static void _oric_osd_restore(oric_t* sys, int y0, int y1) {
+  if (sys->beam.enabled) {
+    // The beam renders every line of the next frame anyway
+    return;
+  }
+  for (int y = y0; y < y1; y++) {
+    bool blinks;
+    (void)_oric_render_line(sys, y, sys->line_pattr[y], sys->blink_rendered,
+                            &blinks);
+  }
+  _oric_osd_draw(sys, y0, y1);
+}
 
-    // Line attributes and current colors
-    uint8_t lattr = 0;
-    uint8_t fgcol = 7;
-    uint8_t bgcol = 0;
+static void _oric_osd_show(oric_t* sys, oric_osd_t* osd, const char* text,
+                           int top, bool center) {
+  const bool was_active = osd->active;
+  const oric_osd_t old = {.top = osd->top,
+                          .lines = osd->lines,
+                          .word0 = osd->word0,
+                          .word1 = osd->word1};
+  _oric_osd_layout(osd, text, top, center);
+  osd->active = true;
+  if (was_active &&
+      ((old.top != osd->top) || (old.lines != osd->lines) ||
+       (old.word0 != osd->word0) || (old.word1 != osd->word1))) {
+    // The new box may not cover the old one
+    _oric_osd_restore(sys, old.top, old.top + old.lines);
+  }
+  _oric_osd_draw(sys, osd->top, osd->top + osd->lines);
+  _oric_present_frame(sys);
+}
 
-    for (int x = 0; x < 40; x++) {
-      uint8_t ch, pat;
+static void _oric_osd_hide(oric_t* sys, oric_osd_t* osd) {
+  if (!osd->active) {
+    return;
+  }
+  osd->active = false;
+  _oric_osd_restore(sys, osd->top, osd->top + osd->lines);
+  if (!sys->beam.enabled) {
+    _oric_present_frame(sys);
+  }
+}
 
-      if ((pattr & PATTR_HIRES) && y < 200) {
-        ch = pat = ram[0xA000 + y * 40 + x];
-      } else {
-        ch = ram[0xBB80 + (y >> 3) * 40 + x];
-        int off = (lattr & LATTR_DSIZE ? y >> 1 : y) & 7;
-        const uint8_t* base;
+void oric_show_msg(oric_t* sys, const char* msg) {
+  CHIPS_ASSERT(sys && sys->valid);
+  if (!msg || *msg == '\0') {
+    return;
+  }
+  char* text = sys->osd.msg_text;
+  const size_t size = sizeof(sys->osd.msg_text);
+  if (sys->osd.msg.active && (strncmp(text, msg, size - 1) == 0)) {
+    return;
+  }
+  strncpy(text, msg, size - 1);
+  text[size - 1] = '\0';
+  _oric_osd_show(sys, &sys->osd.msg, text,
+                 (ORIC_SCREEN_HEIGHT - _ORIC_OSD_ROW_LINES) / 2, true);
+}
 
-        if (pattr & PATTR_HIRES) {
-          base = (lattr & LATTR_ALT) ? (ram + 0x9C00) : (ram + 0x9800);
-        } else {
-          base = (lattr & LATTR_ALT) ? (ram + 0xB800) : (ram + 0xB400);
-        }
-        pat = base[((ch & 0x7F) << 3) | off];
-      }
+void oric_hide_msg(oric_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  _oric_osd_hide(sys, &sys->osd.msg);
+}
 
-      if (!(ch & 0x60)) {
-        pat = 0x00;
-        switch (ch & 0x18) {
-          case 0x00:
-            fgcol = ch & 7;
-            break;
-          case 0x08:
-            lattr = ch & 7;
-            break;
-          case 0x10:
-            bgcol = ch & 7;
-            break;
-          case 0x18:
-            pattr = ch & 7;
-            break;
-        }
-      }
+void oric_show_hud(oric_t* sys, const char* text) {
+  CHIPS_ASSERT(sys && sys->valid && text);
+  _oric_osd_show(sys, &sys->osd.hud, text, 0, false);
+}
 
-      uint8_t c_fg = fgcol;
-      uint8_t c_bg = bgcol;
+void oric_hide_hud(oric_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  _oric_osd_hide(sys, &sys->osd.hud);
+}
 
-      if (ch & 0x80) {  // inverse
-        c_bg ^= 0x07;
-        c_fg ^= 0x07;
-      }
-      if ((lattr & LATTR_BLINK) && blink_state) {
-        c_fg = c_bg;
-      }
+int __not_in_flash_func(oric_screen_update)(oric_t* sys) {
+  // Blinking runs on the frame count, also on a static screen
+  bool blink_state = (sys->blink_counter & 0x20) != 0;
+  sys->blink_counter = (sys->blink_counter + 1) & 0x3F;
 
-      const uint8_t* bits = oric_pat_lut[pat & 0x3F];
-      uint16_t* dst16 = &line_buff[x * 3];
-      dst16[0] =
-          (uint16_t)((bits[0] ? c_fg : c_bg) | ((bits[1] ? c_fg : c_bg) << 8));
-      dst16[1] =
-          (uint16_t)((bits[2] ? c_fg : c_bg) | ((bits[3] ? c_fg : c_bg) << 8));
-      dst16[2] =
-          (uint16_t)((bits[4] ? c_fg : c_bg) | ((bits[5] ? c_fg : c_bg) << 8));
-    }
-
-    for (int word = 0; word < 15; word++) {
-      uint16_t p0 = 0;
-      uint16_t p1 = 0;
-      uint16_t p2 = 0;
-      uint16_t bit = 0x8000;
-      uint16_t* p = dst_line + (word * ATARI_ST_BITCOLORS_PER_PIXEL);
-      int base_word = word * 8;
-
-      for (int i = 0; i < 8; i++) {
-        uint16_t packed = line_buff[base_word + i];
-        uint8_t c0 = packed & 0x0F;
-        uint8_t c1 = (packed >> 8) & 0x0F;
-
-        if (c0 & 0x01) p0 |= bit;
-        if (c0 & 0x02) p1 |= bit;
-        if (c0 & 0x04) p2 |= bit;
-        bit >>= 1;
-
-        if (c1 & 0x01) p0 |= bit;
-        if (c1 & 0x02) p1 |= bit;
-        if (c1 & 0x04) p2 |= bit;
-        bit >>= 1;
+  bool dirty = sys->screen_dirty;
+  if (!dirty) {
+    if (blink_state == sys->blink_rendered) {
+      return 0;
+    }
+    // Only the blink phase has changed, redraw the lines that blink
+    bool any = false;
+    for (int i = 0; i < (int)(sizeof(sys->blink_lines) / 4); i++) {
+      for (uint32_t m = sys->blink_lines[i]; m; m &= m - 1) {
+        const int y = i * 32 + __builtin_ctz(m);
+        bool blinks;
+        (void)_oric_render_line(sys, y, sys->line_pattr[y], blink_state,
+                                &blinks);
+        _oric_osd_draw(sys, y, y + 1);
+        any = true;
       }
+    }
+    sys->blink_rendered = blink_state;
+    if (any) {
+      _oric_present_frame(sys);
+    }
+    return any ? 1 : 0;
+  }
 
-      p[0] = p0;
-      p[1] = p1;
-      p[2] = p2;
+  memset(sys->blink_lines, 0, sizeof(sys->blink_lines));
+  uint8_t pattr = sys->pattr;
+  for (int y = 0; y < 224; y++) {
+    bool blinks;
+    sys->line_pattr[y] = pattr;
+    pattr = _oric_render_line(sys, y, pattr, blink_state, &blinks);
+    if (blinks) {
+      sys->blink_lines[y >> 5] |= 1u << (y & 31);
     }
   }
   sys->pattr = pattr;
+  sys->blink_rendered = blink_state;
+  _oric_osd_draw(sys, 0, 224);
 
-  sys->fb_toggle ^= 1u;
-  uint8_t* fb_base = (uint8_t*)&__rom_in_ram_start__;
-  uint32_t* fb_toggle_fb = (uint32_t*)(fb_base + 0x0FFC);
-  *fb_toggle_fb = sys->fb_toggle ? 0xFFFFFFFF : 0x0;
+  _oric_present_frame(sys);
 
   sys->screen_dirty = false;
   return 1;
 }
 
+int __not_in_flash_func(oric_screen_race)(oric_t* sys) {
+  const uint32_t pos = sys->beam.pos;
+  const uint32_t frame = pos >> 9;
+  int line = (int)(pos & 0x1FF);
+  int done = 0;
+
+  if (frame != sys->beam.render_frame) {
+    // The beam has left the frame, finish it if core 1 fell behind
+    if (sys->beam.render_line < 224) {
+      for (int y = sys->beam.render_line; y < 224; y++) {
+        bool blinks;
+        sys->beam.pattr = _oric_render_line(sys, y, sys->beam.pattr,
+                                            sys->beam.blink_state, &blinks);
+      }
+      _oric_osd_draw(sys, sys->beam.render_line, 224);
+      _oric_present_frame(sys);
+      done = 1;
+    }
+    sys->pattr = sys->beam.pattr;
+    sys->beam.render_frame = frame;
+    sys->beam.render_line = 0;
+    sys->beam.blink_state = (sys->blink_counter & 0x20) != 0;
+    sys->blink_counter = (sys->blink_counter + 1) & 0x3F;
+  }
+
+  if (line > 224) {
+    line = 224;
+  }
+  if (sys->beam.render_line >= line) {
+    return done;
+  }
+  for (int y = sys->beam.render_line; y < line; y++) {
+    bool blinks;
+    sys->beam.pattr = _oric_render_line(sys, y, sys->beam.pattr,
+                                        sys->beam.blink_state, &blinks);
+  }
+  _oric_osd_draw(sys, sys->beam.render_line, line);
+  sys->beam.render_line = line;
+  if (line == 224) {
+    _oric_present_frame(sys);
+    sys->screen_dirty = false;
+    done = 1;
+  }
+  return done;
+}
+
+uint32_t oric_idle_end_frame(oric_t* sys) {
+  CHIPS_ASSERT(sys && sys->valid);
+  const uint32_t skipped = sys->idle.frame_skipped;
+  sys->idle.last_frame_skipped = skipped;
+  sys->idle.total_skipped += skipped;
+  sys->idle.frame_skipped = 0;
+  // Give rejected loops another chance, their state may have changed
+  sys->idle.reject_pc = 0;
+  return skipped;
+}
+
+bool oric_insert_tape(oric_t* sys, int index) {
+  CHIPS_ASSERT(sys && sys->valid && sys->td.valid);
+  if (!oric_td_insert_tape_sdcard(&sys->td, index)) {
+    return false;
+  }
+  // Start playing right away if the motor is already running
+  if (oric_td_is_motor_on(&sys->td)) {
+    sched_set(&sys->sched, ORIC_EVENT_TAPE, sys->system_ticks);
+  }
+  return true;
+}
+
+bool oric_seek_tape(oric_t* sys, int block) {
+  CHIPS_ASSERT(sys && sys->valid && sys->td.valid);
+  if (!oric_td_seek_block(&sys->td, block)) {
+    return false;
+  }
+  // Restart a tape that has played to its end
+  if (oric_td_is_motor_on(&sys->td) &&
+      !sched_pending(&sys->sched, ORIC_EVENT_TAPE)) {
+    sched_set(&sys->sched, ORIC_EVENT_TAPE, sys->system_ticks);
+  }
+  return true;
+}
+
 uint32_t oric_exec(oric_t* sys, uint32_t micro_seconds) {
   CHIPS_ASSERT(sys && sys->valid);
   uint32_t num_ticks = clk_us_to_ticks(ORIC_FREQUENCY, micro_seconds);
+  // oric_tick() may advance several cycles when the ROM fast path runs
+  const uint32_t end_ticks = sys->system_ticks + num_ticks;
   if (0 == sys->debug.callback.func) {
     // run without debug callback
-    for (uint32_t ticks = 0; ticks < num_ticks; ticks++) {
-      oric_tick(sys);
-    }
+    oric_run(sys, end_ticks);
   } else {
     // run with debug callback
-    for (uint32_t ticks = 0; (ticks < num_ticks) && !(*sys->debug.stopped);
-         ticks++) {
+    while (((int32_t)(sys->system_ticks - end_ticks) < 0) &&
+           !(*sys->debug.stopped)) {
       oric_tick(sys);
       sys->debug.callback.func(sys->debug.callback.user_data, 0);
     }
   }
-  kbd_update(&sys->kbd, micro_seconds);
+  oric_kbd_update(&sys->kbd);
   oric_screen_update(sys);
   return num_ticks;
 }
@@ -856,72 +1659,39 @@ static void _oric_init_memorymap(oric_t* sys) {
   // mem_map_rw(&sys->mem, 0, 0xC000, 0x4000, sys->rom, sys->overlay_ram);
   mem_map_rom(&sys->mem, 0, 0xC000, 0x4000, sys->rom);
   // SAFEGUARD END
+  sys->basic_rom_size = ORIC_ROM_SIZE;
 }
 
-static void _oric_init_key_map(oric_t* sys) {
-  kbd_init(&sys->kbd, 2);
-  const char* keymap =
-      // no shift
-      //   01234567 (col)
-      "7N5V 1X3"   // row 0
-      "JTRF  QD"   // row 1
-      "M6B4 Z2C"   // row 2
-      "K9;-  \\'"  // row 3
-      " <>     "   // row 4
-      "UIOP  ]["   // row 5
-      "YHGE ASW"   // row 6
-      "8L0/   ="   // row 7
-
-      /* shift */
-      "&n%v !x#"
-      "jtrf  qd"
-      "m^b$ z@c"
-      "k(:_  |\""
-      " ,.     "
-      "uiop  }{"
-      "yhge asw"
-      "*l)?   +";
-
-  CHIPS_ASSERT(strlen(keymap) == 128);
-  // shift is column 4, line 4
-  kbd_register_modifier(&sys->kbd, 0, 4, 4);
-  // ctrl is column 4, line 2
-  kbd_register_modifier(&sys->kbd, 1, 4, 2);
-  for (int shift = 0; shift < 2; shift++) {
-    for (int column = 0; column < 8; column++) {
-      for (int line = 0; line < 8; line++) {
-        int c = keymap[shift * 64 + line * 8 + column];
-        if (c != 0x20) {
-          kbd_register_key(&sys->kbd, c, column, line, shift ? (1 << 0) : 0);
-        }
-      }
+// Map BASIC ROM, Microdisc EPROM and overlay RAM at $C000-$FFFF as selected
+// by the Microdisc control register
+static void _oric_update_rom_paging(oric_t* sys) {
+  const bool rom = microdisc_rom_enabled(&sys->md);
+  const bool eprom = microdisc_eprom_enabled(&sys->md);
+  uint8_t* overlay = sys->md.overlay_ram;
+  if (rom) {
+    mem_map_rom(&sys->mem, 0, 0xC000, 0x4000, sys->rom);
+  } else {
+    mem_map_ram(&sys->mem, 0, 0xC000, 0x4000, overlay);
+  }
+  if (eprom) {
+    // Reads come from the EPROM, writes go to the RAM below it
+    if (rom) {
+      mem_map_rom(&sys->mem, 0, 0xE000, 0x2000, sys->md.eprom);
+    } else {
+      mem_map_rw(&sys->mem, 0, 0xE000, 0x2000, sys->md.eprom,
+                 overlay + 0x2000);
     }
   }
 
-  // Special keys
-  kbd_register_key(&sys->kbd, 0x20, 0, 4, 0);   // Space
-  kbd_register_key(&sys->kbd, 0x150, 5, 4, 0);  // Left
-  kbd_register_key(&sys->kbd, 0x14F, 7, 4, 0);  // Right
-  kbd_register_key(&sys->kbd, 0x151, 6, 4, 0);  // Down
-  kbd_register_key(&sys->kbd, 0x152, 3, 4, 0);  // Up
-  kbd_register_key(&sys->kbd, 0x08, 5, 5, 0);   // Delete
-  kbd_register_key(&sys->kbd, 0x0D, 5, 7, 0);   // Return
-  kbd_register_key(&sys->kbd, ORIC_KEY_CTRL, 4, 2, 0);  // Ctrl
-  kbd_register_key(&sys->kbd, ORIC_KEY_SHIFT, 4, 4, 0);  // Shift
-
-  kbd_register_key(&sys->kbd, 0x14, 1, 1, 2);  // Ctrl+T
-  kbd_register_key(&sys->kbd, 0x10, 3, 5, 2);  // Ctrl+P
-  kbd_register_key(&sys->kbd, 0x06, 3, 1, 2);  // Ctrl+F
-  kbd_register_key(&sys->kbd, 0x04, 7, 1, 2);  // Ctrl+D
-  kbd_register_key(&sys->kbd, 0x11, 6, 1, 2);  // Ctrl+Q
-  kbd_register_key(&sys->kbd, 0x13, 6, 6, 2);  // Ctrl+S
-  kbd_register_key(&sys->kbd, 0x0C, 1, 7, 2);  // Ctrl+L
-  kbd_register_key(&sys->kbd, 0x0E, 1, 0, 2);  // Ctrl+N
+  // The EPROM hides the top half of the BASIC ROM
+  sys->basic_rom_size = rom ? (eprom ? 0x2000 : ORIC_ROM_SIZE) : 0;
+  // A rejected loop may be other code now
+  sys->idle.reject_pc = 0;
 }
 
 void oric_key_up(oric_t* sys, int key_code) {
   CHIPS_ASSERT(sys && sys->valid);
-  kbd_key_up(&sys->kbd, key_code);
+  oric_kbd_key_up(&sys->kbd, key_code);
 }
 
 uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst) {
@@ -933,7 +1703,11 @@ uint32_t oric_save_snapshot(oric_t* sys, oric_t* dst) {
   ay38910psg_snapshot_onsave(&dst->psg);
   oric_td_snapshot_onsave(&dst->td);
   disk2_fdc_snapshot_onsave(&dst->fdc);
+  microdisc_snapshot_onsave(&dst->md);
   mem_snapshot_onsave(&dst->mem, sys);
+#ifdef ORIC_PROFILE
+  dst->prof = 0;
+#endif
   return ORIC_SNAPSHOT_VERSION;
 }
 
@@ -951,7 +1725,11 @@ bool oric_load_snapshot(oric_t* sys, uint32_t version, oric_t* src) {
   ay38910psg_snapshot_onload(&im.psg, &sys->psg);
   oric_td_snapshot_onload(&im.td, &sys->td);
   disk2_fdc_snapshot_onload(&im.fdc, &sys->fdc);
+  microdisc_snapshot_onload(&im.md, &sys->md);
   mem_snapshot_onload(&im.mem, sys);
+#ifdef ORIC_PROFILE
+  im.prof = sys->prof;
+#endif
   *sys = im;
   return true;
 }
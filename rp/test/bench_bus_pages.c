@@ -0,0 +1,166 @@
+// bench_bus_pages.c
+//
+// Host time per bus access of the range checks in _oric_mem_rw() against a
+// 256-entry page table decoder, which oric.h tried and dropped. The bus
+// accesses are recorded from a made-up ROM running a copy loop into RAM and
+// the text screen with a VIA timer interrupt, then replayed through both
+// decoders.
+//
+//   ./bench_bus_pages [frames]
+
+#include "oric_host.h"
+
+static oric_t sys;
+
+// Copy loop at $C000 into RAM and the screen, with a T1 interrupt every 10 ms
+static const uint8_t _loop_rom[] = {
+    0xA9, 0x40, 0x8D, 0x0B, 0x03,  // LDA #$40 STA ACR: T1 free run
+    0xA9, 0x10, 0x8D, 0x04, 0x03,  // LDA #$10 STA T1L
+    0xA9, 0x27, 0x8D, 0x05, 0x03,  // LDA #$27 STA T1H
+    0xA9, 0xC0, 0x8D, 0x0E, 0x03,  // LDA #$C0 STA IER
+    0x58,                          // CLI
+    0xA2, 0x00,                    // loop: LDX #0
+    0xBD, 0x00, 0x02,              // copy: LDA $0200,X
+    0x9D, 0x00, 0x04,              // STA $0400,X
+    0x9D, 0x80, 0xBB,              // STA $BB80,X
+    0xE8,                          // INX
+    0xD0, 0xF4,                    // BNE copy
+    0xE6, 0x10,                    // INC $10
+    0x4C, 0x15, 0xC0,              // JMP loop
+};
+
+static void _make_loop_rom(void) {
+  memset(oric_rom, 0xEA, sizeof(oric_rom));
+  memcpy(oric_rom, _loop_rom, sizeof(_loop_rom));
+  // IRQ handler at $C100: LDA T1L to acknowledge, RTI
+  const uint8_t irq[] = {0xAD, 0x04, 0x03, 0x40};
+  memcpy(&oric_rom[0x100], irq, sizeof(irq));
+  oric_rom[0x3FFC] = 0x00;
+  oric_rom[0x3FFD] = 0xC0;
+  oric_rom[0x3FFE] = 0x00;
+  oric_rom[0x3FFF] = 0xC1;
+}
+
+// The page table decoder: RAM and ROM through the page pointers, video
+// pages mark the screen dirty, the I/O page goes to _oric_io_rw()
+typedef enum { _DIRECT, _VIDEO, _IO } _page_kind_t;
+
+typedef struct {
+  const uint8_t* read_ptr;
+  uint8_t* write_ptr;
+  uint8_t kind;
+} _page_t;
+
+static _page_t pages[256];
+
+static void _build_pages(oric_t* sys) {
+  for (int page = 0; page < 256; page++) {
+    const uint16_t addr = (uint16_t)(page << 8);
+    const mem_page_t* mp = &sys->mem.page_table[addr >> MEM_PAGE_SHIFT];
+    _page_t* p = &pages[page];
+    p->read_ptr = mp->read_ptr + (addr & MEM_PAGE_MASK);
+    p->write_ptr = mp->write_ptr + (addr & MEM_PAGE_MASK);
+    if (page == 0x03) {
+      p->kind = _IO;
+    } else if ((page >= 0x98) && (page <= 0xBF)) {
+      p->kind = _VIDEO;
+    } else {
+      p->kind = _DIRECT;
+    }
+  }
+}
+
+static void _pages_mem_rw(oric_t* sys, uint16_t addr, bool rw) {
+  const _page_t* page = &pages[addr >> 8];
+  if (page->kind == _DIRECT) {
+    if (rw) {
+      MOS6502CPU_SET_DATA(&sys->cpu, page->read_ptr[addr & 0xFF]);
+    } else {
+      page->write_ptr[addr & 0xFF] = MOS6502CPU_GET_DATA(&sys->cpu);
+    }
+  } else if (page->kind == _VIDEO) {
+    if (rw) {
+      MOS6502CPU_SET_DATA(&sys->cpu, page->read_ptr[addr & 0xFF]);
+    } else {
+      page->write_ptr[addr & 0xFF] = MOS6502CPU_GET_DATA(&sys->cpu);
+      if (addr < 0xBFE0) {
+        sys->screen_dirty = true;
+      }
+    }
+  } else {
+    _oric_io_rw(sys, addr, rw);
+  }
+}
+
+// One recorded bus cycle, bit 16 set for reads, data in bits 17-24
+static uint32_t* trace;
+static uint32_t trace_len;
+
+static void _record(uint32_t frames) {
+  oric_desc_t desc = {0};
+  oric_host_init(&sys, &desc);
+  trace_len = frames * ORIC_HOST_FRAME_CYCLES;
+  trace = malloc(trace_len * sizeof(uint32_t));
+  for (uint32_t i = 0; i < trace_len; i++) {
+    oric_tick(&sys);
+    // The tick leaves the address and data of its bus cycle on the pins
+    trace[i] = sys.cpu.addr | (sys.cpu.rw ? 1u << 16 : 0) |
+               ((uint32_t)MOS6502CPU_GET_DATA(&sys.cpu) << 17);
+  }
+}
+
+// ns per bus access of a replay through one decoder
+static double _replay(void (*mem_rw)(oric_t*, uint16_t, bool)) {
+  uint32_t sum = 0;
+  const uint64_t start = host_now_ns();
+  for (uint32_t i = 0; i < trace_len; i++) {
+    const uint32_t t = trace[i];
+    const bool rw = (t >> 16) & 1;
+    if (!rw) {
+      MOS6502CPU_SET_DATA(&sys.cpu, (uint8_t)(t >> 17));
+    }
+    mem_rw(&sys, (uint16_t)t, rw);
+    sum += MOS6502CPU_GET_DATA(&sys.cpu);
+  }
+  const uint64_t ns = host_now_ns() - start;
+  // Keep the reads from being optimized out
+  sys.cpu.A = (uint8_t)sum;
+  return (double)ns / trace_len;
+}
+
+static void _range_mem_rw(oric_t* sys, uint16_t addr, bool rw) {
+  _oric_mem_rw(sys, addr, rw);
+}
+
+int main(int argc, char** argv) {
+  const uint32_t frames = (argc > 1) ? (uint32_t)atoi(argv[1]) : 200;
+  _make_loop_rom();
+  _record(frames);
+  _build_pages(&sys);
+  uint32_t reads = 0;
+  uint32_t io = 0;
+  uint32_t video = 0;
+  for (uint32_t i = 0; i < trace_len; i++) {
+    const uint16_t addr = (uint16_t)trace[i];
+    reads += (trace[i] >> 16) & 1;
+    io += (addr >> 8) == 0x03;
+    video += (addr >= 0x9800) && (addr < 0xC000);
+  }
+  printf("%u bus cycles: %.1f%% reads, %.2f%% I/O, %.1f%% video\n",
+         trace_len, reads * 100.0 / trace_len, io * 100.0 / trace_len,
+         video * 100.0 / trace_len);
+  // Alternate the two and keep the best of each, the host is noisy
+  double range = 1e9;
+  double table = 1e9;
+  for (int round = 0; round < 9; round++) {
+    const double t_range = _replay(_range_mem_rw);
+    const double t_table = _replay(_pages_mem_rw);
+    range = (t_range < range) ? t_range : range;
+    table = (t_table < table) ? t_table : table;
+  }
+  printf("  range checks:  %6.2f ns/access\n", range);
+  printf("  page table:    %6.2f ns/access (%+.1f%%)\n", table,
+         (table - range) * 100.0 / range);
+  free(trace);
+  return 0;
+}
@@ -0,0 +1,77 @@
+// bench_disk2_nib.c
+//
+// Host time to nibble a .dsk track when it is loaded and to decode it back
+// into sectors when it is stored, against the plain read and write of a
+// .nib track. The card is the in-memory FatFs stand-in and the f_sync() is
+// left out, so the numbers are the CPU cost of the conversion and not the
+// SD card transfer.
+//
+//   ./bench_disk2_nib [rounds]
+
+#define CHIPS_IMPL
+#include "devices/disk2_fdd.h"
+
+#include <string.h>
+
+#include "host.h"
+
+static disk2_fdd_t fdd;
+
+static void insert(const char* file, size_t size, int index) {
+  static uint8_t image[DISK2_FDD_NIB_IMAGE_SIZE];
+  for (size_t i = 0; i < size; i++) {
+    image[i] = (uint8_t)(0x96 + (i * 7919) % 0x6A);
+  }
+  char path[512];
+  snprintf(path, sizeof(path), "%s/oric/%s", host_card_dir("disk2_bench"),
+           file);
+  host_write_file(path, image, size);
+  memset(&fdd, 0, sizeof(fdd));
+  disk2_fdd_init(&fdd);
+  disk2_fdd_insert_disk_sdcard(&fdd, index);
+}
+
+// Store the buffer of slot 0 in the image like _disk2_fdd_write_track(),
+// without the f_sync() that the stand-in turns into a whole host file write
+static void store_track(void) {
+  if (fdd.dsk_image) {
+    _disk2_fdd_decode_track(&fdd, 0);
+    return;
+  }
+  UINT bytes_written = 0;
+  f_lseek(&fdd.nib_file,
+          (FSIZE_t)fdd.slot_track[0] * DISK2_FDD_BYTES_PER_NIB_TRACK);
+  f_write(&fdd.nib_file, _disk2_fdd_tracks[0], DISK2_FDD_BYTES_PER_NIB_TRACK,
+          &bytes_written);
+}
+
+// us per track to load every track, then to store it back
+static void run(const char* name, uint32_t rounds) {
+  uint64_t load_ns = 0;
+  uint64_t store_ns = 0;
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (uint8_t t = 0; t < DISK2_FDD_TRACKS_PER_DISK; t++) {
+      uint64_t start = host_now_ns();
+      _disk2_fdd_load_track(&fdd, 0, t);
+      load_ns += host_now_ns() - start;
+      start = host_now_ns();
+      store_track();
+      store_ns += host_now_ns() - start;
+    }
+  }
+  const double tracks = (double)rounds * DISK2_FDD_TRACKS_PER_DISK;
+  printf("  %s: load %6.2f us/track, store %6.2f us/track\n", name,
+         load_ns / tracks / 1000.0, store_ns / tracks / 1000.0);
+}
+
+int main(int argc, char** argv) {
+  const uint32_t rounds = (argc > 1) ? (uint32_t)atoi(argv[1]) : 50;
+  printf("%u rounds of %d tracks\n", rounds, DISK2_FDD_TRACKS_PER_DISK);
+  insert("d1.nib", DISK2_FDD_NIB_IMAGE_SIZE, 0);
+  run(".nib", rounds);
+  disk2_fdd_remove_disk(&fdd);
+  insert("d2.dsk", DISK2_FDD_DSK_IMAGE_SIZE, 1);
+  run(".dsk", rounds);
+  disk2_fdd_remove_disk(&fdd);
+  return 0;
+}
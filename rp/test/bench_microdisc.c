@@ -0,0 +1,161 @@
+// bench_microdisc.c
+//
+// Sector reads of the Microdisc on a made-up MFM_DISK image, every sector
+// of every track in order with a seek between tracks. For the READ SECTOR
+// commands: the emulated cycles from the command to the end of the
+// transfer, per sector and per byte, and the host time of ticking the
+// WD1793 and serving DRQ, per byte. For the card: the host time of the
+// microdisc_update() calls that load a track between frames. The card is
+// the in-memory FatFs stand-in, so that is the CPU cost of the load and the
+// ID field index, not the SD card transfer.
+//
+//   ./bench_microdisc [rounds]
+
+#define CHIPS_IMPL
+#include "devices/microdisc.h"
+
+#include <string.h>
+
+#include "host.h"
+
+#define TRACKS (40)
+#define SECTORS (17)
+#define FRAME_CYCLES (19968)
+
+static uint8_t eprom[MICRODISC_EPROM_SIZE];
+static uint8_t overlay_ram[MICRODISC_OVERLAY_RAM_SIZE];
+static uint8_t track_data[MICRODISC_TRACK_SIZE];
+static microdisc_t md;
+
+// One sided image, 17 sectors of 256 bytes per track, like test_microdisc
+static void make_image(const char* path) {
+  const size_t size = 256 + (size_t)TRACKS * MICRODISC_TRACK_SIZE;
+  uint8_t* image = calloc(1, size);
+  memcpy(image, "MFM_DISK", 8);
+  image[8] = 1;
+  image[12] = TRACKS;
+  image[16] = 1;
+  for (int t = 0; t < TRACKS; t++) {
+    uint8_t* p = &image[256 + t * MICRODISC_TRACK_SIZE];
+    int pos = 40;
+    for (int s = 1; s <= SECTORS; s++) {
+      memset(&p[pos], 0xA1, 3);
+      pos += 3;
+      p[pos++] = 0xFE;
+      p[pos++] = (uint8_t)t;
+      p[pos++] = 0;
+      p[pos++] = (uint8_t)s;
+      p[pos++] = 1;
+      pos += 2;  // CRC
+      memset(&p[pos], 0x4E, 22);
+      pos += 22;
+      memset(&p[pos], 0xA1, 3);
+      pos += 3;
+      p[pos++] = 0xFB;
+      for (int i = 0; i < 256; i++) {
+        p[pos++] = (uint8_t)(t * 31 + s * 7 + i);
+      }
+      pos += 2;  // CRC
+      memset(&p[pos], 0x4E, 24);
+      pos += 24;
+    }
+  }
+  host_write_file(path, image, size);
+  free(image);
+}
+
+// Totals of a run
+typedef struct {
+  uint64_t tick_ns;    // Ticking the WD1793 and serving DRQ
+  uint64_t update_ns;  // microdisc_update() calls that loaded a track
+  uint64_t cycles;     // Emulated cycles of the READ SECTOR commands
+  uint32_t sectors;
+  uint32_t bytes;
+  uint32_t loads;
+  uint32_t min_cycles;
+  uint32_t max_cycles;
+} _stats_t;
+
+static uint32_t frame_pos;
+
+// Tick 4 cycles, with an update at every frame boundary like the main loop
+static void tick(_stats_t* st) {
+  microdisc_tick(&md, 4);
+  frame_pos += 4;
+  if (frame_pos >= FRAME_CYCLES) {
+    frame_pos -= FRAME_CYCLES;
+    const uint32_t loads = md.track_loads;
+    const uint64_t start = host_now_ns();
+    microdisc_update(&md);
+    if (md.track_loads != loads) {
+      st->update_ns += host_now_ns() - start;
+      st->loads++;
+    }
+  }
+}
+
+static void seek(_stats_t* st, int track) {
+  microdisc_write(&md, 3, (uint8_t)track);
+  microdisc_write(&md, 0, 0x14);  // SEEK with verify
+  while (wd1793fdc_busy(&md.fdc)) {
+    tick(st);
+  }
+}
+
+static void read_sector(_stats_t* st, int sector) {
+  microdisc_write(&md, 2, (uint8_t)sector);
+  microdisc_write(&md, 0, 0x80);
+  uint32_t cycles = 0;
+  uint32_t n = 0;
+  const uint64_t start = host_now_ns();
+  while (wd1793fdc_busy(&md.fdc)) {
+    tick(st);
+    cycles += 4;
+    if (md.fdc.drq) {
+      microdisc_read(&md, 3);
+      n++;
+    }
+  }
+  st->tick_ns += host_now_ns() - start;
+  st->cycles += cycles;
+  st->sectors++;
+  st->bytes += n;
+  st->min_cycles = (cycles < st->min_cycles) ? cycles : st->min_cycles;
+  st->max_cycles = (cycles > st->max_cycles) ? cycles : st->max_cycles;
+}
+
+int main(int argc, char** argv) {
+  const uint32_t rounds = (argc > 1) ? (uint32_t)atoi(argv[1]) : 20;
+  char path[512];
+  snprintf(path, sizeof(path), "%s/oric/m1.dsk",
+           host_card_dir("microdisc_bench"));
+  make_image(path);
+  microdisc_init(&md, eprom, overlay_ram, track_data);
+  if (!microdisc_insert_disk_sdcard(&md, 0, 0)) {
+    fprintf(stderr, "insert failed\n");
+    return EXIT_FAILURE;
+  }
+  microdisc_write(&md, 4, MICRODISC_CTRL_ROMDIS);  // Drive 0, side 0
+
+  _stats_t st = {.min_cycles = UINT32_MAX};
+  for (uint32_t r = 0; r < rounds; r++) {
+    for (int t = 0; t < TRACKS; t++) {
+      seek(&st, t);
+      for (int s = 1; s <= SECTORS; s++) {
+        read_sector(&st, s);
+      }
+    }
+  }
+  printf("%u rounds, %u sectors of 256 bytes\n", rounds, st.sectors);
+  printf("  READ SECTOR: %.0f cycles/sector (%u..%u), %.1f cycles/byte, "
+         "%.1f KB/s emulated\n",
+         (double)st.cycles / st.sectors, st.min_cycles, st.max_cycles,
+         (double)st.cycles / st.bytes,
+         st.bytes / 1024.0 / (st.cycles / 1e6));
+  printf("  host: %.2f ns/byte ticking the WD1793, %.1f us/track load "
+         "(%u loads)\n",
+         (double)st.tick_ns / st.bytes, st.update_ns / 1000.0 / st.loads,
+         st.loads);
+  HOST_CHECK(st.bytes == st.sectors * 256u);
+  return HOST_RESULT();
+}
@@ -0,0 +1,237 @@
+// bench_oric_render.c
+//
+// Host time of the screen renderer of oric.h against the renderer it
+// replaced, which is copied here: every cell went through the attribute
+// switch and the pattern LUT into a line of color bytes, and each line was
+// then converted to bitplanes pixel by pixel. For text screens, the time of
+// a whole frame. For HIRES screens, the time per HIRES line, plain pixel
+// bytes and with a share of attribute and inverse bytes. Both renderers
+// must draw the same frames.
+//
+//   ./bench_oric_render [rounds]
+
+#include "oric_host.h"
+
+static oric_t sys;
+
+// The baseline renderer: color byte pairs of a line, the pattern LUT
+static uint16_t line_buff[120];
+static uint8_t pat_lut[64][6];
+
+static void _baseline_init(void) {
+  for (int pat = 0; pat < 64; pat++) {
+    for (int bit = 0; bit < 6; bit++) {
+      pat_lut[pat][bit] = (pat & (0x20 >> bit)) ? 1 : 0;
+    }
+  }
+}
+
+// Render screen line y, returns the video attributes for the next line
+static uint8_t _baseline_line(oric_t* s, int y, uint8_t pattr, bool blink) {
+  const uint8_t* restrict ram = s->ram;
+  uint16_t* restrict dst_line =
+      s->fb + (y * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS);
+  uint8_t lattr = 0;
+  uint8_t fgcol = 7;
+  uint8_t bgcol = 0;
+
+  for (int x = 0; x < 40; x++) {
+    uint8_t ch, pat;
+
+    if ((pattr & PATTR_HIRES) && y < 200) {
+      ch = pat = ram[0xA000 + y * 40 + x];
+    } else {
+      ch = ram[0xBB80 + (y >> 3) * 40 + x];
+      int off = (lattr & LATTR_DSIZE ? y >> 1 : y) & 7;
+      const uint8_t* base;
+
+      if (pattr & PATTR_HIRES) {
+        base = (lattr & LATTR_ALT) ? (ram + 0x9C00) : (ram + 0x9800);
+      } else {
+        base = (lattr & LATTR_ALT) ? (ram + 0xB800) : (ram + 0xB400);
+      }
+      pat = base[((ch & 0x7F) << 3) | off];
+    }
+
+    if (!(ch & 0x60)) {
+      pat = 0x00;
+      switch (ch & 0x18) {
+        case 0x00:
+          fgcol = ch & 7;
+          break;
+        case 0x08:
+          lattr = ch & 7;
+          break;
+        case 0x10:
+          bgcol = ch & 7;
+          break;
+        case 0x18:
+          pattr = ch & 7;
+          break;
+      }
+    }
+
+    uint8_t c_fg = fgcol;
+    uint8_t c_bg = bgcol;
+
+    if (ch & 0x80) {  // inverse
+      c_bg ^= 0x07;
+      c_fg ^= 0x07;
+    }
+    if ((lattr & LATTR_BLINK) && blink) {
+      c_fg = c_bg;
+    }
+
+    const uint8_t* bits = pat_lut[pat & 0x3F];
+    uint16_t* dst16 = &line_buff[x * 3];
+    dst16[0] =
+        (uint16_t)((bits[0] ? c_fg : c_bg) | ((bits[1] ? c_fg : c_bg) << 8));
+    dst16[1] =
+        (uint16_t)((bits[2] ? c_fg : c_bg) | ((bits[3] ? c_fg : c_bg) << 8));
+    dst16[2] =
+        (uint16_t)((bits[4] ? c_fg : c_bg) | ((bits[5] ? c_fg : c_bg) << 8));
+  }
+
+  for (int word = 0; word < 15; word++) {
+    uint16_t p0 = 0;
+    uint16_t p1 = 0;
+    uint16_t p2 = 0;
+    uint16_t bit = 0x8000;
+    uint16_t* p = dst_line + (word * ATARI_ST_BITCOLORS_PER_PIXEL);
+    int base_word = word * 8;
+
+    for (int i = 0; i < 8; i++) {
+      uint16_t packed = line_buff[base_word + i];
+      uint8_t c0 = packed & 0x0F;
+      uint8_t c1 = (packed >> 8) & 0x0F;
+
+      if (c0 & 0x01) p0 |= bit;
+      if (c0 & 0x02) p1 |= bit;
+      if (c0 & 0x04) p2 |= bit;
+      bit >>= 1;
+
+      if (c1 & 0x01) p0 |= bit;
+      if (c1 & 0x02) p1 |= bit;
+      if (c1 & 0x04) p2 |= bit;
+      bit >>= 1;
+    }
+
+    p[0] = p0;
+    p[1] = p1;
+    p[2] = p2;
+  }
+  return pattr;
+}
+
+static uint8_t _current_line(oric_t* s, int y, uint8_t pattr, bool blink) {
+  bool blinks;
+  return _oric_render_line(s, y, pattr, blink, &blinks);
+}
+
+typedef uint8_t (*_line_fn_t)(oric_t*, int, uint8_t, bool);
+
+// Lines 0..lines-1 with the video attributes carried down
+static void _render(_line_fn_t line, int lines, bool blink) {
+  uint8_t pattr = sys.pattr;
+  for (int y = 0; y < lines; y++) {
+    pattr = line(&sys, y, pattr, blink);
+  }
+}
+
+// Printable text, one cell in attrs a color or line attribute, some inverse
+static void make_text(int attrs) {
+  for (int i = 0xBB80; i < 0xBFE0; i++) {
+    sys.ram[i] = (uint8_t)(0x20 + rand() % 96);
+    if (attrs && (rand() % attrs == 0)) {
+      sys.ram[i] = (uint8_t)(rand() & 0x1F);
+    } else if (rand() % 8 == 0) {
+      sys.ram[i] |= 0x80;
+    }
+  }
+}
+
+// HIRES pixels, one byte in attrs an attribute or inverse byte
+static void make_hires(int attrs) {
+  for (int i = 0xA000; i < 0xBF40; i++) {
+    sys.ram[i] = (uint8_t)(0x40 | (rand() & 0x3F));
+    if (attrs && (rand() % attrs == 0)) {
+      sys.ram[i] = (uint8_t)rand();
+    }
+  }
+}
+
+// Both renderers draw the screen in RAM the same, in both blink phases
+static bool same_frames(uint8_t pattr) {
+  static uint16_t frame[ORIC_SCREEN_HEIGHT *
+                        ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS];
+  bool same = true;
+  for (int phase = 0; phase < 2; phase++) {
+    sys.pattr = pattr;
+    _render(_baseline_line, 224, phase);
+    memcpy(frame, sys.fb, sizeof(frame));
+    _render(_current_line, 224, phase);
+    same &= memcmp(frame, sys.fb, sizeof(frame)) == 0;
+  }
+  return same;
+}
+
+// Host ns of lines 0..lines-1 of 200 frames, per frame or per line
+static double _time(_line_fn_t line, uint8_t pattr, int lines,
+                    bool per_line) {
+  sys.pattr = pattr;
+  const uint64_t start = host_now_ns();
+  for (int f = 0; f < 200; f++) {
+    _render(line, lines, false);
+  }
+  const double ns = (double)(host_now_ns() - start) / 200;
+  return per_line ? ns / lines : ns;
+}
+
+// Alternate the two renderers and keep the best of each, the host is noisy.
+// Text is timed as whole frames, HIRES as its 200 lines.
+static void bench(const char* name, uint8_t pattr, uint32_t rounds) {
+  const bool hires = (pattr & PATTR_HIRES) != 0;
+  const int lines = hires ? 200 : 224;
+  double baseline = 1e12;
+  double current = 1e12;
+  for (uint32_t round = 0; round < rounds; round++) {
+    const double t_baseline = _time(_baseline_line, pattr, lines, hires);
+    const double t_current = _time(_current_line, pattr, lines, hires);
+    baseline = (t_baseline < baseline) ? t_baseline : baseline;
+    current = (t_current < current) ? t_current : current;
+  }
+  printf("  %-21s baseline %8.1f ns, now %8.1f ns per %s (%.2fx)\n", name,
+         baseline, current, hires ? "line " : "frame", baseline / current);
+}
+
+int main(int argc, char** argv) {
+  const uint32_t rounds = (argc > 1) ? (uint32_t)atoi(argv[1]) : 10;
+  memset(oric_rom, 0xEA, sizeof(oric_rom));
+  oric_desc_t desc = {0};
+  oric_host_init(&sys, &desc);
+  _baseline_init();
+  srand(42);
+
+  // The renderers must agree before any timing means something
+  for (int screen = 0; screen < 50; screen++) {
+    for (size_t i = 0; i < sizeof(sys.ram); i++) {
+      sys.ram[i] = (uint8_t)rand();
+    }
+    make_text(40);
+    HOST_CHECK(same_frames(0));
+    make_hires(9);
+    HOST_CHECK(same_frames(PATTR_HIRES));
+    HOST_CHECK(same_frames((uint8_t)(rand() & 7)));
+  }
+
+  printf("%u rounds\n", rounds);
+  make_text(0);
+  bench("text", 0, rounds);
+  make_text(40);
+  bench("text with attributes", 0, rounds);
+  make_hires(0);
+  bench("HIRES", PATTR_HIRES, rounds);
+  make_hires(9);
+  bench("HIRES with attributes", PATTR_HIRES, rounds);
+  return HOST_RESULT();
+}
@@ -0,0 +1,198 @@
+// bench_sched.c
+//
+// Host time of the device dispatch in oric_tick(). First the bare dispatch
+// with counters for event bodies: the cycle counter divisors it used to test
+// every cycle, with the tape counted down in the VIA tick; every device on
+// sched.h deadlines, the VIA every 4 cycles included; and what oric.h does
+// now, the VIA on its divisor and sched.h for the sparse tape and Disk II
+// events. The tape changes level every 208 cycles, the Disk II timer runs
+// every 128. Then the whole machine skipping cycles for the ROM fast path
+// and the idle loops, through _oric_advance() against ticking the devices
+// cycle by cycle.
+//
+//   ./bench_sched [cycles]
+
+#include "oric_host.h"
+
+static oric_t sys;
+
+// Event bodies, the same for every dispatcher
+static uint32_t via_events;
+static uint32_t tape_events;
+static uint32_t fdc_events;
+
+// Event slots of the dispatchers on sched.h
+enum { _VIA, _TAPE, _FDC };
+
+// The divisors of the old oric_tick()
+static void _divisors(uint32_t cycles) {
+  uint8_t t2 = 0;
+  for (uint32_t ticks = 0; ticks < cycles; ticks++) {
+    if ((ticks & 127) == 0) {
+      fdc_events++;
+    }
+    if ((ticks & 3) == 0) {
+      via_events++;
+      if (++t2 == 52) {
+        t2 = 0;
+        tape_events++;
+      }
+    }
+  }
+}
+
+// Pop and rearm the due events
+static inline void _run_events(sched_t* s, uint32_t ticks) {
+  int event;
+  while ((event = sched_pop(s, ticks)) >= 0) {
+    const uint32_t deadline = s->deadline[event];
+    switch (event) {
+      case _VIA:
+        via_events++;
+        sched_set(s, event, deadline + ORIC_VIA_CYCLES);
+        break;
+      case _TAPE:
+        tape_events++;
+        sched_set(s, event, deadline + 208);
+        break;
+      default:
+        fdc_events++;
+        sched_set(s, event, deadline + ORIC_FDC_CYCLES);
+        break;
+    }
+  }
+}
+
+static void _scheduler(uint32_t cycles) {
+  sched_t s;
+  sched_init(&s, 0);
+  sched_set(&s, _VIA, 0);
+  sched_set(&s, _TAPE, 207);
+  sched_set(&s, _FDC, 0);
+  for (uint32_t ticks = 0; ticks < cycles; ticks++) {
+    if (sched_due(&s, ticks)) {
+      _run_events(&s, ticks);
+    }
+  }
+}
+
+// The VIA on its divisor, the sparse events on sched.h
+static void _hybrid(uint32_t cycles) {
+  sched_t s;
+  sched_init(&s, 0);
+  sched_set(&s, _TAPE, 207);
+  sched_set(&s, _FDC, 0);
+  for (uint32_t ticks = 0; ticks < cycles; ticks++) {
+    if ((ticks & (ORIC_VIA_CYCLES - 1)) == 0) {
+      via_events++;
+    }
+    if (sched_due(&s, ticks)) {
+      _run_events(&s, ticks);
+    }
+  }
+}
+
+// ns per cycle of one dispatcher, and its event counts
+static double _dispatch(void (*run)(uint32_t), uint32_t cycles,
+                        uint32_t* events) {
+  via_events = tape_events = fdc_events = 0;
+  const uint64_t start = host_now_ns();
+  run(cycles);
+  const uint64_t ns = host_now_ns() - start;
+  events[0] = via_events;
+  events[1] = tape_events;
+  events[2] = fdc_events;
+  return (double)ns / cycles;
+}
+
+// Copy loop at $C000 with the T1 interrupt of the ROM every 10 ms
+static const uint8_t _loop_rom[] = {
+    0xA9, 0x40, 0x8D, 0x0B, 0x03,  // LDA #$40 STA ACR: T1 free run
+    0xA9, 0x10, 0x8D, 0x04, 0x03,  // LDA #$10 STA T1L
+    0xA9, 0x27, 0x8D, 0x05, 0x03,  // LDA #$27 STA T1H
+    0xA9, 0xC0, 0x8D, 0x0E, 0x03,  // LDA #$C0 STA IER
+    0x58,                          // CLI
+    0xA2, 0x00,                    // loop: LDX #0
+    0xBD, 0x00, 0x02,              // copy: LDA $0200,X
+    0x9D, 0x00, 0x04,              // STA $0400,X
+    0xE8,                          // INX
+    0xD0, 0xF7,                    // BNE copy
+    0xE6, 0x10,                    // INC $10
+    0x4C, 0x15, 0xC0,              // JMP loop
+};
+
+static void _make_loop_rom(void) {
+  memset(oric_rom, 0xEA, sizeof(oric_rom));
+  memcpy(oric_rom, _loop_rom, sizeof(_loop_rom));
+  // IRQ handler at $C100: LDA T1L to acknowledge, RTI
+  const uint8_t irq[] = {0xAD, 0x04, 0x03, 0x40};
+  memcpy(&oric_rom[0x100], irq, sizeof(irq));
+  oric_rom[0x3FFC] = 0x00;
+  oric_rom[0x3FFD] = 0xC0;
+  oric_rom[0x3FFE] = 0x00;
+  oric_rom[0x3FFF] = 0xC1;
+}
+
+// ns per skipped cycle, in skips of the given length
+static double _skip(bool advance, uint32_t cycles, uint32_t skip) {
+  const uint64_t start = host_now_ns();
+  for (uint32_t done = 0; done < cycles; done += skip) {
+    if (advance) {
+      _oric_advance(&sys, skip);
+    } else {
+      for (uint32_t i = 0; i < skip; i++) {
+        _oric_tick_devices(&sys, ORIC_RUN_ALL);
+      }
+    }
+  }
+  return (double)(host_now_ns() - start) / cycles;
+}
+
+int main(int argc, char** argv) {
+  const uint32_t cycles =
+      (argc > 1) ? (uint32_t)atoi(argv[1]) : 50 * ORIC_HOST_FRAME_CYCLES * 20;
+  printf("%u cycles\n", cycles);
+  // Alternate the three and keep the best of each, the host is noisy
+  static const struct {
+    const char* name;
+    void (*run)(uint32_t);
+  } dispatchers[3] = {
+      {"divisors", _divisors},
+      {"all on sched.h", _scheduler},
+      {"VIA divisor, sched.h", _hybrid},
+  };
+  double best[3] = {1e9, 1e9, 1e9};
+  uint32_t events[3][3];
+  for (int round = 0; round < 5; round++) {
+    for (int d = 0; d < 3; d++) {
+      const double t = _dispatch(dispatchers[d].run, cycles, events[d]);
+      best[d] = (t < best[d]) ? t : best[d];
+    }
+  }
+  for (int d = 0; d < 3; d++) {
+    printf("  dispatch, %-21s %6.3f ns/cycle (%+.1f%%), events: VIA %u, "
+           "tape %u, Disk II %u\n",
+           dispatchers[d].name, best[d], (best[d] - best[0]) * 100.0 / best[0],
+           events[d][0], events[d][1], events[d][2]);
+    HOST_CHECK(memcmp(events[d], events[0], sizeof(events[0])) == 0);
+  }
+
+  _make_loop_rom();
+  oric_desc_t desc = {0};
+  oric_host_init(&sys, &desc);
+  oric_host_run_frames(&sys, 10);
+  for (uint32_t skip = 16; skip <= 4096; skip *= 16) {
+    double ticked = 1e9;
+    double advanced = 1e9;
+    for (int round = 0; round < 5; round++) {
+      const double t_ticked = _skip(false, cycles / 10, skip);
+      const double t_advanced = _skip(true, cycles / 10, skip);
+      ticked = (t_ticked < ticked) ? t_ticked : ticked;
+      advanced = (t_advanced < advanced) ? t_advanced : advanced;
+    }
+    printf("  skip %4u cycles: per cycle %6.3f ns, _oric_advance() %6.3f ns "
+           "(%.1fx)\n",
+           skip, ticked, advanced, ticked / advanced);
+  }
+  return HOST_RESULT();
+}
@@ -0,0 +1,136 @@
+// bench_tape_edg.c
+//
+// Edge list tapes on a corpus of TAP images: for each tape the TAP size, the
+// .edg file the converter writes, the legacy bitstream the same tape would
+// take (4 bytes of length and one bit per 208 cycle unit), the SD card bytes
+// and f_read() calls of playing it to the end with an update every frame,
+// and the conversion time.
+//
+//   ./bench_tape_edg [file.tap...]
+//
+// Without arguments it runs on made-up tapes: BASIC programs, machine code
+// and a tape with several programs.
+
+#define CHIPS_IMPL
+#include "constants.h"
+#include "hardware/structs/timer.h"
+#include "devices/oric_td.h"
+
+#include <string.h>
+
+#include "host.h"
+
+// Cycles of a PAL frame
+#define FRAME_CYCLES (19968)
+
+static oric_td_t td;
+
+// One program as CSAVE writes it, returns the bytes added
+static size_t tap_program(uint8_t* out, bool basic, uint16_t len,
+                          uint32_t seed) {
+  size_t n = 0;
+  for (int i = 0; i < 16; i++) {
+    out[n++] = 0x16;
+  }
+  out[n++] = 0x24;
+  const uint16_t start = basic ? 0x0501 : 0x0600;
+  const uint16_t end = (uint16_t)(start + len - 1);
+  const uint8_t header[9] = {0, 0, basic ? 0x00 : 0x80, 0, end >> 8,
+                             end & 0xFF, start >> 8, start & 0xFF, 0};
+  memcpy(&out[n], header, sizeof(header));
+  n += sizeof(header);
+  n += (size_t)sprintf((char*)&out[n], "PROG%u", (unsigned)seed) + 1;
+  for (uint16_t i = 0; i < len; i++) {
+    seed = seed * 1103515245u + 12345u;
+    // BASIC is mostly printable text and tokens, code anything
+    out[n++] = basic ? (uint8_t)(0x20 + (seed >> 16) % 0x70)
+                     : (uint8_t)(seed >> 16);
+  }
+  return n;
+}
+
+// Convert one tape and play it to the end, adds its numbers to totals
+static void measure(const char* name, const uint8_t* tap, size_t size,
+                    uint64_t* totals) {
+  const char* dir = host_card_dir("tape_edg");
+  char path[512];
+  snprintf(path, sizeof(path), "%s/oric/f1.tap", dir);
+  host_write_file(path, tap, size);
+
+  memset(&td, 0, sizeof(td));
+  oric_td_init(&td);
+  const uint64_t start = host_now_ns();
+  if (!oric_td_insert_tape_sdcard(&td, 0)) {
+    printf("%-16s conversion failed\n", name);
+    return;
+  }
+  const uint64_t convert_ns = host_now_ns() - start;
+  const uint32_t edg_size = td.size;
+
+  const ff_posix_stats_t before = ff_posix_stats;
+  td.port |= ORIC_TD_PORT_MOTOR;
+  uint64_t cycles = 0;
+  uint32_t frame = 0;
+  uint32_t edge;
+  while ((edge = oric_td_next_edge_sdcard(&td)) != 0) {
+    cycles += edge;
+    frame += edge;
+    if (frame >= FRAME_CYCLES) {
+      oric_td_update(&td);
+      frame -= FRAME_CYCLES;
+    }
+  }
+  const uint32_t play_bytes = ff_posix_stats.bytes_read - before.bytes_read;
+  const uint32_t play_reads = ff_posix_stats.reads - before.reads;
+  const uint64_t units = cycles / ORIC_TD_UNIT_CYCLES;
+  const uint32_t legacy_size = (uint32_t)(4 + (units + 7) / 8);
+  oric_td_remove_tape_sdcard(&td);
+
+  printf("%-16s %7zu %7u %8u %7.2f %8u %6u %8.1f\n", name, size, edg_size,
+         legacy_size, (double)legacy_size / edg_size, play_bytes, play_reads,
+         convert_ns / 1000.0);
+  totals[0] += size;
+  totals[1] += edg_size;
+  totals[2] += legacy_size;
+  totals[3] += play_bytes;
+  totals[4] += play_reads;
+  totals[5] += convert_ns;
+}
+
+int main(int argc, char** argv) {
+  uint64_t totals[6] = {0};
+  printf("%-16s %7s %7s %8s %7s %8s %6s %8s\n", "tape", "tap", "edg",
+         "legacy", "ratio", "sd bytes", "reads", "conv us");
+  if (argc > 1) {
+    for (int i = 1; i < argc; i++) {
+      size_t size = 0;
+      uint8_t* tap = host_read_file(argv[i], &size);
+      if (tap == NULL) {
+        fprintf(stderr, "%s: can't read\n", argv[i]);
+        continue;
+      }
+      const char* name = strrchr(argv[i], '/');
+      measure(name ? name + 1 : argv[i], tap, size, totals);
+      free(tap);
+    }
+  } else {
+    static uint8_t tap[65536];
+    measure("basic 1.5k", tap, tap_program(tap, true, 1536, 1), totals);
+    measure("basic 12k", tap, tap_program(tap, true, 12288, 2), totals);
+    measure("code 8k", tap, tap_program(tap, false, 8192, 3), totals);
+    measure("code 36k", tap, tap_program(tap, false, 36864, 4), totals);
+    size_t n = 0;
+    for (uint32_t p = 0; p < 4; p++) {
+      n += tap_program(&tap[n], p == 0, 4096, 10 + p);
+    }
+    measure("4 programs", tap, n, totals);
+  }
+  if (totals[1]) {
+    printf("%-16s %7llu %7llu %8llu %7.2f %8llu %6llu %8.1f\n", "total",
+           (unsigned long long)totals[0], (unsigned long long)totals[1],
+           (unsigned long long)totals[2], (double)totals[2] / totals[1],
+           (unsigned long long)totals[3], (unsigned long long)totals[4],
+           totals[5] / 1000.0);
+  }
+  return 0;
+}
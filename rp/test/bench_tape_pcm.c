@@ -0,0 +1,177 @@
+// bench_tape_pcm.c
+//
+// Host time of the PCM tape decoder against the length of the capture. The
+// captures are made up from the byte cells of a TAP program at 44.1 kHz,
+// 8 bit mono and 16 bit stereo, with noise and a slow drift on top. Every
+// frame the tape is played for a frame of cycles, then oric_td_update() is
+// timed refilling the queue, like the main loop does it.
+//
+//   ./bench_tape_pcm [bytes]
+
+#define CHIPS_IMPL
+#include "constants.h"
+#include "hardware/structs/timer.h"
+#include "devices/oric_td.h"
+
+#include <string.h>
+
+#include "host.h"
+
+#define RATE (44100)
+#define FRAME_CYCLES (19968)
+
+static oric_td_t td;
+static uint8_t* program;
+static size_t program_len;
+
+// A leader, then random program bytes
+static void make_program(size_t len) {
+  program_len = 20 + len;
+  program = malloc(program_len);
+  memset(program, 0x16, 16);
+  program[16] = 0x24;
+  uint32_t seed = 38;
+  for (size_t i = 17; i < program_len; i++) {
+    seed = seed * 1103515245u + 12345u;
+    program[i] = (uint8_t)(seed >> 16);
+  }
+}
+
+// Capture of the program cells, returns the WAV file size
+static size_t make_wav(uint8_t** out, int bits, int channels) {
+  uint64_t cycles = 0;
+  for (size_t i = 0; i < program_len; i++) {
+    for (uint8_t pos = 0; pos < ORIC_TD_CELL_HALF_PERIODS; pos++) {
+      cycles += oric_td_cell_run(program[i], pos) * ORIC_TD_UNIT_CYCLES;
+    }
+  }
+  const uint32_t samples = (uint32_t)(cycles * RATE / 1000000) + RATE / 10;
+  const uint32_t frame = (uint32_t)(channels * bits / 8);
+  const uint32_t data = samples * frame;
+  uint8_t* wav = malloc(44 + data);
+  memcpy(wav, "RIFF", 4);
+  const uint32_t riff = 36 + data;
+  memcpy(&wav[4], &riff, 4);
+  memcpy(&wav[8], "WAVEfmt ", 8);
+  const uint32_t fmt_len = 16;
+  memcpy(&wav[16], &fmt_len, 4);
+  const uint16_t fmt[2] = {1, (uint16_t)channels};
+  memcpy(&wav[20], fmt, 4);
+  const uint32_t rates[2] = {RATE, RATE * frame};
+  memcpy(&wav[24], rates, 8);
+  const uint16_t align[2] = {(uint16_t)frame, (uint16_t)bits};
+  memcpy(&wav[32], align, 4);
+  memcpy(&wav[36], "data", 4);
+  memcpy(&wav[40], &data, 4);
+
+  // Level of the square wave at each sample, half periods in cycles
+  size_t byte = 0;
+  uint8_t pos = 0;
+  int level = 1;
+  uint64_t next = oric_td_cell_run(program[0], 0) * ORIC_TD_UNIT_CYCLES;
+  uint32_t seed = 1;
+  uint8_t* p = &wav[44];
+  for (uint32_t s = 0; s < samples; s++) {
+    const uint64_t now = (uint64_t)s * 1000000 / RATE;
+    while ((byte < program_len) && (now >= next)) {
+      level = !level;
+      if (++pos == ORIC_TD_CELL_HALF_PERIODS) {
+        pos = 0;
+        byte++;
+      }
+      if (byte < program_len) {
+        next += oric_td_cell_run(program[byte], pos) * ORIC_TD_UNIT_CYCLES;
+      }
+    }
+    seed = seed * 1103515245u + 12345u;
+    const int noise = (int)((seed >> 16) % 2048) - 1024;
+    const int drift = (int)((s / 441) % 200) * 20 - 2000;
+    int value = (byte < program_len) ? (level ? 12000 : -12000) : 0;
+    value += noise + drift;
+    for (int c = 0; c < channels; c++) {
+      if (bits == 8) {
+        *p++ = (uint8_t)((value >> 8) + 128);
+      } else {
+        *p++ = (uint8_t)value;
+        *p++ = (uint8_t)(value >> 8);
+      }
+    }
+  }
+  *out = wav;
+  return 44 + data;
+}
+
+// Decode the capture frame by frame, returns the bytes that match
+static size_t run(const char* name, int bits, int channels) {
+  uint8_t* wav;
+  const size_t size = make_wav(&wav, bits, channels);
+  char path[512];
+  snprintf(path, sizeof(path), "%s/oric/f1.wav", host_card_dir("tape_pcm"));
+  host_write_file(path, wav, size);
+  free(wav);
+
+  memset(&td, 0, sizeof(td));
+  oric_td_init(&td);
+  if (!oric_td_insert_tape_sdcard(&td, 0) || !td.pcm) {
+    printf("  %s: insert failed\n", name);
+    return 0;
+  }
+  td.port |= ORIC_TD_PORT_MOTOR;
+  uint64_t update_ns = 0;
+  uint64_t cycles = 0;
+  uint32_t frames = 0;
+  uint32_t update_max = 0;
+  size_t matched = 0;
+  int cell = -1;
+  uint8_t runs[ORIC_TD_CELL_HALF_PERIODS];
+  uint32_t edge = 1;
+  while (edge) {
+    const uint64_t start = host_now_ns();
+    oric_td_update(&td);
+    const uint32_t ns = (uint32_t)(host_now_ns() - start);
+    update_ns += ns;
+    update_max = (ns > update_max) ? ns : update_max;
+    frames++;
+    // Play a frame of cycles and decode the byte cells like test_oric_td
+    uint32_t played = 0;
+    while ((played < FRAME_CYCLES) &&
+           ((edge = oric_td_next_edge_sdcard(&td)) != 0)) {
+      played += edge;
+      const uint32_t run =
+          (edge + ORIC_TD_UNIT_CYCLES / 2) / ORIC_TD_UNIT_CYCLES;
+      if (cell < 0) {
+        cell = (run == 2) ? 3 : -1;
+        continue;
+      }
+      runs[cell++] = (uint8_t)run;
+      if (cell == ORIC_TD_CELL_HALF_PERIODS) {
+        uint8_t value = 0;
+        for (int b = 0; b < 8; b++) {
+          value |= (uint8_t)((runs[4 + 2 * b] == 1) << b);
+        }
+        matched += (matched < program_len) && (value == program[matched]);
+        cell = -1;
+      }
+    }
+    cycles += played;
+  }
+  oric_td_remove_tape_sdcard(&td);
+  const double seconds = cycles / 1e6;
+  printf("  %-14s %6.2f s of tape, update %7.3f ms/s, max %6.1f us, "
+         "%.0fx real time, %u underruns, %zu/%zu bytes\n",
+         name, seconds, update_ns / 1e6 / seconds, update_max / 1000.0,
+         seconds * 1e9 / update_ns, td.underruns, matched, program_len);
+  return matched;
+}
+
+int main(int argc, char** argv) {
+  make_program((argc > 1) ? (size_t)atoi(argv[1]) : 2048);
+  printf("%u Hz captures, %u cycle frames\n", RATE, FRAME_CYCLES);
+  // A few rounds, the host is noisy
+  for (int round = 0; round < 3; round++) {
+    run("8 bit mono", 8, 1);
+    run("16 bit stereo", 16, 2);
+  }
+  free(program);
+  return 0;
+}
@@ -0,0 +1,106 @@
+// bench_tick_variants.c
+//
+// Host time per emulated cycle of oric_run(), which picks an oric_tick()
+// variant for the devices in use, against ticking the fully checked
+// oric_tick() like the loops did before. A made-up ROM sets the tape motor
+// bit, starts the VIA timer interrupt and runs a copy loop, with the tape
+// drive attached. Both runs must end in the same machine state.
+//
+//   ./bench_tick_variants [frames]
+
+#include "oric_host.h"
+
+static oric_t sys;
+
+// Tape motor bit, T1 interrupt every 10 ms and a copy loop at $C000
+static const uint8_t _loop_rom[] = {
+    0xA9, 0xFF, 0x8D, 0x02, 0x03,  // LDA #$FF STA DDRB
+    0xA9, 0x00, 0x8D, 0x00, 0x03,  // LDA #motor STA ORB
+    0xA9, 0x40, 0x8D, 0x0B, 0x03,  // LDA #$40 STA ACR: T1 free run
+    0xA9, 0x10, 0x8D, 0x04, 0x03,  // LDA #$10 STA T1L
+    0xA9, 0x27, 0x8D, 0x05, 0x03,  // LDA #$27 STA T1H
+    0xA9, 0xC0, 0x8D, 0x0E, 0x03,  // LDA #$C0 STA IER
+    0x58,                          // CLI
+    0xA2, 0x00,                    // loop: LDX #0
+    0xBD, 0x00, 0x02,              // copy: LDA $0200,X
+    0x9D, 0x00, 0x04,              // STA $0400,X
+    0xE8,                          // INX
+    0xD0, 0xF7,                    // BNE copy
+    0xE6, 0x10,                    // INC $10
+    0x4C, 0x1F, 0xC0,              // JMP loop
+};
+
+static void _make_loop_rom(bool motor) {
+  memset(oric_rom, 0xEA, sizeof(oric_rom));
+  memcpy(oric_rom, _loop_rom, sizeof(_loop_rom));
+  oric_rom[6] = motor ? 0x40 : 0x00;
+  // IRQ handler at $C100: LDA T1L to acknowledge, RTI
+  const uint8_t irq[] = {0xAD, 0x04, 0x03, 0x40};
+  memcpy(&oric_rom[0x100], irq, sizeof(irq));
+  oric_rom[0x3FFC] = 0x00;
+  oric_rom[0x3FFD] = 0xC0;
+  oric_rom[0x3FFE] = 0x00;
+  oric_rom[0x3FFF] = 0xC1;
+}
+
+// End state of a run, to check that both loops emulate the same machine
+typedef struct {
+  uint16_t pc;
+  uint8_t count;
+  uint32_t ticks;
+  uint8_t motor;
+} _state_t;
+
+// ns per emulated cycle over the given frames
+static double _run(bool variants, uint32_t frames, _state_t* state) {
+  oric_desc_t desc = {.td_enabled = true};
+  oric_host_init(&sys, &desc);
+  const uint64_t start = host_now_ns();
+  for (uint32_t f = 0; f < frames; f++) {
+    const uint32_t end = sys.system_ticks + ORIC_HOST_FRAME_CYCLES;
+    if (variants) {
+      oric_run(&sys, end);
+    } else {
+      while ((int32_t)(sys.system_ticks - end) < 0) {
+        oric_tick(&sys);
+      }
+    }
+  }
+  const uint64_t ns = host_now_ns() - start;
+  state->pc = sys.cpu.PC;
+  state->count = sys.ram[0x10];
+  state->ticks = sys.system_ticks;
+  state->motor = sys.td.port & ORIC_TD_PORT_MOTOR;
+  return (double)ns / ((double)frames * ORIC_HOST_FRAME_CYCLES);
+}
+
+int main(int argc, char** argv) {
+  const uint32_t frames = (argc > 1) ? (uint32_t)atoi(argv[1]) : 1000;
+  printf("%u frames, tape drive attached\n", frames);
+  for (int motor = 0; motor < 2; motor++) {
+    _make_loop_rom(motor);
+    // Alternate the two and keep the best of each, the host is noisy
+    double checked = 1e9;
+    double variants = 1e9;
+    _state_t a;
+    _state_t b;
+    for (int round = 0; round < 5; round++) {
+      const double t_checked = _run(false, frames, &a);
+      const double t_variants = _run(true, frames, &b);
+      checked = (t_checked < checked) ? t_checked : checked;
+      variants = (t_variants < variants) ? t_variants : variants;
+    }
+    const bool same = (a.pc == b.pc) && (a.count == b.count) &&
+                      (a.ticks == b.ticks) && (a.motor == b.motor);
+    printf("  motor %s: oric_tick() %6.2f ns/cycle, oric_run() %6.2f "
+           "ns/cycle (%+.1f%%), end state %s\n",
+           motor ? "on " : "off", checked, variants,
+           (variants - checked) * 100.0 / checked,
+           same ? "identical" : "DIFFERS");
+    HOST_CHECK(b.motor == (motor ? ORIC_TD_PORT_MOTOR : 0));
+    if (!same) {
+      return EXIT_FAILURE;
+    }
+  }
+  return HOST_RESULT();
+}
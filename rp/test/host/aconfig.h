@@ -0,0 +1,13 @@
+#pragma once
+
+// aconfig.h
+//
+// Host stand-in for the app configuration: the folder setting is the only
+// one the emulator reads, see host.c.
+
+#include "debug.h"
+#include "settings/settings.h"
+
+#define ACONFIG_PARAM_FOLDER "FOLDER"
+
+SettingsContext* aconfig_getContext(void);
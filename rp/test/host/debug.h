@@ -0,0 +1,14 @@
+#pragma once
+
+// debug.h
+//
+// Host stand-in for the firmware traces, printed with _DEBUG=1.
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(_DEBUG) && (_DEBUG != 0)
+#define DPRINTF(fmt, ...) fprintf(stderr, fmt, ##__VA_ARGS__)
+#else
+#define DPRINTF(fmt, ...)
+#endif
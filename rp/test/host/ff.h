@@ -0,0 +1,101 @@
+#pragma once
+
+// ff.h
+//
+// Host stand-in for the FatFs API used by the emulator, backed by regular
+// files under a root directory (see ff_posix.c). Only the calls and flags the
+// emulator uses are there, with the values of the real FatFs.
+//
+// A file is held in memory while it is open. Writes stay there until f_sync()
+// or f_close(), so ff_posix_power_loss() can drop everything not synced yet
+// and a test sees what a card pulled at that moment would hold.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef unsigned int UINT;
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef uint32_t FSIZE_t;
+
+typedef enum {
+  FR_OK = 0,
+  FR_DISK_ERR,
+  FR_INT_ERR,
+  FR_NOT_READY,
+  FR_NO_FILE,
+  FR_NO_PATH,
+  FR_INVALID_NAME,
+  FR_DENIED,
+  FR_EXIST,
+  FR_INVALID_OBJECT,
+} FRESULT;
+
+#define FA_READ 0x01
+#define FA_WRITE 0x02
+#define FA_OPEN_EXISTING 0x00
+#define FA_CREATE_NEW 0x04
+#define FA_CREATE_ALWAYS 0x08
+#define FA_OPEN_ALWAYS 0x10
+#define FA_OPEN_APPEND 0x30
+
+#define AM_RDO 0x01
+
+typedef struct {
+  void* obj;  // Shim file, NULL if closed
+  FSIZE_t fptr;
+  FSIZE_t obj_size;
+} FIL;
+
+typedef struct {
+  FSIZE_t fsize;
+  BYTE fattrib;
+  char fname[256];
+} FILINFO;
+
+FRESULT f_open(FIL* fp, const char* path, BYTE mode);
+FRESULT f_close(FIL* fp);
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br);
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw);
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs);
+FRESULT f_sync(FIL* fp);
+FRESULT f_stat(const char* path, FILINFO* fno);
+FRESULT f_unlink(const char* path);
+FRESULT f_rename(const char* path_old, const char* path_new);
+
+#define f_size(fp) ((fp)->obj_size)
+#define f_tell(fp) ((fp)->fptr)
+#define f_eof(fp) ((fp)->fptr == (fp)->obj_size)
+
+// Calls seen by the shim
+typedef struct {
+  uint32_t opens;
+  uint32_t reads;
+  uint32_t writes;
+  uint32_t seeks;
+  uint32_t syncs;
+  uint32_t bytes_read;
+  uint32_t bytes_written;
+  uint32_t locked_calls;  // Calls made while the card was locked
+} ff_posix_stats_t;
+
+extern ff_posix_stats_t ff_posix_stats;
+
+// Map card paths to files under a host directory
+void ff_posix_set_root(const char* dir);
+// Count every call from now on as a locked call, used around code that must
+// not reach the card
+void ff_posix_lock(bool locked);
+// Drop the writes of all open files that were not synced and close them
+void ff_posix_power_loss(void);
+// Host path of a card path
+const char* ff_posix_path(const char* path);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
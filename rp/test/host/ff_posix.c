@@ -0,0 +1,261 @@
+// ff_posix.c
+//
+// FatFs calls on regular host files, see ff.h.
+
+#include "ff.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+ff_posix_stats_t ff_posix_stats;
+
+// Open file
+typedef struct ff_posix_file {
+  struct ff_posix_file* next;
+  FIL* fp;
+  char path[512];
+  bool writable;
+  bool dirty;  // Written since the last sync
+  uint8_t* data;
+  uint32_t size;
+  uint32_t capacity;
+} ff_posix_file_t;
+
+static char _root[256] = ".";
+static bool _locked;
+static ff_posix_file_t* _files;
+
+void ff_posix_set_root(const char* dir) {
+  snprintf(_root, sizeof(_root), "%s", dir);
+}
+
+void ff_posix_lock(bool locked) { _locked = locked; }
+
+const char* ff_posix_path(const char* path) {
+  static char host_path[512];
+  snprintf(host_path, sizeof(host_path), "%s/%s", _root,
+           (path[0] == '/') ? path + 1 : path);
+  return host_path;
+}
+
+static void _ff_posix_call(void) {
+  if (_locked) {
+    ff_posix_stats.locked_calls++;
+  }
+}
+
+static bool _ff_posix_reserve(ff_posix_file_t* f, uint32_t size) {
+  if (size <= f->capacity) {
+    return true;
+  }
+  uint32_t capacity = f->capacity ? f->capacity : 4096;
+  while (capacity < size) {
+    capacity *= 2;
+  }
+  uint8_t* data = realloc(f->data, capacity);
+  if (data == NULL) {
+    return false;
+  }
+  f->data = data;
+  f->capacity = capacity;
+  return true;
+}
+
+static void _ff_posix_forget(ff_posix_file_t* f) {
+  for (ff_posix_file_t** p = &_files; *p; p = &(*p)->next) {
+    if (*p == f) {
+      *p = f->next;
+      break;
+    }
+  }
+  f->fp->obj = NULL;
+  free(f->data);
+  free(f);
+}
+
+FRESULT f_open(FIL* fp, const char* path, BYTE mode) {
+  _ff_posix_call();
+  ff_posix_stats.opens++;
+  memset(fp, 0, sizeof(FIL));
+  const char* host_path = ff_posix_path(path);
+  const bool write = (mode & FA_WRITE) != 0;
+  struct stat st;
+  const bool exists = stat(host_path, &st) == 0;
+  if (exists && (mode & FA_CREATE_NEW)) {
+    return FR_EXIST;
+  }
+  if (!exists && !(mode & (FA_CREATE_NEW | FA_CREATE_ALWAYS |
+                           FA_OPEN_ALWAYS))) {
+    return FR_NO_FILE;
+  }
+  if (write && exists && (access(host_path, W_OK) != 0)) {
+    return FR_DENIED;
+  }
+  ff_posix_file_t* f = calloc(1, sizeof(ff_posix_file_t));
+  if (f == NULL) {
+    return FR_INT_ERR;
+  }
+  f->fp = fp;
+  f->writable = write;
+  snprintf(f->path, sizeof(f->path), "%s", host_path);
+  if (exists && !(mode & FA_CREATE_ALWAYS)) {
+    FILE* file = fopen(host_path, "rb");
+    if ((file == NULL) || !_ff_posix_reserve(f, (uint32_t)st.st_size + 1)) {
+      if (file) {
+        fclose(file);
+      }
+      free(f->data);
+      free(f);
+      return FR_DISK_ERR;
+    }
+    f->size = (uint32_t)fread(f->data, 1, (size_t)st.st_size, file);
+    fclose(file);
+  } else {
+    // A new or truncated file exists as soon as it is opened
+    FILE* file = fopen(host_path, "wb");
+    if (file == NULL) {
+      free(f);
+      return FR_NO_PATH;
+    }
+    fclose(file);
+  }
+  f->next = _files;
+  _files = f;
+  fp->obj = f;
+  fp->obj_size = f->size;
+  fp->fptr = ((mode & FA_OPEN_APPEND) == FA_OPEN_APPEND) ? f->size : 0;
+  return FR_OK;
+}
+
+FRESULT f_sync(FIL* fp) {
+  _ff_posix_call();
+  ff_posix_file_t* f = (ff_posix_file_t*)fp->obj;
+  if (f == NULL) {
+    return FR_INVALID_OBJECT;
+  }
+  ff_posix_stats.syncs++;
+  if (!f->dirty) {
+    return FR_OK;
+  }
+  FILE* file = fopen(f->path, "wb");
+  if (file == NULL) {
+    return FR_DISK_ERR;
+  }
+  const bool ok = fwrite(f->data, 1, f->size, file) == f->size;
+  fclose(file);
+  f->dirty = !ok;
+  return ok ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT f_close(FIL* fp) {
+  ff_posix_file_t* f = (ff_posix_file_t*)fp->obj;
+  if (f == NULL) {
+    return FR_INVALID_OBJECT;
+  }
+  FRESULT res = FR_OK;
+  if (f->dirty) {
+    res = f_sync(fp);
+  } else {
+    _ff_posix_call();
+  }
+  _ff_posix_forget(f);
+  return res;
+}
+
+FRESULT f_read(FIL* fp, void* buff, UINT btr, UINT* br) {
+  _ff_posix_call();
+  ff_posix_file_t* f = (ff_posix_file_t*)fp->obj;
+  *br = 0;
+  if (f == NULL) {
+    return FR_INVALID_OBJECT;
+  }
+  ff_posix_stats.reads++;
+  if (fp->fptr < f->size) {
+    const uint32_t left = f->size - fp->fptr;
+    *br = (btr < left) ? btr : left;
+    memcpy(buff, &f->data[fp->fptr], *br);
+    fp->fptr += *br;
+  }
+  ff_posix_stats.bytes_read += *br;
+  return FR_OK;
+}
+
+FRESULT f_write(FIL* fp, const void* buff, UINT btw, UINT* bw) {
+  _ff_posix_call();
+  ff_posix_file_t* f = (ff_posix_file_t*)fp->obj;
+  *bw = 0;
+  if (f == NULL) {
+    return FR_INVALID_OBJECT;
+  }
+  if (!f->writable) {
+    return FR_DENIED;
+  }
+  ff_posix_stats.writes++;
+  if (!_ff_posix_reserve(f, fp->fptr + btw)) {
+    return FR_DISK_ERR;
+  }
+  if (fp->fptr > f->size) {
+    memset(&f->data[f->size], 0, fp->fptr - f->size);
+  }
+  memcpy(&f->data[fp->fptr], buff, btw);
+  fp->fptr += btw;
+  if (fp->fptr > f->size) {
+    f->size = fp->fptr;
+  }
+  fp->obj_size = f->size;
+  f->dirty = true;
+  *bw = btw;
+  ff_posix_stats.bytes_written += btw;
+  return FR_OK;
+}
+
+FRESULT f_lseek(FIL* fp, FSIZE_t ofs) {
+  _ff_posix_call();
+  ff_posix_file_t* f = (ff_posix_file_t*)fp->obj;
+  if (f == NULL) {
+    return FR_INVALID_OBJECT;
+  }
+  ff_posix_stats.seeks++;
+  // Like FatFs, a read only file can't be extended by a seek
+  fp->fptr = (!f->writable && (ofs > f->size)) ? f->size : ofs;
+  return FR_OK;
+}
+
+FRESULT f_stat(const char* path, FILINFO* fno) {
+  _ff_posix_call();
+  const char* host_path = ff_posix_path(path);
+  struct stat st;
+  if (stat(host_path, &st) != 0) {
+    return FR_NO_FILE;
+  }
+  if (fno) {
+    memset(fno, 0, sizeof(FILINFO));
+    fno->fsize = (FSIZE_t)st.st_size;
+    fno->fattrib = (access(host_path, W_OK) == 0) ? 0 : AM_RDO;
+    const char* name = strrchr(path, '/');
+    snprintf(fno->fname, sizeof(fno->fname), "%s", name ? name + 1 : path);
+  }
+  return FR_OK;
+}
+
+FRESULT f_unlink(const char* path) {
+  _ff_posix_call();
+  return (unlink(ff_posix_path(path)) == 0) ? FR_OK : FR_NO_FILE;
+}
+
+FRESULT f_rename(const char* path_old, const char* path_new) {
+  _ff_posix_call();
+  char old_host[512];
+  snprintf(old_host, sizeof(old_host), "%s", ff_posix_path(path_old));
+  return (rename(old_host, ff_posix_path(path_new)) == 0) ? FR_OK
+                                                          : FR_NO_FILE;
+}
+
+void ff_posix_power_loss(void) {
+  while (_files) {
+    _ff_posix_forget(_files);
+  }
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+// timer.h
+//
+// Host stand-in for the RP2040 timer. timer_hw is defined in host.c and
+// stays at 0, the firmware only reads it for traces.
+
+#include "pico.h"
+
+typedef struct {
+  volatile uint32_t timerawh;
+  volatile uint32_t timerawl;
+} timer_hw_t;
+
+extern timer_hw_t* timer_hw;
@@ -0,0 +1,5 @@
+#pragma once
+
+#include "pico.h"
+
+#define VREG_VOLTAGE_1_20 13
@@ -0,0 +1,93 @@
+// host.c
+//
+// Settings, file and timing helpers for the host tests.
+
+#include "host.h"
+
+#include <dirent.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "aconfig.h"
+#include "ff.h"
+#include "hardware/structs/timer.h"
+
+int host_failures;
+
+// Read by the firmware timing macros, only for traces here
+static timer_hw_t _timer;
+timer_hw_t* timer_hw = &_timer;
+
+static SettingsContext _context;
+static SettingsConfigEntry _folder = {ACONFIG_PARAM_FOLDER, 0, "/oric"};
+
+void host_set_folder(const char* folder) {
+  snprintf(_folder.value, sizeof(_folder.value), "%s", folder);
+}
+
+SettingsContext* aconfig_getContext(void) { return &_context; }
+
+SettingsConfigEntry* settings_find_entry(SettingsContext* context,
+                                         const char* key) {
+  (void)context;
+  return (strcmp(key, ACONFIG_PARAM_FOLDER) == 0) ? &_folder : NULL;
+}
+
+const char* host_card_dir(const char* name) {
+  static char dir[256];
+  snprintf(dir, sizeof(dir), "%s/%s", HOST_SCRATCH_DIR, name);
+  char folder[320];
+  mkdir(HOST_SCRATCH_DIR, 0755);
+  mkdir(dir, 0755);
+  snprintf(folder, sizeof(folder), "%s/oric", dir);
+  mkdir(folder, 0755);
+  // Start from an empty card, files of an earlier run would change results
+  DIR* d = opendir(folder);
+  struct dirent* entry;
+  while (d && (entry = readdir(d)) != NULL) {
+    if (entry->d_name[0] != '.') {
+      char path[600];
+      snprintf(path, sizeof(path), "%s/%s", folder, entry->d_name);
+      unlink(path);
+    }
+  }
+  if (d) {
+    closedir(d);
+  }
+  ff_posix_set_root(dir);
+  host_set_folder("/oric");
+  return dir;
+}
+
+bool host_write_file(const char* path, const void* data, size_t size) {
+  FILE* file = fopen(path, "wb");
+  if (file == NULL) {
+    return false;
+  }
+  const bool ok = fwrite(data, 1, size, file) == size;
+  return (fclose(file) == 0) && ok;
+}
+
+uint8_t* host_read_file(const char* path, size_t* size) {
+  FILE* file = fopen(path, "rb");
+  if (file == NULL) {
+    return NULL;
+  }
+  fseek(file, 0, SEEK_END);
+  const long len = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  uint8_t* data = malloc((size_t)len + 1);
+  if (data) {
+    *size = fread(data, 1, (size_t)len, file);
+  }
+  fclose(file);
+  return data;
+}
+
+uint64_t host_now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
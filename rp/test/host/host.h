@@ -0,0 +1,37 @@
+#pragma once
+
+// host.h
+//
+// Helpers shared by the host tests and benchmarks.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Set the folder setting, the card folder of disk and tape images
+void host_set_folder(const char* folder);
+
+// Create an empty scratch directory for the card and make it the shim's root,
+// returns its host path
+const char* host_card_dir(const char* name);
+
+// Write and read whole host files, read returns NULL if the file is missing
+bool host_write_file(const char* path, const void* data, size_t size);
+uint8_t* host_read_file(const char* path, size_t* size);
+
+// Monotonic time in nanoseconds
+uint64_t host_now_ns(void);
+
+// Test checks, count the failures and keep going
+extern int host_failures;
+#define HOST_CHECK(c)                                                 \
+  do {                                                                \
+    if (!(c)) {                                                       \
+      fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+              #c);                                                    \
+      host_failures++;                                                \
+    }                                                                 \
+  } while (0)
+#define HOST_RESULT() (host_failures ? EXIT_FAILURE : EXIT_SUCCESS)
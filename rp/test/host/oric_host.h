@@ -0,0 +1,114 @@
+#pragma once
+
+// oric_host.h
+//
+// The whole Oric system for host tests and benchmarks, built with CHIPS_IMPL
+// like oric.c does. Include it in the one source file of a test program, it
+// also defines the globals the firmware provides.
+//
+// There is no Oric ROM in the repository. Programs either run their own code
+// from a made-up ROM or load a BASIC ROM image from the path in the ORIC_ROM
+// environment variable.
+
+#define CHIPS_IMPL
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "chips/chips_common.h"
+#include "constants.h"
+#include "hardware/structs/timer.h"
+#include "pico/stdlib.h"
+#include "chips/mos6502cpu.h"
+#include "chips/ay38910psg.h"
+#include "chips/clk.h"
+#include "chips/mem.h"
+#include "chips/mos6522via.h"
+#include "chips/sched.h"
+#include "chips/wd1793fdc.h"
+#include "debug.h"
+#include "devices/disk2_fdc.h"
+#include "devices/disk2_fdd.h"
+#include "devices/microdisc.h"
+#include "devices/oric_td.h"
+#include "systems/oric/src/oric.h"
+
+#include "host.h"
+
+// Cycles of a PAL frame
+#define ORIC_HOST_FRAME_CYCLES (19968)
+
+// Firmware globals: the framebuffers live at the start of the ROM-in-RAM
+// area, and the PSG writes go to a queue for the Atari side
+uint8_t __rom_in_ram_start__[0x20000];
+uint8_t oric_rom[ORIC_ROM_SIZE];
+uint16_t* oric_via_queue;
+uint16_t oric_via_queue_head;
+static uint16_t oric_host_via_queue[ATARI_ST_VIA_QUEUE_SIZE_BYTES / 2];
+
+void oric_ayQueuePush(uint16_t* queue, uint16_t* head, uint16_t value) {
+  queue[*head % (ATARI_ST_VIA_QUEUE_SIZE_BYTES / 2)] = value;
+  (*head)++;
+}
+
+static uint8_t oric_host_boot_rom[0x200];
+
+// Init sys with the ROM in oric_rom. The caller sets the devices in desc,
+// the ROM images are filled in here.
+static void oric_host_init(oric_t* sys, oric_desc_t* desc) {
+  oric_via_queue = oric_host_via_queue;
+  oric_via_queue_head = 0;
+  desc->roms.rom.ptr = oric_rom;
+  desc->roms.rom.size = sizeof(oric_rom);
+  desc->roms.boot_rom.ptr = oric_host_boot_rom;
+  desc->roms.boot_rom.size = sizeof(oric_host_boot_rom);
+  oric_init(sys, desc);
+}
+
+// Load the ROM image named by the environment variable var into oric_rom,
+// false if the variable is not set or the file is not a 16 KB image
+static bool oric_host_load_rom(const char* var) {
+  const char* path = getenv(var);
+  if (path == NULL) {
+    return false;
+  }
+  size_t size = 0;
+  uint8_t* image = host_read_file(path, &size);
+  const bool ok = image && (size == ORIC_ROM_SIZE);
+  if (ok) {
+    memcpy(oric_rom, image, ORIC_ROM_SIZE);
+  } else {
+    fprintf(stderr, "%s: not a %u byte ROM image\n", path, ORIC_ROM_SIZE);
+  }
+  free(image);
+  return ok;
+}
+
+// Load the BASIC ROM named by ORIC_ROM
+static bool oric_host_load_basic_rom(void) {
+  return oric_host_load_rom("ORIC_ROM");
+}
+
+// Run whole frames the way the firmware main loop does
+static void oric_host_run_frames(oric_t* sys, uint32_t frames) {
+  for (uint32_t f = 0; f < frames; f++) {
+    oric_run(sys, sys->system_ticks + ORIC_HOST_FRAME_CYCLES);
+    if (sys->td.valid) {
+      oric_td_update(&sys->td);
+    }
+    oric_kbd_update(&sys->kbd);
+  }
+}
+
+// Type text on the keyboard, a key every four frames, '\n' is Return. Key
+// codes are those of oric_kbd.h, where capitals are the unshifted keys.
+static void oric_host_type(oric_t* sys, const char* text) {
+  for (const char* c = text; *c; c++) {
+    const int key = (*c == '\n') ? 0x0D : *c;
+    oric_kbd_key_down(&sys->kbd, key);
+    oric_host_run_frames(sys, 2);
+    oric_key_up(sys, key);
+    oric_host_run_frames(sys, 2);
+  }
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// pico.h
+//
+// Host stand-in for the Pico SDK attributes used by the emulator.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define __not_in_flash_func(f) f
+#define __force_inline inline __attribute__((always_inline))
@@ -0,0 +1,23 @@
+#pragma once
+
+// settings.h
+//
+// Host stand-in for the settings manager.
+
+#include <stdbool.h>
+
+#define SETTINGS_MAX_KEY_LENGTH 20
+#define SETTINGS_MAX_VALUE_LENGTH 128
+
+typedef struct {
+  char key[SETTINGS_MAX_KEY_LENGTH];
+  int dataType;
+  char value[SETTINGS_MAX_VALUE_LENGTH];
+} SettingsConfigEntry;
+
+typedef struct {
+  int unused;
+} SettingsContext;
+
+SettingsConfigEntry* settings_find_entry(SettingsContext* context,
+                                         const char* key);
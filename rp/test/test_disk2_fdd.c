@@ -0,0 +1,182 @@
+// test_disk2_fdd.c
+//
+// Disk II write-back rules of disk2_fdd.h: the emulation loop never reaches
+// the card, a seek only loads the track it ends on, a written track is synced
+// within the promised number of updates, and a power loss at any moment
+// leaves every track either fully old or fully new.
+
+#define CHIPS_IMPL
+#include "devices/disk2_fdd.h"
+
+#include <string.h>
+
+#include "host.h"
+
+static disk2_fdd_t fdd;
+static char image_path[512];
+
+static uint8_t old_nibble(int track, int pos) {
+  return (uint8_t)(0x96 + ((track * 7 + pos) % 0x60));
+}
+
+// A fresh d1.nib with a known pattern, inserted with the motor on
+static void insert(const char* name) {
+  const char* dir = host_card_dir(name);
+  snprintf(image_path, sizeof(image_path), "%s/oric/d1.nib", dir);
+  static uint8_t image[DISK2_FDD_NIB_IMAGE_SIZE];
+  for (int t = 0; t < DISK2_FDD_TRACKS_PER_DISK; t++) {
+    for (int i = 0; i < DISK2_FDD_BYTES_PER_NIB_TRACK; i++) {
+      image[t * DISK2_FDD_BYTES_PER_NIB_TRACK + i] = old_nibble(t, i);
+    }
+  }
+  HOST_CHECK(host_write_file(image_path, image, sizeof(image)));
+  memset(&fdd, 0, sizeof(fdd));
+  disk2_fdd_init(&fdd);
+  HOST_CHECK(disk2_fdd_insert_disk_sdcard(&fdd, 0));
+  disk2_fdd_set_motor_on(&fdd);
+}
+
+// What the card holds of a track: 0 old, 1 new, -1 torn
+static int card_track(int track, uint8_t value) {
+  size_t size = 0;
+  uint8_t* image = host_read_file(image_path, &size);
+  HOST_CHECK(image && (size == DISK2_FDD_NIB_IMAGE_SIZE));
+  if (!image) {
+    return -1;
+  }
+  const uint8_t* t = &image[track * DISK2_FDD_BYTES_PER_NIB_TRACK];
+  bool is_old = true;
+  bool is_new = true;
+  for (int i = 0; i < DISK2_FDD_BYTES_PER_NIB_TRACK; i++) {
+    is_old &= t[i] == old_nibble(track, i);
+    is_new &= t[i] == value;
+  }
+  free(image);
+  return is_new ? 1 : (is_old ? 0 : -1);
+}
+
+// Overwrite the whole track under the head with the card locked
+static void write_track(uint8_t value) {
+  ff_posix_lock(true);
+  fdd.control_bits = 3;
+  for (int i = 0; i < DISK2_FDD_BYTES_PER_NIB_TRACK; i++) {
+    fdd.write_ready = 0x80;
+    disk2_fdd_write_byte(&fdd, value);
+  }
+  fdd.control_bits = 0;
+  ff_posix_lock(false);
+}
+
+static void step_to(int track) {
+  ff_posix_lock(true);
+  while (fdd.half_track / 2 != track) {
+    fdd.half_track += (fdd.half_track / 2 < track) ? 2 : -2;
+    disk2_fdd_select_track(&fdd);
+  }
+  ff_posix_lock(false);
+}
+
+static uint8_t read_nibble(void) {
+  ff_posix_lock(true);
+  fdd.control_bits = 0;
+  const uint8_t nibble = disk2_fdd_read_byte(&fdd);
+  ff_posix_lock(false);
+  return nibble;
+}
+
+// An idle written track is synced within DISK2_FDD_FLUSH_IDLE_UPDATES
+static void test_idle_flush(void) {
+  insert("disk2_idle");
+  write_track(0xD5);
+  int updates = 0;
+  while ((card_track(0, 0xD5) != 1) &&
+         (updates <= DISK2_FDD_FLUSH_IDLE_UPDATES)) {
+    disk2_fdd_update(&fdd);
+    updates++;
+    // Before the flush a power loss keeps the old track
+    HOST_CHECK(card_track(0, 0xD5) >= 0);
+  }
+  HOST_CHECK(updates == DISK2_FDD_FLUSH_IDLE_UPDATES);
+  ff_posix_power_loss();
+  HOST_CHECK(card_track(0, 0xD5) == 1);
+}
+
+// A track the head left is synced by the next update
+static void test_step_flush(void) {
+  insert("disk2_step");
+  write_track(0xD6);
+  step_to(5);
+  HOST_CHECK(card_track(0, 0xD6) == 0);
+  disk2_fdd_update(&fdd);
+  ff_posix_power_loss();
+  HOST_CHECK(card_track(0, 0xD6) == 1);
+  HOST_CHECK(card_track(5, 0xD6) == 0);
+}
+
+// Stopping the motor syncs the track by the next update
+static void test_motor_flush(void) {
+  insert("disk2_motor");
+  write_track(0xD7);
+  disk2_fdd_set_motor_off(&fdd);
+  disk2_fdd_update(&fdd);
+  ff_posix_power_loss();
+  HOST_CHECK(card_track(0, 0xD7) == 1);
+}
+
+// A seek loads the track it ends on once the head rests, and the drive gives
+// sync nibbles and drops writes until then
+static void test_seek(void) {
+  insert("disk2_seek");
+  disk2_fdd_update(&fdd);
+  const uint32_t reads = ff_posix_stats.reads;
+  for (int t = 1; t <= 20; t++) {
+    step_to(t);
+    if (t % 4 == 1) {
+      // Still moving at the update
+      disk2_fdd_update(&fdd);
+    }
+  }
+  HOST_CHECK(ff_posix_stats.reads == reads);
+  HOST_CHECK(read_nibble() == 0xFF);
+  write_track(0xD8);
+  disk2_fdd_update(&fdd);  // Saw the last steps
+  HOST_CHECK(ff_posix_stats.reads == reads);
+  disk2_fdd_update(&fdd);  // Head at rest, loads track 20
+  HOST_CHECK(ff_posix_stats.reads == reads + 1);
+  HOST_CHECK(read_nibble() == old_nibble(20, fdd.offset));
+  disk2_fdd_update(&fdd);  // Prefetches track 21
+  HOST_CHECK(ff_posix_stats.reads == reads + 2);
+  step_to(21);
+  HOST_CHECK(read_nibble() == old_nibble(21, fdd.offset));
+  disk2_fdd_remove_disk(&fdd);
+  HOST_CHECK(card_track(20, 0xD8) == 0);
+}
+
+// Power loss after every update of a session writing several tracks
+static void test_power_loss(void) {
+  for (int cut = 0; cut < 8; cut++) {
+    insert("disk2_power");
+    int updates = 0;
+    for (int t = 0; (t < 4) && (updates < cut); t++) {
+      step_to(t);
+      disk2_fdd_update(&fdd);
+      disk2_fdd_update(&fdd);
+      write_track((uint8_t)(0xE0 + t));
+      updates++;
+    }
+    ff_posix_power_loss();
+    for (int t = 0; t < 4; t++) {
+      HOST_CHECK(card_track(t, (uint8_t)(0xE0 + t)) >= 0);
+    }
+  }
+}
+
+int main(void) {
+  test_idle_flush();
+  test_step_flush();
+  test_motor_flush();
+  test_seek();
+  test_power_loss();
+  HOST_CHECK(ff_posix_stats.locked_calls == 0);
+  return HOST_RESULT();
+}
@@ -0,0 +1,213 @@
+// test_disk2_nib.c
+//
+// DOS 3.3 .dsk images in disk2_fdd.h against NIB images made by a separate
+// 6-and-2 nibblizer written from the DOS 3.3 format: a nibbled .dsk track
+// reads exactly like the .nib track of the same sectors, and writing the
+// tracks of a .nib image onto a .dsk disk, at any rotation, stores the
+// sectors of that image.
+
+#define CHIPS_IMPL
+#include "devices/disk2_fdd.h"
+
+#include <string.h>
+
+#include "host.h"
+
+#define NIB_TRACK DISK2_FDD_BYTES_PER_NIB_TRACK
+
+static disk2_fdd_t fdd;
+static uint8_t dsk[DISK2_FDD_DSK_IMAGE_SIZE];
+static uint8_t nib[DISK2_FDD_NIB_IMAGE_SIZE];
+
+// Valid disk nibbles: bit 7 set, two adjacent one bits among bits 0-6 and
+// at most one pair of adjacent zero bits
+static uint8_t nibble_of[64];
+
+static void init_nibbles(void) {
+  int n = 0;
+  for (int b = 0x96; b <= 0xFF; b++) {
+    bool ones = false;
+    int zeros = 0;
+    for (int i = 0; i < 7; i++) {
+      const int two = (b >> i) & 3;
+      ones |= (two == 3) && (i < 6);
+      zeros += two == 0;
+    }
+    if (ones && (zeros <= 1)) {
+      nibble_of[n++] = (uint8_t)b;
+    }
+  }
+  HOST_CHECK(n == 64);
+}
+
+static uint8_t* put_odd_even(uint8_t* p, uint8_t value) {
+  *p++ = (uint8_t)(0xAA | (value >> 1));
+  *p++ = (uint8_t)(0xAA | value);
+  return p;
+}
+
+static uint8_t reverse2(uint8_t bits) {
+  return (uint8_t)(((bits & 1) << 1) | ((bits >> 1) & 1));
+}
+
+// One physical sector in the 374 nibble layout of disk2_fdd.h
+static uint8_t* nibblize_sector(uint8_t* p, int track, int sector,
+                                const uint8_t* data) {
+  static const uint8_t gap1[6] = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF};
+  memcpy(p, gap1, 6);
+  p += 6;
+  *p++ = 0xD5;
+  *p++ = 0xAA;
+  *p++ = 0x96;
+  p = put_odd_even(p, DISK2_FDD_VOLUME);
+  p = put_odd_even(p, (uint8_t)track);
+  p = put_odd_even(p, (uint8_t)sector);
+  p = put_odd_even(p, (uint8_t)(DISK2_FDD_VOLUME ^ track ^ sector));
+  *p++ = 0xDE;
+  *p++ = 0xAA;
+  *p++ = 0xEB;
+  memset(p, 0xFF, 5);
+  p += 5;
+  *p++ = 0xD5;
+  *p++ = 0xAA;
+  *p++ = 0xAD;
+  uint8_t six[342];
+  for (int i = 0; i < 86; i++) {
+    uint8_t aux = reverse2(data[i] & 3);
+    aux |= (uint8_t)(reverse2(data[i + 86] & 3) << 2);
+    if (i + 172 < 256) {
+      aux |= (uint8_t)(reverse2(data[i + 172] & 3) << 4);
+    }
+    six[i] = aux;
+  }
+  for (int i = 0; i < 256; i++) {
+    six[86 + i] = data[i] >> 2;
+  }
+  uint8_t last = 0;
+  for (int i = 0; i < 342; i++) {
+    *p++ = nibble_of[six[i] ^ last];
+    last = six[i];
+  }
+  *p++ = nibble_of[last];
+  *p++ = 0xDE;
+  *p++ = 0xAA;
+  *p++ = 0xEB;
+  return p;
+}
+
+// DOS 3.3 logical sector of each physical sector
+static const int dos_sector[16] = {0, 7, 14, 6, 13, 5, 12, 4,
+                                   11, 3, 10, 2, 9, 1, 8, 15};
+
+static void nibblize(const uint8_t* image, uint8_t* out) {
+  for (int t = 0; t < DISK2_FDD_TRACKS_PER_DISK; t++) {
+    uint8_t* p = &out[t * NIB_TRACK];
+    for (int s = 0; s < 16; s++) {
+      p = nibblize_sector(p, t, s,
+                          &image[(t * 16 + dos_sector[s]) * 256]);
+    }
+    HOST_CHECK(p == &out[(t + 1) * NIB_TRACK]);
+  }
+}
+
+static const char* insert(const char* name, const char* file,
+                          const uint8_t* image, size_t size, int index) {
+  static char path[512];
+  snprintf(path, sizeof(path), "%s/oric/%s", host_card_dir(name), file);
+  HOST_CHECK(host_write_file(path, image, size));
+  memset(&fdd, 0, sizeof(fdd));
+  disk2_fdd_init(&fdd);
+  HOST_CHECK(disk2_fdd_insert_disk_sdcard(&fdd, index));
+  disk2_fdd_set_motor_on(&fdd);
+  return path;
+}
+
+static void seek(int track) {
+  while (fdd.half_track / 2 != track) {
+    fdd.half_track += (fdd.half_track / 2 < track) ? 2 : -2;
+    disk2_fdd_select_track(&fdd);
+  }
+  disk2_fdd_update(&fdd);
+  disk2_fdd_update(&fdd);
+}
+
+// A revolution read from a nibbled .dsk track is the .nib track, rotated
+static void test_read(void) {
+  insert("disk2_nib_read", "d1.dsk", dsk, sizeof(dsk), 0);
+  HOST_CHECK(fdd.dsk_image);
+  static uint8_t rev[NIB_TRACK];
+  for (int t = 0; t < DISK2_FDD_TRACKS_PER_DISK; t++) {
+    seek(t);
+    fdd.control_bits = 0;
+    const uint16_t start = (uint16_t)((fdd.offset + 1) % NIB_TRACK);
+    for (int i = 0; i < NIB_TRACK; i++) {
+      rev[(start + i) % NIB_TRACK] = disk2_fdd_read_byte(&fdd);
+    }
+    HOST_CHECK(memcmp(rev, &nib[t * NIB_TRACK], NIB_TRACK) == 0);
+  }
+  disk2_fdd_remove_disk(&fdd);
+}
+
+// Writing the .nib tracks over a blank .dsk disk stores its sectors. The
+// writes start anywhere on the track, so sectors wrap around the buffer end.
+static void test_write(void) {
+  static uint8_t blank[DISK2_FDD_DSK_IMAGE_SIZE];
+  const char* path =
+      insert("disk2_nib_write", "d1.dsk", blank, sizeof(blank), 0);
+  for (int t = 0; t < DISK2_FDD_TRACKS_PER_DISK; t++) {
+    seek(t);
+    // Let the disk turn a while, differently on every track
+    fdd.control_bits = 0;
+    for (int i = 0; i < t * 997; i++) {
+      disk2_fdd_read_byte(&fdd);
+    }
+    fdd.control_bits = 3;
+    for (int i = 0; i < NIB_TRACK; i++) {
+      fdd.write_ready = 0x80;
+      disk2_fdd_write_byte(&fdd, nib[t * NIB_TRACK + i]);
+    }
+    fdd.control_bits = 0;
+  }
+  disk2_fdd_remove_disk(&fdd);
+  size_t size = 0;
+  uint8_t* image = host_read_file(path, &size);
+  HOST_CHECK(image && (size == sizeof(dsk)));
+  if (image) {
+    for (int s = 0; s < DISK2_FDD_TRACKS_PER_DISK * 16; s++) {
+      if ((memcmp(&image[s * 256], &dsk[s * 256], 256) != 0) &&
+          (host_failures++ < 4)) {
+        fprintf(stderr, "track %d sector %d differs\n", s / 16, s % 16);
+      }
+    }
+    free(image);
+  }
+}
+
+// The same .nib image inserted as such plays the same nibbles
+static void test_nib_image(void) {
+  insert("disk2_nib_image", "d2.nib", nib, sizeof(nib), 1);
+  HOST_CHECK(!fdd.dsk_image);
+  seek(17);
+  fdd.control_bits = 0;
+  const uint16_t start = (uint16_t)((fdd.offset + 1) % NIB_TRACK);
+  bool same = true;
+  for (int i = 0; i < NIB_TRACK; i++) {
+    same &= disk2_fdd_read_byte(&fdd) ==
+            nib[17 * NIB_TRACK + (start + i) % NIB_TRACK];
+  }
+  HOST_CHECK(same);
+  disk2_fdd_remove_disk(&fdd);
+}
+
+int main(void) {
+  init_nibbles();
+  srand(34);
+  for (size_t i = 0; i < sizeof(dsk); i++) {
+    dsk[i] = (uint8_t)rand();
+  }
+  nibblize(dsk, nib);
+  test_read();
+  test_write();
+  test_nib_image();
+  return HOST_RESULT();
+}
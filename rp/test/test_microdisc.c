@@ -0,0 +1,179 @@
+// test_microdisc.c
+//
+// Microdisc track buffer: the WD1793 reads and writes sectors of an MFM_DISK
+// image while the card is locked, microdisc_update() alone reaches the card,
+// and a sector written by a finished command survives a power loss after the
+// next update.
+
+#define CHIPS_IMPL
+#include "devices/microdisc.h"
+
+#include <string.h>
+
+#include "host.h"
+
+#define TRACKS (40)
+#define SECTORS (17)
+#define FRAME_CYCLES (19968)
+
+static uint8_t eprom[MICRODISC_EPROM_SIZE];
+static uint8_t overlay_ram[MICRODISC_OVERLAY_RAM_SIZE];
+static uint8_t track_data[MICRODISC_TRACK_SIZE];
+static microdisc_t md;
+
+static uint8_t sector_byte(int track, int sector, int i) {
+  return (uint8_t)(track * 31 + sector * 7 + i);
+}
+
+// One sided image, 17 sectors of 256 bytes per track
+static void make_image(const char* path) {
+  const size_t size = 256 + (size_t)TRACKS * MICRODISC_TRACK_SIZE;
+  uint8_t* image = calloc(1, size);
+  memcpy(image, "MFM_DISK", 8);
+  image[8] = 1;
+  image[12] = TRACKS;
+  image[16] = 1;
+  for (int t = 0; t < TRACKS; t++) {
+    uint8_t* p = &image[256 + t * MICRODISC_TRACK_SIZE];
+    int pos = 40;
+    for (int s = 1; s <= SECTORS; s++) {
+      memset(&p[pos], 0xA1, 3);
+      pos += 3;
+      p[pos++] = 0xFE;
+      p[pos++] = (uint8_t)t;
+      p[pos++] = 0;
+      p[pos++] = (uint8_t)s;
+      p[pos++] = 1;
+      pos += 2;  // CRC
+      memset(&p[pos], 0x4E, 22);
+      pos += 22;
+      memset(&p[pos], 0xA1, 3);
+      pos += 3;
+      p[pos++] = 0xFB;
+      for (int i = 0; i < 256; i++) {
+        p[pos++] = sector_byte(t, s, i);
+      }
+      pos += 2;  // CRC
+      memset(&p[pos], 0x4E, 24);
+      pos += 24;
+    }
+  }
+  HOST_CHECK(host_write_file(path, image, size));
+  free(image);
+}
+
+// Run the FDC for a frame with the card locked, then update
+static void frame(void) {
+  ff_posix_lock(true);
+  for (int i = 0; i < FRAME_CYCLES; i += 4) {
+    microdisc_tick(&md, 4);
+  }
+  ff_posix_lock(false);
+  microdisc_update(&md);
+}
+
+static bool wait_idle(void) {
+  for (int i = 0; (i < 200) && wd1793fdc_busy(&md.fdc); i++) {
+    frame();
+  }
+  return !wd1793fdc_busy(&md.fdc);
+}
+
+static void seek(int track) {
+  microdisc_write(&md, 3, (uint8_t)track);
+  microdisc_write(&md, 0, 0x14);  // SEEK with verify
+  HOST_CHECK(wait_idle());
+  HOST_CHECK((microdisc_read(&md, 0) & 0x98) == 0);
+}
+
+// Read a sector through the data register, serving DRQ every 4 cycles
+static bool read_sector(int sector, uint8_t* buf) {
+  microdisc_write(&md, 2, (uint8_t)sector);
+  microdisc_write(&md, 0, 0x80);
+  int n = 0;
+  for (int f = 0; (f < 200) && wd1793fdc_busy(&md.fdc); f++) {
+    ff_posix_lock(true);
+    for (int i = 0; (i < FRAME_CYCLES) && wd1793fdc_busy(&md.fdc); i += 4) {
+      microdisc_tick(&md, 4);
+      if (md.fdc.drq && (n < 256)) {
+        buf[n++] = microdisc_read(&md, 3);
+      }
+    }
+    ff_posix_lock(false);
+    microdisc_update(&md);
+  }
+  return (n == 256) && ((microdisc_read(&md, 0) & 0x1C) == 0);
+}
+
+static bool write_sector(int sector, const uint8_t* buf) {
+  microdisc_write(&md, 2, (uint8_t)sector);
+  microdisc_write(&md, 0, 0xA0);
+  int n = 0;
+  for (int f = 0; (f < 200) && wd1793fdc_busy(&md.fdc); f++) {
+    ff_posix_lock(true);
+    for (int i = 0; (i < FRAME_CYCLES) && wd1793fdc_busy(&md.fdc); i += 4) {
+      if (md.fdc.drq && (n < 256)) {
+        microdisc_write(&md, 3, buf[n++]);
+      }
+      microdisc_tick(&md, 4);
+    }
+    ff_posix_lock(false);
+    microdisc_update(&md);
+  }
+  return (n == 256) && ((microdisc_read(&md, 0) & 0x5C) == 0);
+}
+
+int main(void) {
+  const char* dir = host_card_dir("microdisc");
+  char path[512];
+  snprintf(path, sizeof(path), "%s/oric/m1.dsk", dir);
+  make_image(path);
+
+  microdisc_init(&md, eprom, overlay_ram, track_data);
+  HOST_CHECK(microdisc_insert_disk_sdcard(&md, 0, 0));
+  microdisc_write(&md, 4, MICRODISC_CTRL_ROMDIS);  // Drive 0, side 0
+
+  // Every track a sector comes from is loaded between frames
+  uint8_t buf[256];
+  for (int t = 0; t < TRACKS; t += 13) {
+    seek(t);
+    for (int s = 1; s <= SECTORS; s += 5) {
+      HOST_CHECK(read_sector(s, buf));
+      bool same = true;
+      for (int i = 0; i < 256; i++) {
+        same &= buf[i] == sector_byte(t, s, i);
+      }
+      HOST_CHECK(same);
+    }
+  }
+  // No track on the way of a seek is loaded
+  HOST_CHECK(md.track_loads == (TRACKS + 12) / 13);
+
+  // A written sector is on the card after the update that follows the
+  // command, and nothing reached the card while the FDC ran
+  seek(7);
+  for (int i = 0; i < 256; i++) {
+    buf[i] = (uint8_t)(0xFF - i);
+  }
+  HOST_CHECK(write_sector(4, buf));
+  frame();
+  HOST_CHECK(ff_posix_stats.locked_calls == 0);
+  HOST_CHECK(ff_posix_stats.syncs > 0);
+  ff_posix_power_loss();
+
+  size_t size = 0;
+  uint8_t* image = host_read_file(path, &size);
+  HOST_CHECK(image != NULL);
+  if (image) {
+    const uint8_t* track = &image[256 + 7 * MICRODISC_TRACK_SIZE];
+    bool found = false;
+    for (int p = 0; p + 256 < MICRODISC_TRACK_SIZE; p++) {
+      if ((track[p] == 0xFB) && (memcmp(&track[p + 1], buf, 256) == 0)) {
+        found = true;
+      }
+    }
+    HOST_CHECK(found);
+    free(image);
+  }
+  return HOST_RESULT();
+}
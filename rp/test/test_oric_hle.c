@@ -0,0 +1,258 @@
+// test_oric_hle.c
+//
+// The instruction-stepped core of the ROM fast path in lockstep with the
+// cycle-stepped mos6502cpu: a random instruction stream runs one instruction
+// at a time through both, then every trap of the known ROM tables runs a
+// made-up routine from its entry point to its RTS. Registers, the bytes
+// written and the cycle counts must match. The turbo cost of a class scales
+// only the cycles charged.
+
+#define CHIPS_IMPL
+#include "pico.h"
+#include "debug.h"
+#include "chips/mem.h"
+#include "chips/mos6502cpu.h"
+#include "devices/oric_hle.h"
+
+#include <string.h>
+
+#include "host.h"
+
+// Memory of the cycle-stepped core and of the fast path
+static uint8_t ram_cyc[0x10000];
+static uint8_t ram_hle[0x10000];
+static mem_t mem_hle;
+static oric_hle_t hle;
+
+// Writes of the last cycle-stepped instruction
+static uint16_t writes[16];
+static int num_writes;
+
+static uint32_t seed = 27;
+
+static uint8_t rnd(void) {
+  seed = seed * 1103515245u + 12345u;
+  return (uint8_t)(seed >> 16);
+}
+
+// Stop c at SYNC on pc, as if its opcode fetch had just happened
+static void at_sync(mos6502cpu_t* c, uint16_t pc) {
+  c->PC = pc;
+  c->addr = pc;
+  c->rw = true;
+  c->sync = true;
+  c->data = ram_cyc[pc];
+}
+
+// Tick the cycle-stepped core to the next SYNC, returns the cycles
+static uint32_t cyc_step(mos6502cpu_t* c) {
+  uint32_t cycles = 0;
+  num_writes = 0;
+  do {
+    mos6502cpu_tick(c);
+    cycles++;
+    if (c->rw) {
+      c->data = ram_cyc[c->addr];
+    } else {
+      ram_cyc[c->addr] = c->data;
+      if (num_writes < 16) {
+        writes[num_writes++] = c->addr;
+      }
+    }
+  } while (!c->sync && (cycles < 16));
+  return cycles;
+}
+
+static bool same_regs(mos6502cpu_t* a, mos6502cpu_t* b) {
+  return (a->PC == b->PC) && (a->A == b->A) && (a->X == b->X) &&
+         (a->Y == b->Y) && (a->S == b->S) &&
+         ((_get_flags(a) & 0xCF) == (_get_flags(b) & 0xCF));
+}
+
+static void report(const char* what, uint16_t pc, uint8_t op) {
+  if (host_failures++ < 4) {
+    fprintf(stderr, "%s differs after $%02X at $%04X\n", what, op, pc);
+  }
+}
+
+// Random registers and flags, the I flag set like the ROM routines run
+static void random_regs(mos6502cpu_t* c) {
+  c->A = rnd();
+  c->X = rnd();
+  c->Y = rnd();
+  c->S = rnd();
+  _set_flags(c, rnd() | 0x04);
+}
+
+// One instruction on both cores. Opcodes the fast path leaves to the cycle
+// core are replaced with other random bytes. Returns false if no
+// instruction ran.
+static bool lockstep(mos6502cpu_t* cyc) {
+  const uint16_t pc = cyc->PC;
+  for (int attempt = 0; attempt < 64; attempt++) {
+    mos6502cpu_t h = *cyc;
+    bool returned;
+    const uint32_t n =
+        _oric_hle_exec(&hle, &h, &mem_hle, (uint8_t)(h.S + 2), 1, -1,
+                       &returned);
+    if (n == 0) {
+      ram_cyc[pc] = ram_hle[pc] = rnd();
+      at_sync(cyc, pc);
+      continue;
+    }
+    const uint8_t op = ram_cyc[pc];
+    const uint32_t cycles = cyc_step(cyc);
+    if (cycles != n) {
+      report("cycle count", pc, op);
+    }
+    if (!same_regs(cyc, &h)) {
+      report("registers", pc, op);
+    }
+    for (int i = 0; i < num_writes; i++) {
+      if (ram_hle[writes[i]] != ram_cyc[writes[i]]) {
+        report("memory write", pc, op);
+      }
+    }
+    return true;
+  }
+  return false;
+}
+
+static void random_stream(int programs, int length) {
+  int stopped = 0;
+  for (int p = 0; p < programs; p++) {
+    for (size_t i = 0; i < sizeof(ram_cyc); i++) {
+      ram_cyc[i] = rnd();
+    }
+    memcpy(ram_hle, ram_cyc, sizeof(ram_hle));
+    mos6502cpu_t cyc;
+    mos6502cpu_init(&cyc, &(mos6502cpu_desc_t){0});
+    cyc.res = false;
+    random_regs(&cyc);
+    at_sync(&cyc, (uint16_t)(rnd() | (rnd() << 8)));
+    for (int i = 0; i < length; i++) {
+      // Code on the I/O page stays on the cycle core, start elsewhere
+      if (!lockstep(&cyc)) {
+        stopped++;
+        at_sync(&cyc, (uint16_t)(rnd() | (rnd() << 8)));
+      }
+    }
+    if (memcmp(ram_cyc, ram_hle, sizeof(ram_cyc)) != 0 &&
+        (host_failures++ < 4)) {
+      fprintf(stderr, "program %d: memory differs\n", p);
+    }
+  }
+  printf("  %d random programs of %d instructions, %d restarts\n", programs,
+         length, stopped);
+}
+
+// A made-up routine for a trap: copies count bytes through a subroutine
+// that mixes them into a checksum, with the stack and index registers
+static const uint8_t routine[] = {
+    0x48,              // PHA
+    0x8A,              // TXA
+    0x48,              // PHA
+    0xA0, 0x00,        // LDY #0
+    0xB1, 0xF0,        // loop: LDA ($F0),Y
+    0x20, 0x00, 0x00,  // JSR sub
+    0x91, 0xF2,        // STA ($F2),Y
+    0xC8,              // INY
+    0xC0, 0x00,        // CPY #count
+    0xD0, 0xF4,        // BNE loop
+    0x68,              // PLA
+    0xAA,              // TAX
+    0x68,              // PLA
+    0x60,              // RTS
+    0x49, 0x5A,        // sub: EOR #$5A
+    0x2A,              // ROL A
+    0x65, 0xF4,        // ADC $F4
+    0x85, 0xF4,        // STA $F4
+    0x60,              // RTS
+};
+
+#define CALLER (0x0400)
+
+// Run the routine at a trap address from a JSR on both cores
+static void run_trap(const oric_hle_rom_t* rom, const oric_hle_trap_t* trap) {
+  for (size_t i = 0; i < sizeof(ram_cyc); i++) {
+    ram_cyc[i] = rnd();
+  }
+  memcpy(&ram_cyc[trap->pc], routine, sizeof(routine));
+  const uint16_t sub = (uint16_t)(trap->pc + 21);
+  ram_cyc[trap->pc + 8] = (uint8_t)sub;
+  ram_cyc[trap->pc + 9] = (uint8_t)(sub >> 8);
+  ram_cyc[trap->pc + 14] = (uint8_t)(1 + rnd() % 255);
+  ram_cyc[0xF0] = rnd();
+  ram_cyc[0xF1] = (uint8_t)(0x10 + rnd() % 0x80);
+  ram_cyc[0xF2] = 0x80;
+  ram_cyc[0xF3] = 0xBB;
+  const uint8_t jsr[3] = {0x20, (uint8_t)trap->pc, (uint8_t)(trap->pc >> 8)};
+  memcpy(&ram_cyc[CALLER], jsr, sizeof(jsr));
+
+  mos6502cpu_t cyc;
+  mos6502cpu_init(&cyc, &(mos6502cpu_desc_t){0});
+  cyc.res = false;
+  random_regs(&cyc);
+  cyc.S = (uint8_t)(0x20 + rnd() % 0xD0);
+  at_sync(&cyc, CALLER);
+  cyc_step(&cyc);
+  HOST_CHECK(cyc.PC == trap->pc);
+  memcpy(ram_hle, ram_cyc, sizeof(ram_hle));
+
+  // The fast path from the trap up to its return
+  hle.rom = rom;
+  oric_hle_set_classes(&hle, 0xFF);
+  HOST_CHECK(oric_hle_find(&hle, cyc.PC) == trap);
+  mos6502cpu_t h = cyc;
+  const uint32_t calls = hle.calls;
+  const uint32_t run = hle.cycles_run;
+  const uint32_t charged = oric_hle_run(&hle, trap, &h, &mem_hle, 100000);
+  const uint32_t n = hle.cycles_run - run;
+  HOST_CHECK((hle.calls == calls + 1) && (hle.aborts == 0));
+  HOST_CHECK(charged == n * hle.turbo[trap->cls] / 100u);
+
+  // The cycle-stepped core until it is back after the JSR
+  uint32_t cycles = 0;
+  while ((cyc.PC != CALLER + 3) && (cycles < 100000)) {
+    cycles += cyc_step(&cyc);
+  }
+  if ((n != cycles) || !same_regs(&cyc, &h) ||
+      (memcmp(ram_cyc, ram_hle, sizeof(ram_cyc)) != 0)) {
+    if (host_failures++ < 4) {
+      fprintf(stderr, "%s trap $%04X: %u cycles, fast path %u\n", rom->name,
+              trap->pc, cycles, n);
+    }
+  }
+}
+
+int main(void) {
+  memset(&hle, 0, sizeof(hle));
+  oric_hle_init(&hle, ram_hle, 0x4000);
+  mem_init(&mem_hle);
+  mem_map_ram(&mem_hle, 0, 0x0000, 0x10000, ram_hle);
+
+  random_stream(2000, 500);
+
+  const size_t num_roms = sizeof(_oric_hle_roms) / sizeof(oric_hle_rom_t);
+  int traps = 0;
+  for (size_t r = 0; r < num_roms; r++) {
+    const oric_hle_rom_t* rom = &_oric_hle_roms[r];
+    for (int t = 0; t < rom->num_traps; t++) {
+      for (int i = 0; i < 20; i++) {
+        run_trap(rom, &rom->traps[t]);
+      }
+      traps++;
+    }
+  }
+  printf("  %d traps\n", traps);
+
+  // A turbo cost scales what is charged, not what runs
+  for (int cls = 0; cls < ORIC_HLE_NUM_CLASSES; cls++) {
+    oric_hle_set_turbo(&hle, (oric_hle_class_t)cls, 25);
+  }
+  for (int t = 0; t < _oric_hle_roms[0].num_traps; t++) {
+    run_trap(&_oric_hle_roms[0], &_oric_hle_roms[0].traps[t]);
+  }
+  HOST_CHECK(hle.cycles_charged < hle.cycles_run);
+  return HOST_RESULT();
+}
@@ -0,0 +1,122 @@
+// test_oric_hle_rom.c
+//
+// The trap tables of the ROM fast path against the real ROM images. Each
+// image must be identified by its CRC, then boots in the ORIC_HLE_VERIFY
+// build and types BASIC that clears the screen, prints, scrolls and inserts
+// program lines. Every trap of the table must be reached as a routine entry:
+// the dry run returns through RTS, and the ROM running normally must come
+// back to the same registers and memory.
+//
+// The images are not in the repository. The test is skipped unless
+// ORIC_ROM names the Atmos BASIC 1.1 image and ORIC1_ROM the Oric-1
+// BASIC 1.0 image.
+//
+//   ORIC_ROM=basic11b.rom ORIC1_ROM=basic10.rom ./test_oric_hle_rom
+
+#define ORIC_HLE_VERIFY
+#include "oric_host.h"
+
+#define SKIPPED (77)
+#define MAX_TRAPS (16)
+
+static oric_t sys;
+
+// Verified runs of each trap
+static uint32_t passed[MAX_TRAPS];
+static uint32_t failed[MAX_TRAPS];
+
+// Index of the trap a pending verification belongs to
+static int pending = -1;
+
+static int trap_index(uint16_t pc) {
+  const oric_hle_rom_t* rom = sys.hle.rom;
+  for (int i = 0; i < rom->num_traps; i++) {
+    if (rom->traps[i].pc == pc) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+// Tick whole frames and credit each verification to its trap
+static void run_frames(uint32_t frames) {
+  for (uint32_t f = 0; f < frames; f++) {
+    for (uint32_t i = 0; i < ORIC_HOST_FRAME_CYCLES; i++) {
+      const uint32_t ok = sys.hle.verify.passed;
+      const uint32_t bad = sys.hle.verify.failed;
+      const bool was_pending = sys.hle.verify.pending;
+      oric_tick(&sys);
+      if (pending >= 0) {
+        passed[pending] += sys.hle.verify.passed - ok;
+        failed[pending] += sys.hle.verify.failed - bad;
+      }
+      if (!was_pending && sys.hle.verify.pending) {
+        pending = trap_index(sys.cpu.PC);
+      }
+    }
+    oric_kbd_update(&sys.kbd);
+  }
+}
+
+static void type(const char* text) {
+  for (const char* c = text; *c; c++) {
+    const int key = (*c == '\n') ? 0x0D : *c;
+    oric_kbd_key_down(&sys.kbd, key);
+    run_frames(2);
+    oric_key_up(&sys, key);
+    run_frames(2);
+  }
+}
+
+// Boot the image in oric_rom and exercise every trap
+static void check_rom(const char* var) {
+  oric_desc_t desc = {
+      .hle_classes = ORIC_HLE_CLASS_BIT(ORIC_HLE_SCREEN) |
+                     ORIC_HLE_CLASS_BIT(ORIC_HLE_MEMORY),
+  };
+  oric_host_init(&sys, &desc);
+  if (sys.hle.rom == NULL) {
+    fprintf(stderr, "%s: CRC %08X is not a known ROM\n", var,
+            (unsigned)sys.hle.rom_crc);
+    host_failures++;
+    return;
+  }
+  memset(passed, 0, sizeof(passed));
+  memset(failed, 0, sizeof(failed));
+  pending = -1;
+  run_frames(150);  // Boot to Ready
+  type("CLS\n");
+  type("20 REM B\n10 REM A\n15 REM C\n");
+  type("FOR I=1 TO 40:PRINT I:NEXT\n");
+  run_frames(100);
+
+  const oric_hle_rom_t* rom = sys.hle.rom;
+  printf("  %s, %u verified, %u failed, %u skipped\n", rom->name,
+         sys.hle.verify.passed, sys.hle.verify.failed,
+         sys.hle.verify.skipped);
+  for (int i = 0; i < rom->num_traps; i++) {
+    const bool ok = (passed[i] > 0) && (failed[i] == 0);
+    printf("    $%04X: %u passed, %u failed%s\n", rom->traps[i].pc, passed[i],
+           failed[i], ok ? "" : ", WRONG");
+    if (!ok) {
+      host_failures++;
+    }
+  }
+}
+
+int main(void) {
+  bool tested = false;
+  if (oric_host_load_rom("ORIC_ROM")) {
+    check_rom("ORIC_ROM");
+    tested = true;
+  }
+  if (oric_host_load_rom("ORIC1_ROM")) {
+    check_rom("ORIC1_ROM");
+    tested = true;
+  }
+  if (!tested) {
+    printf("ORIC_ROM and ORIC1_ROM not set, skipped\n");
+    return SKIPPED;
+  }
+  return HOST_RESULT();
+}
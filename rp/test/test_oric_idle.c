@@ -0,0 +1,209 @@
+// test_oric_idle.c
+//
+// The idle loop skip of oric.h. A loop that only reads memory is skipped up
+// to the next VIA interrupt and reaches it in the same state as ticking
+// every cycle. Loops that write, read I/O or change registers fail the
+// probe. Nothing is skipped while the tape motor runs or the WD1793 is busy.
+// A rejected loop is probed again when the CPU comes back to it from an
+// interrupt, or after the ROM paging has changed.
+
+#include "oric_host.h"
+
+static oric_t sys;
+static oric_t ref;
+static uint8_t eprom[MICRODISC_EPROM_SIZE];
+
+// The loops, each one branches back to its start while $10 stays 0
+static const uint8_t _idle[] = {0xA5, 0x10, 0xF0, 0xFC};  // LDA $10 BEQ
+static const uint8_t _write[] = {0x85, 0x12,              // STA $12
+                                 0xA5, 0x10, 0xF0, 0xFA};
+static const uint8_t _io[] = {0xAD, 0x00, 0x03,  // LDA ORB
+                              0xA5, 0x10, 0xF0, 0xF9};
+static const uint8_t _regs[] = {0xE8,  // INX
+                                0xA5, 0x10, 0xF0, 0xFB};
+
+// IRQ handler at org + $100: LDA T1L to acknowledge, INC $11, RTI
+static const uint8_t _irq[] = {0xAD, 0x04, 0x03, 0xE6, 0x11, 0x40};
+
+// A handler that patches INX at $0400 to NOP before INC $11
+static const uint8_t _patch_irq[] = {0xAD, 0x04, 0x03, 0xA9, 0xEA, 0x8D,
+                                     0x00, 0x04, 0xE6, 0x11, 0x40};
+
+typedef struct {
+  uint8_t* image;  // oric_rom at $C000 or the Microdisc EPROM at $E000
+  size_t size;
+  size_t pos;
+} _rom_t;
+
+static void emit(_rom_t* r, const uint8_t* code, size_t n) {
+  memcpy(&r->image[r->pos], code, n);
+  r->pos += n;
+}
+
+// STA abs of an immediate value
+static void poke(_rom_t* r, uint16_t addr, uint8_t value) {
+  const uint8_t code[] = {0xA9, value, 0x8D, (uint8_t)addr,
+                          (uint8_t)(addr >> 8)};
+  emit(r, code, sizeof(code));
+}
+
+// PSG bus inactive like the ROM leaves it, T1 interrupt every 10 ms, the
+// extra setup, then the loop from org
+static void make_rom(_rom_t* r, uint16_t org, void (*setup)(_rom_t*),
+                     const uint8_t* loop, size_t n, const uint8_t* irq,
+                     size_t irq_size) {
+  memset(r->image, 0xEA, r->size);
+  r->pos = 0;
+  poke(r, 0x030C, 0xDD);  // PCR: CA2 and CB2 low
+  poke(r, 0x030B, 0x40);  // ACR: T1 free run
+  poke(r, 0x0304, 0x10);
+  poke(r, 0x0305, 0x27);
+  poke(r, 0x030E, 0xC0);  // IER: T1
+  if (setup) {
+    setup(r);
+  }
+  const uint8_t cli = 0x58;
+  emit(r, &cli, 1);
+  emit(r, loop, n);
+  memcpy(&r->image[0x100], irq, irq_size);
+  r->image[r->size - 4] = (uint8_t)org;
+  r->image[r->size - 3] = (uint8_t)(org >> 8);
+  r->image[r->size - 2] = 0x00;
+  r->image[r->size - 1] = (uint8_t)((org >> 8) + 1);
+}
+
+static void make_basic_rom(void (*setup)(_rom_t*), const uint8_t* loop,
+                           size_t n) {
+  _rom_t r = {oric_rom, sizeof(oric_rom), 0};
+  make_rom(&r, 0xC000, setup, loop, n, _irq, sizeof(_irq));
+}
+
+static void init(oric_t* s, bool idle) {
+  oric_desc_t desc = {.idle_skip_enabled = idle};
+  oric_host_init(s, &desc);
+}
+
+// Tick up to the nth interrupt handled, counted in $11
+static void run_to_irq(oric_t* s, uint8_t n) {
+  for (uint32_t i = 0; (s->ram[0x11] != n) && (i < 10000000); i++) {
+    oric_tick(s);
+  }
+}
+
+static bool same_state(void) {
+  return (sys.system_ticks == ref.system_ticks) &&
+         (sys.cpu.PC == ref.cpu.PC) && (sys.cpu.A == ref.cpu.A) &&
+         (sys.cpu.X == ref.cpu.X) && (sys.cpu.Y == ref.cpu.Y) &&
+         (sys.cpu.S == ref.cpu.S) &&
+         (_get_flags(&sys.cpu) == _get_flags(&ref.cpu)) &&
+         (sys.via.t1.counter == ref.via.t1.counter) &&
+         (sys.via.intr.ifr == ref.via.intr.ifr) &&
+         (memcmp(sys.ram, ref.ram, sizeof(sys.ram)) == 0);
+}
+
+// Run the loop with and without the skip to each of the next interrupts,
+// both machines must be in the same state there. Returns the cycles
+// skipped.
+static uint32_t check_loop(const char* name, const uint8_t* loop, size_t n) {
+  make_basic_rom(NULL, loop, n);
+  init(&sys, true);
+  init(&ref, false);
+  for (uint8_t irq = 1; irq <= 5; irq++) {
+    run_to_irq(&sys, irq);
+    run_to_irq(&ref, irq);
+    if (!same_state() && (host_failures++ < 4)) {
+      fprintf(stderr, "%s loop: state differs at interrupt %u\n", name, irq);
+    }
+  }
+  HOST_CHECK(ref.idle.frame_skipped == 0);
+  printf("  %-5s loop: %u cycles skipped\n", name, sys.idle.frame_skipped);
+  return sys.idle.frame_skipped;
+}
+
+static void motor_on(_rom_t* r) {
+  poke(r, 0x0302, 0xFF);  // DDRB
+  poke(r, 0x0300, 0x40);  // ORB: motor
+}
+
+// SEEK to track 39 at 30 ms a step keeps the WD1793 busy about a second
+static void long_seek(_rom_t* r) {
+  poke(r, 0x0313, 39);
+  poke(r, 0x0310, 0x13);
+}
+
+// Frames until the skip starts, or frames + 1 if it never does
+static uint32_t frames_to_skip(uint32_t frames) {
+  for (uint32_t f = 0; f < frames; f++) {
+    const uint32_t skipped = sys.idle.frame_skipped;
+    for (uint32_t i = 0; i < ORIC_HOST_FRAME_CYCLES; i++) {
+      oric_tick(&sys);
+    }
+    if (sys.idle.frame_skipped != skipped) {
+      return f;
+    }
+  }
+  return frames + 1;
+}
+
+static void check_motor(void) {
+  make_basic_rom(motor_on, _idle, sizeof(_idle));
+  oric_desc_t desc = {.idle_skip_enabled = true, .td_enabled = true};
+  oric_host_init(&sys, &desc);
+  HOST_CHECK(frames_to_skip(50) == 51);
+  // Motor off through ORB, the next loop is skipped
+  sys.via.pb.outr &= (uint8_t)~0x40;
+  HOST_CHECK(frames_to_skip(5) <= 1);
+}
+
+// The WD1793 seeks in the Microdisc EPROM, which is paged in at reset
+static void check_fdc_busy(void) {
+  _rom_t r = {eprom, sizeof(eprom), 0};
+  make_rom(&r, 0xE000, long_seek, _idle, sizeof(_idle), _irq, sizeof(_irq));
+  oric_desc_t desc = {.idle_skip_enabled = true, .microdisc_enabled = true};
+  desc.roms.microdisc_rom.ptr = eprom;
+  desc.roms.microdisc_rom.size = sizeof(eprom);
+  oric_host_init(&sys, &desc);
+  const uint32_t frames = frames_to_skip(200);
+  printf("  WD1793 busy: skip starts after %u frames\n", frames);
+  HOST_CHECK((frames > 40) && (frames <= 200));
+  HOST_CHECK(!wd1793fdc_busy(&sys.md.fdc));
+
+  // A paging change forgets a rejected loop
+  sys.idle.reject_pc = 0xE010;
+  MOS6502CPU_SET_DATA(&sys.cpu, MICRODISC_CTRL_ROMDIS);
+  _oric_io_rw(&sys, 0x0314, false);
+  HOST_CHECK(sys.idle.reject_pc == 0);
+}
+
+// The loop at $0400 changes X until the first interrupt patches it, it is
+// probed again after the return
+static void patch_loop(_rom_t* r) {
+  for (size_t i = 0; i < sizeof(_regs); i++) {
+    poke(r, (uint16_t)(0x0400 + i), _regs[i]);
+  }
+}
+
+static void check_reprobe(void) {
+  static const uint8_t jmp[] = {0x4C, 0x00, 0x04};  // JMP $0400
+  _rom_t r = {oric_rom, sizeof(oric_rom), 0};
+  make_rom(&r, 0xC000, patch_loop, jmp, sizeof(jmp), _patch_irq,
+           sizeof(_patch_irq));
+  init(&sys, true);
+  run_to_irq(&sys, 1);
+  HOST_CHECK(sys.idle.frame_skipped == 0);
+  HOST_CHECK(sys.ram[0x0400] == 0xEA);
+  run_to_irq(&sys, 3);
+  printf("  patched loop: %u cycles skipped\n", sys.idle.frame_skipped);
+  HOST_CHECK(sys.idle.frame_skipped > 0);
+}
+
+int main(void) {
+  HOST_CHECK(check_loop("idle", _idle, sizeof(_idle)) > 0);
+  HOST_CHECK(check_loop("write", _write, sizeof(_write)) == 0);
+  HOST_CHECK(check_loop("I/O", _io, sizeof(_io)) == 0);
+  HOST_CHECK(check_loop("regs", _regs, sizeof(_regs)) == 0);
+  check_motor();
+  check_fdc_busy();
+  check_reprobe();
+  return HOST_RESULT();
+}
@@ -0,0 +1,188 @@
+// test_oric_kbd.c
+//
+// The Oric keyboard bitboard against the generic kbd_t matrix it replaced,
+// set up here with the old key map: every key senses on the same rows and
+// columns, Shift and Ctrl included, and no other key code is accepted. Ten
+// keys down at once all sense. A key released in the frame it was pressed
+// in stays down until the second oric_kbd_update(), and a key released by
+// its other shift state is freed.
+
+#define CHIPS_IMPL
+#include "chips/kbd.h"
+#include "devices/oric_kbd.h"
+
+#include <string.h>
+
+#include "host.h"
+
+static kbd_t ref;
+static oric_kbd_t kbd;
+
+// The key registration of oric.h before oric_kbd.h
+static void ref_init(void) {
+  kbd_init(&ref, 2);
+  const char* keymap =
+      // no shift
+      //   01234567 (col)
+      "7N5V 1X3"   // row 0
+      "JTRF  QD"   // row 1
+      "M6B4 Z2C"   // row 2
+      "K9;-  \\'"  // row 3
+      " <>     "   // row 4
+      "UIOP  ]["   // row 5
+      "YHGE ASW"   // row 6
+      "8L0/   ="   // row 7
+
+      /* shift */
+      "&n%v !x#"
+      "jtrf  qd"
+      "m^b$ z@c"
+      "k(:_  |\""
+      " ,.     "
+      "uiop  }{"
+      "yhge asw"
+      "*l)?   +";
+
+  kbd_register_modifier(&ref, 0, 4, 4);  // Shift
+  kbd_register_modifier(&ref, 1, 4, 2);  // Ctrl
+  for (int shift = 0; shift < 2; shift++) {
+    for (int column = 0; column < 8; column++) {
+      for (int line = 0; line < 8; line++) {
+        int c = keymap[shift * 64 + line * 8 + column];
+        if (c != 0x20) {
+          kbd_register_key(&ref, c, column, line, shift ? (1 << 0) : 0);
+        }
+      }
+    }
+  }
+  kbd_register_key(&ref, 0x20, 0, 4, 0);
+  kbd_register_key(&ref, ORIC_KEY_LEFT, 5, 4, 0);
+  kbd_register_key(&ref, ORIC_KEY_RIGHT, 7, 4, 0);
+  kbd_register_key(&ref, ORIC_KEY_DOWN, 6, 4, 0);
+  kbd_register_key(&ref, ORIC_KEY_UP, 3, 4, 0);
+  kbd_register_key(&ref, 0x08, 5, 5, 0);
+  kbd_register_key(&ref, 0x0D, 5, 7, 0);
+  kbd_register_key(&ref, ORIC_KEY_CTRL, 4, 2, 0);
+  kbd_register_key(&ref, ORIC_KEY_SHIFT, 4, 4, 0);
+  kbd_register_key(&ref, 0x14, 1, 1, 2);
+  kbd_register_key(&ref, 0x10, 3, 5, 2);
+  kbd_register_key(&ref, 0x06, 3, 1, 2);
+  kbd_register_key(&ref, 0x04, 7, 1, 2);
+  kbd_register_key(&ref, 0x11, 6, 1, 2);
+  kbd_register_key(&ref, 0x13, 6, 6, 2);
+  kbd_register_key(&ref, 0x0C, 1, 7, 2);
+  kbd_register_key(&ref, 0x0E, 1, 0, 2);
+}
+
+// The sense line of the ROM scan: row selected, one column at a time
+static bool sensed(int row, int column) {
+  oric_kbd_set_columns(&kbd, (uint8_t)(1u << column));
+  return oric_kbd_sense(&kbd, row);
+}
+
+// The rows and columns a single key senses on, both keyboards the same
+static void check_keys(void) {
+  int keys = 0;
+  for (int key = 0; key < KBD_MAX_KEYS; key++) {
+    ref_init();
+    oric_kbd_init(&kbd);
+    const bool known = ref.key_masks[key] != 0;
+    if (oric_kbd_key_down(&kbd, key) != known) {
+      if (host_failures++ < 4) {
+        fprintf(stderr, "key $%03X: %s\n", key,
+                known ? "not accepted" : "accepted, not on the Oric");
+      }
+      continue;
+    }
+    if (!known) {
+      continue;
+    }
+    keys++;
+    kbd_key_down(&ref, key);
+    for (int row = 0; row < 8; row++) {
+      for (int column = 0; column < 8; column++) {
+        const bool expected =
+            kbd_test_lines(&ref, (uint16_t)(1u << column)) == (1u << row);
+        if ((sensed(row, column) != expected) && (host_failures++ < 4)) {
+          fprintf(stderr, "key $%03X: row %d column %d %s\n", key, row,
+                  column, expected ? "not sensed" : "sensed");
+        }
+      }
+    }
+  }
+  printf("  %d keys\n", keys);
+  HOST_CHECK(keys == 109);
+}
+
+// Ten keys on ten different matrix positions, all down at once
+static void check_rollover(void) {
+  static const char keys[] = "QWERTYUIOP";
+  static const int pos[10][2] = {{1, 6}, {6, 7}, {6, 3}, {1, 2}, {1, 1},
+                                 {6, 0}, {5, 0}, {5, 1}, {5, 2}, {5, 3}};
+  oric_kbd_init(&kbd);
+  for (int i = 0; i < 10; i++) {
+    HOST_CHECK(oric_kbd_key_down(&kbd, keys[i]));
+  }
+  oric_kbd_update(&kbd);
+  for (int i = 0; i < 10; i++) {
+    HOST_CHECK(sensed(pos[i][0], pos[i][1]));
+  }
+  // Releasing one leaves the other nine
+  oric_kbd_key_up(&kbd, 'E');
+  HOST_CHECK(!sensed(6, 3));
+  HOST_CHECK(sensed(6, 7) && sensed(1, 2));
+}
+
+static void check_release(void) {
+  // A short press: 'A' is row 6, column 5
+  oric_kbd_init(&kbd);
+  oric_kbd_key_down(&kbd, 'A');
+  oric_kbd_key_up(&kbd, 'A');
+  HOST_CHECK(sensed(6, 5));
+  oric_kbd_update(&kbd);
+  HOST_CHECK(sensed(6, 5));
+  oric_kbd_update(&kbd);
+  HOST_CHECK(!sensed(6, 5));
+
+  // Pressed again before the deferred release, it stays down
+  oric_kbd_key_down(&kbd, 'A');
+  oric_kbd_key_up(&kbd, 'A');
+  oric_kbd_update(&kbd);
+  oric_kbd_key_down(&kbd, 'A');
+  oric_kbd_update(&kbd);
+  oric_kbd_update(&kbd);
+  HOST_CHECK(sensed(6, 5));
+
+  // A key held over a frame goes up at once
+  oric_kbd_key_up(&kbd, 'A');
+  HOST_CHECK(!sensed(6, 5));
+
+  // '1' held then released as '!', Shift goes with it
+  oric_kbd_key_down(&kbd, '1');
+  oric_kbd_update(&kbd);
+  HOST_CHECK(sensed(0, 5) && !sensed(4, 4));
+  oric_kbd_key_down(&kbd, '!');
+  HOST_CHECK(sensed(0, 5) && sensed(4, 4));
+  oric_kbd_update(&kbd);
+  oric_kbd_key_up(&kbd, '!');
+  HOST_CHECK(!sensed(0, 5) && !sensed(4, 4));
+
+  // Shift held on its own outlasts a shifted key
+  oric_kbd_key_down(&kbd, ORIC_KEY_SHIFT);
+  oric_kbd_key_down(&kbd, '@');
+  oric_kbd_update(&kbd);
+  oric_kbd_key_up(&kbd, '@');
+  HOST_CHECK(!sensed(2, 6) && sensed(4, 4));
+  oric_kbd_key_up(&kbd, ORIC_KEY_SHIFT);
+  oric_kbd_update(&kbd);
+  oric_kbd_update(&kbd);
+  HOST_CHECK(!sensed(4, 4));
+}
+
+int main(void) {
+  HOST_CHECK(sizeof(oric_kbd_t) < 100);
+  check_keys();
+  check_rollover();
+  check_release();
+  return HOST_RESULT();
+}
@@ -0,0 +1,168 @@
+// test_oric_screen.c
+//
+// The screen renderer of oric.h against golden frames from a reference
+// renderer that follows the ULA pixel by pixel: text with serial
+// attributes, inverse, double height and blink, HIRES with attributes and
+// mode changes in the middle of a line, and random RAM, in both blink
+// phases, drawn in full and with only the blinking lines redrawn.
+
+#include "oric_host.h"
+
+#define FB_WORDS (ORIC_SCREEN_HEIGHT * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS)
+
+static oric_t sys;
+static uint16_t golden[FB_WORDS];
+
+// Put one pixel of color c into the three bitplanes of an ST line
+static void plot(uint16_t* line, int px, uint8_t c) {
+  uint16_t* w = &line[(px / 16) * ATARI_ST_BITCOLORS_PER_PIXEL];
+  const uint16_t bit = (uint16_t)(0x8000 >> (px % 16));
+  for (int plane = 0; plane < ATARI_ST_BITCOLORS_PER_PIXEL; plane++) {
+    if ((c >> plane) & 1) {
+      w[plane] |= bit;
+    } else {
+      w[plane] &= (uint16_t)~bit;
+    }
+  }
+}
+
+// The frame the ULA shows for ram, video attributes and blink phase
+static void reference(const uint8_t* ram, uint8_t pattr, bool blink) {
+  for (int y = 0; y < ORIC_SCREEN_HEIGHT; y++) {
+    uint16_t* line = &golden[y * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS];
+    uint8_t fg = 7;
+    uint8_t bg = 0;
+    uint8_t lattr = 0;
+    for (int x = 0; x < 40; x++) {
+      const bool hires = (pattr & 0x04) && (y < 200);
+      uint8_t ch = hires ? ram[0xA000 + y * 40 + x]
+                         : ram[0xBB80 + (y >> 3) * 40 + x];
+      uint8_t pat;
+      if ((ch & 0x60) == 0) {
+        // Serial attribute, takes effect on its own cell, shown as paper
+        pat = 0;
+        switch (ch & 0x18) {
+          case 0x00: fg = ch & 7; break;
+          case 0x08: lattr = ch & 7; break;
+          case 0x10: bg = ch & 7; break;
+          default: pattr = ch & 7; break;
+        }
+      } else if (hires) {
+        pat = ch;
+      } else {
+        const int row = ((lattr & 2) ? (y >> 1) : y) & 7;
+        const uint16_t set = (pattr & 0x04) ? ((lattr & 1) ? 0x9C00 : 0x9800)
+                                            : ((lattr & 1) ? 0xB800 : 0xB400);
+        pat = ram[set + (ch & 0x7F) * 8 + row];
+      }
+      uint8_t c_fg = fg;
+      uint8_t c_bg = bg;
+      if (ch & 0x80) {
+        c_fg ^= 7;
+        c_bg ^= 7;
+      }
+      if ((lattr & 4) && blink) {
+        c_fg = c_bg;
+      }
+      for (int i = 0; i < 6; i++) {
+        plot(line, x * 6 + i, ((pat >> (5 - i)) & 1) ? c_fg : c_bg);
+      }
+    }
+  }
+}
+
+static void fill_random(uint8_t* p, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    p[i] = (uint8_t)rand();
+  }
+}
+
+// Printable text with a few attributes, some lines blinking or double
+static void make_text(uint8_t* ram, int attrs) {
+  for (int i = 0xBB80; i < 0xBFE0; i++) {
+    ram[i] = (uint8_t)(0x20 + rand() % 96);
+    if (rand() % attrs == 0) {
+      ram[i] = (uint8_t)(rand() & 0x1F);  // Colors and line attributes
+    } else if (rand() % 8 == 0) {
+      ram[i] |= 0x80;
+    }
+  }
+  for (int row = 0; row < 28; row++) {
+    if (rand() % 4 == 0) {
+      ram[0xBB80 + row * 40] = (uint8_t)(0x08 | (rand() & 7));
+    }
+  }
+}
+
+// HIRES pixels with a share of attribute and inverse bytes
+static void make_hires(uint8_t* ram, int attrs) {
+  for (int i = 0xA000; i < 0xBF40; i++) {
+    ram[i] = (uint8_t)(0x40 | rand());
+    if (attrs && (rand() % attrs == 0)) {
+      ram[i] = (uint8_t)rand();
+    }
+  }
+}
+
+// Render with the blink phase given, in full and then as a blink only
+// update from the other phase, both must be the golden frame
+static void check(const char* name, int screen, uint8_t pattr) {
+  for (int phase = 0; phase < 2; phase++) {
+    reference(sys.ram, pattr, phase);
+    sys.pattr = pattr;
+    sys.screen_dirty = true;
+    sys.blink_counter = phase ? 0x20 : 0x00;
+    oric_screen_update(&sys);
+    const bool full = memcmp(sys.fb, golden, sizeof(golden)) == 0;
+    // The other phase in full, then this one on the blinking lines only
+    sys.pattr = pattr;
+    sys.screen_dirty = true;
+    sys.blink_counter = phase ? 0x00 : 0x20;
+    oric_screen_update(&sys);
+    sys.blink_counter = phase ? 0x20 : 0x00;
+    oric_screen_update(&sys);
+    const bool blink = memcmp(sys.fb, golden, sizeof(golden)) == 0;
+    if ((!full || !blink) && (host_failures++ < 4)) {
+      fprintf(stderr, "%s %d, blink %d: %s render differs\n", name, screen,
+              phase, full ? "blink only" : "full");
+    }
+  }
+}
+
+int main(void) {
+  memset(oric_rom, 0xEA, sizeof(oric_rom));
+  oric_desc_t desc = {0};
+  oric_host_init(&sys, &desc);
+  srand(41);
+
+  // An anchor for the reference: a HIRES screen of white on black pixels
+  // sets every plane bit of the first 200 lines
+  memset(&sys.ram[0xA000], 0x7F, 8000);
+  reference(sys.ram, 0x04, false);
+  bool white = true;
+  for (int i = 0; i < 200 * ATARI_ST_FRAMEBUFFER_LINE_SIZE_16WORDS; i++) {
+    white &= golden[i] == 0xFFFF;
+  }
+  HOST_CHECK(white);
+  check("white hires", 0, 0x04);
+
+  for (int screen = 0; screen < 100; screen++) {
+    fill_random(sys.ram, sizeof(sys.ram));
+    make_text(sys.ram, 40);
+    check("text", screen, 0);
+    // Character sets in the HIRES area for the text rows below it
+    check("text below hires", screen, 0x04);
+  }
+  for (int screen = 0; screen < 100; screen++) {
+    fill_random(sys.ram, sizeof(sys.ram));
+    make_hires(sys.ram, 0);
+    check("plain hires", screen, 0x04);
+    make_hires(sys.ram, 9);
+    check("hires with attributes", screen, 0x04);
+  }
+  for (int screen = 0; screen < 100; screen++) {
+    fill_random(sys.ram, sizeof(sys.ram));
+    check("random", screen, (uint8_t)(rand() & 7));
+  }
+  return HOST_RESULT();
+}
@@ -0,0 +1,83 @@
+// test_oric_tape.c
+//
+// The tape input through the VIA: with the tape event playing a TAP image,
+// CB1 flags every active edge on the cycle the level changes, and the IRQ
+// line follows on the same cycle when the CB1 interrupt is enabled. The
+// other edges and the cycles in between never set the flag.
+
+#include "oric_host.h"
+
+static oric_t sys;
+
+// Tape motor on, CB1 interrupt on rising edges, then wait with IRQs masked
+static const uint8_t _tape_rom[] = {
+    0xA9, 0xFF, 0x8D, 0x02, 0x03,  // LDA #$FF STA DDRB
+    0xA9, 0x40, 0x8D, 0x00, 0x03,  // LDA #$40 STA ORB: motor
+    0xA9, 0x10, 0x8D, 0x0C, 0x03,  // LDA #$10 STA PCR: CB1 rising
+    0xA9, 0x90, 0x8D, 0x0E, 0x03,  // LDA #$90 STA IER: CB1
+    0x4C, 0x14, 0xC0,              // loop: JMP loop
+};
+
+// A machine code program of 200 bytes at $0600
+static void make_tape(void) {
+  uint8_t tap[256];
+  size_t n = 0;
+  for (int i = 0; i < 16; i++) {
+    tap[n++] = 0x16;
+  }
+  tap[n++] = 0x24;
+  const uint8_t header[9] = {0, 0, 0x80, 0, 0x06, 0xC7, 0x06, 0x00, 0};
+  memcpy(&tap[n], header, sizeof(header));
+  n += sizeof(header);
+  memcpy(&tap[n], "CB1", 4);
+  n += 4;
+  for (int i = 0; i < 200; i++) {
+    tap[n++] = (uint8_t)(i * 37);
+  }
+  char path[512];
+  snprintf(path, sizeof(path), "%s/oric/f1.tap", host_card_dir("tape_cb1"));
+  HOST_CHECK(host_write_file(path, tap, n));
+}
+
+int main(void) {
+  memset(oric_rom, 0xEA, sizeof(oric_rom));
+  memcpy(oric_rom, _tape_rom, sizeof(_tape_rom));
+  oric_rom[0x3FFC] = 0x00;
+  oric_rom[0x3FFD] = 0xC0;
+  make_tape();
+
+  oric_desc_t desc = {.td_enabled = true};
+  oric_host_init(&sys, &desc);
+  HOST_CHECK(oric_insert_tape(&sys, 0));
+
+  uint32_t rising = 0;
+  uint32_t falling = 0;
+  for (int frame = 0; frame < 20; frame++) {
+    for (uint32_t i = 0; i < ORIC_HOST_FRAME_CYCLES; i++) {
+      const bool edge =
+          sched_pending(&sys.sched, ORIC_EVENT_TAPE) &&
+          (sys.sched.deadline[ORIC_EVENT_TAPE] == sys.system_ticks);
+      const bool level = sys.via.pb.c1_in;
+      oric_tick(&sys);
+      const bool up = edge && !level && sys.via.pb.c1_in;
+      const bool flagged = (sys.via.intr.ifr & MOS6522VIA_IRQ_CB1) != 0;
+      if ((flagged != up) || (up && !sys.cpu.irq)) {
+        if (host_failures++ < 4) {
+          fprintf(stderr, "cycle %u: CB1 %s\n", sys.system_ticks - 1,
+                  up ? "edge not flagged" : "flagged without an edge");
+        }
+      }
+      if (flagged) {
+        mos6522via_write(&sys.via, MOS6522VIA_REG_IFR, MOS6522VIA_IRQ_CB1);
+        MOS6502CPU_SET_IRQ(&sys.cpu, false);
+      }
+      rising += up;
+      falling += edge && level && !sys.via.pb.c1_in;
+    }
+    oric_td_update(&sys.td);
+  }
+  printf("  %u rising and %u falling tape edges\n", rising, falling);
+  HOST_CHECK((rising > 500) && (falling > 500));
+  HOST_CHECK(sys.td.underruns == 0);
+  return HOST_RESULT();
+}
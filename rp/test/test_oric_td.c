@@ -0,0 +1,233 @@
+// test_oric_td.c
+//
+// Tape recording of oric_td.h: a BASIC program saved through the tape
+// output is written to a TAP image between frames, and reads back through
+// the edge list the read path makes of it, decoded ahead between frames so
+// that playing never reads the card. A recording only extends the TAP image
+// the inserted tape was made from and never touches other sources.
+
+#define CHIPS_IMPL
+#include "constants.h"
+#include "hardware/structs/timer.h"
+#include "devices/oric_td.h"
+
+#include <string.h>
+
+#include "host.h"
+
+// Cycles of a PAL frame
+#define FRAME_CYCLES (19968)
+
+static oric_td_t td;
+static char dir[256];
+
+// A tokenized BASIC line: 10 PRINT "HI"
+static const uint8_t program[] = {0x0A, 0x05, 0x0A, 0x00, 0xBA,
+                                  0x22, 0x48, 0x49, 0x22, 0x00,
+                                  0x00, 0x00};
+
+static void init_td(void) {
+  memset(&td, 0, sizeof(td));
+  oric_td_init(&td);
+}
+
+static const char* card_path(const char* name) {
+  static char path[512];
+  snprintf(path, sizeof(path), "%s/oric/%s", dir, name);
+  return path;
+}
+
+static bool card_has(const char* name) {
+  FILE* file = fopen(card_path(name), "rb");
+  if (file) {
+    fclose(file);
+  }
+  return file != NULL;
+}
+
+// The TAP bytes CSAVE writes for a BASIC program loaded at $0501
+static size_t tap_file(const char* name, uint8_t* out) {
+  const uint16_t start = 0x0501;
+  const uint16_t end = (uint16_t)(start + sizeof(program) - 1);
+  size_t n = 0;
+  for (int i = 0; i < 3; i++) {
+    out[n++] = 0x16;
+  }
+  out[n++] = 0x24;
+  const uint8_t header[9] = {0, 0, 0, 0, end >> 8, end & 0xFF,
+                             start >> 8, start & 0xFF, 0};
+  memcpy(&out[n], header, sizeof(header));
+  n += sizeof(header);
+  memcpy(&out[n], name, strlen(name) + 1);
+  n += strlen(name) + 1;
+  memcpy(&out[n], program, sizeof(program));
+  return n + sizeof(program);
+}
+
+// Drive the tape output like CSAVE: leader, then every byte as its cell,
+// with the card locked, then let the updates of the next frames write it
+static void csave(const char* name) {
+  uint8_t bytes[64];
+  const size_t len = tap_file(name, bytes);
+  static uint32_t now = 100000;
+  ff_posix_lock(true);
+  now += 10000;
+  oric_td_write_edge(&td, now);  // Motor start, silence
+  for (int i = 0; i < 16; i++) {
+    for (uint8_t pos = 0; pos < ORIC_TD_CELL_HALF_PERIODS; pos++) {
+      now += oric_td_cell_run(0x16, pos) * ORIC_TD_UNIT_CYCLES;
+      oric_td_write_edge(&td, now);
+    }
+  }
+  // The leader has the synchro bytes, go on from 0x24
+  for (size_t i = 3; i < len; i++) {
+    for (uint8_t pos = 0; pos < ORIC_TD_CELL_HALF_PERIODS; pos++) {
+      now += oric_td_cell_run(bytes[i], pos) * ORIC_TD_UNIT_CYCLES;
+      oric_td_write_edge(&td, now);
+    }
+  }
+  ff_posix_lock(false);
+  HOST_CHECK(td.rec_done);
+  for (int frame = 0; (frame < 8) && (td.rec_done || td.rec_open); frame++) {
+    oric_td_update(&td);
+  }
+  HOST_CHECK(!td.rec_done && !td.rec_open);
+  HOST_CHECK(td.rec_errors == 0);
+}
+
+// Play the inserted tape with an update every frame and decode its byte
+// cells, returns the bytes read
+static size_t play(uint8_t* out, size_t size) {
+  td.port |= ORIC_TD_PORT_MOTOR;
+  td.underruns = 0;
+  size_t n = 0;
+  int cell = -1;  // Half periods of the byte cell seen, -1 outside a cell
+  uint8_t runs[ORIC_TD_CELL_HALF_PERIODS];
+  uint32_t frame = 0;
+  while (n < size) {
+    if (frame >= FRAME_CYCLES) {
+      oric_td_update(&td);
+      frame -= FRAME_CYCLES;
+    }
+    const uint32_t reads = ff_posix_stats.reads;
+    const uint32_t cycles = oric_td_next_edge_sdcard(&td);
+    HOST_CHECK(ff_posix_stats.reads == reads);
+    if (cycles == 0) {
+      break;
+    }
+    frame += cycles;
+    const uint32_t run =
+        (cycles + ORIC_TD_UNIT_CYCLES / 2) / ORIC_TD_UNIT_CYCLES;
+    if (cell < 0) {
+      // A cell starts with two short half periods and a long one
+      cell = (run == 2) ? 3 : -1;
+      continue;
+    }
+    runs[cell++] = run;
+    if (cell == ORIC_TD_CELL_HALF_PERIODS) {
+      uint8_t value = 0;
+      for (int bit = 0; bit < 8; bit++) {
+        value |= (uint8_t)((runs[4 + 2 * bit] == 1) << bit);
+      }
+      out[n++] = value;
+      cell = -1;
+    }
+  }
+  td.port &= ~ORIC_TD_PORT_MOTOR;
+  HOST_CHECK(td.underruns == 0);
+  return n;
+}
+
+// True if the tape inserted at index plays the file name at file
+static bool plays(int index, const char* name, int file) {
+  uint8_t expected[64];
+  const size_t len = tap_file(name, expected);
+  HOST_CHECK(oric_td_insert_tape_sdcard(&td, index));
+  HOST_CHECK(td.num_blocks > file);
+  if (td.num_blocks <= file) {
+    return false;
+  }
+  HOST_CHECK(oric_td_seek_block(&td, file));
+  static uint8_t bytes[4096];
+  const size_t n = play(bytes, sizeof(bytes));
+  // The played tape starts with the leader the converter adds
+  for (size_t i = 0; i + len <= n; i++) {
+    if (memcmp(&bytes[i], expected, len) == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// With no tape inserted a recording goes to f1.tap and loads back
+static void test_save_reload(void) {
+  snprintf(dir, sizeof(dir), "%s", host_card_dir("td_save"));
+  init_td();
+  csave("HELLO");
+  HOST_CHECK(card_has("f1.tap"));
+  HOST_CHECK(plays(0, "HELLO", 0));
+  HOST_CHECK(ff_posix_stats.locked_calls == 0);
+}
+
+// A tape made from fN.tap gets the recording appended, and the stale edge
+// list is dropped so the next insert sees both programs
+static void test_append_tap(void) {
+  snprintf(dir, sizeof(dir), "%s", host_card_dir("td_append"));
+  uint8_t bytes[64];
+  const size_t len = tap_file("FIRST", bytes);
+  HOST_CHECK(host_write_file(card_path("f3.tap"), bytes, len));
+  init_td();
+  HOST_CHECK(oric_td_insert_tape_sdcard(&td, 2));
+  HOST_CHECK(card_has("f3.edg"));
+  csave("SECOND");
+  HOST_CHECK(!card_has("f3.edg"));
+  HOST_CHECK(!card_has("f1.tap"));
+  HOST_CHECK(plays(2, "FIRST", 0));
+  HOST_CHECK(plays(2, "SECOND", 1));
+}
+
+// A PCM capture is left alone, the recording goes to the first free slot
+// and the next one joins it there
+static void test_pcm_source(void) {
+  snprintf(dir, sizeof(dir), "%s", host_card_dir("td_pcm"));
+  uint8_t wav[44 + 4410];
+  memset(wav, 0x80, sizeof(wav));
+  memcpy(wav, "RIFF", 4);
+  const uint32_t riff = sizeof(wav) - 8;
+  memcpy(&wav[4], &riff, 4);
+  memcpy(&wav[8], "WAVEfmt ", 8);
+  const uint8_t fmt[20] = {16, 0,    0, 0, 1, 0, 1, 0, 0x44, 0xAC,
+                           0,  0, 0x44, 0xAC, 0, 0, 1, 0, 8,    0};
+  memcpy(&wav[16], fmt, sizeof(fmt));
+  memcpy(&wav[36], "data", 4);
+  const uint32_t data = sizeof(wav) - 44;
+  memcpy(&wav[40], &data, 4);
+  HOST_CHECK(host_write_file(card_path("f1.wav"), wav, sizeof(wav)));
+  uint8_t bytes[64];
+  const size_t len = tap_file("OTHER", bytes);
+  HOST_CHECK(host_write_file(card_path("f2.tap"), bytes, len));
+
+  init_td();
+  HOST_CHECK(oric_td_insert_tape_sdcard(&td, 0));
+  HOST_CHECK(td.pcm);
+  csave("ONE");
+  csave("TWO");
+  HOST_CHECK(td.pcm && td.sd_file_open);
+  HOST_CHECK(!card_has("f1.tap") && !card_has("f1.edg"));
+  size_t size = 0;
+  uint8_t* kept = host_read_file(card_path("f1.wav"), &size);
+  HOST_CHECK(kept && (size == sizeof(wav)) &&
+             (memcmp(kept, wav, sizeof(wav)) == 0));
+  free(kept);
+  HOST_CHECK(plays(2, "ONE", 0));
+  HOST_CHECK(plays(2, "TWO", 1));
+  HOST_CHECK(plays(1, "OTHER", 0));
+}
+
+int main(void) {
+  test_save_reload();
+  test_append_tap();
+  test_pcm_source();
+  HOST_CHECK(ff_posix_stats.locked_calls == 0);
+  return HOST_RESULT();
+}
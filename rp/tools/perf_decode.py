@@ -0,0 +1,151 @@
+import argparse
+import struct
+
+# Decode the hot path statistics written by perf_dump() (rp/src/perf.c) into
+# a UART capture, and print a summary and a histogram per counter and timer.
+#
+# Build with PERF_MODE=1, capture the UART to a file, press keypad ) on the
+# ST and run:  python3 perf_decode.py --input capture.bin
+
+MAGIC = b"PERF"
+TRAILER = b"FREP"
+SUPPORTED_VERSION = 1
+FRAME_US = 19968  # Length of an emulated frame
+HISTOGRAM_WIDTH = 50
+
+
+def read_binary_from_file(file_path):
+    with open(file_path, "rb") as file:
+        return file.read()
+
+
+def parse_dump(data, start):
+    version, num_counters, num_timers = struct.unpack_from("<BBB", data, start + 4)
+    if version != SUPPORTED_VERSION:
+        raise ValueError(f"Unsupported dump version {version}")
+    clk_hz, total_frames, num_frames = struct.unpack_from("<IIH", data, start + 8)
+    pos = start + 18
+
+    names = []
+    for _ in range(num_counters + num_timers):
+        end = data.index(b"\0", pos)
+        names.append(data[pos:end].decode("ascii"))
+        pos = end + 1
+
+    record = "<" + "H" * num_counters + "I" * num_timers
+    record_size = struct.calcsize(record)
+    if pos + num_frames * record_size + len(TRAILER) > len(data):
+        raise ValueError("Truncated dump")
+    frames = []
+    for _ in range(num_frames):
+        frames.append(struct.unpack_from(record, data, pos))
+        pos += record_size
+    if data[pos : pos + len(TRAILER)] != TRAILER:
+        raise ValueError("Dump trailer not found")
+
+    return {
+        "clk_hz": clk_hz,
+        "total_frames": total_frames,
+        "counters": names[:num_counters],
+        "timers": names[num_counters:],
+        "frames": frames,
+    }
+
+
+def find_dumps(data):
+    # The dumps are mixed with the debug text on the same UART
+    dumps = []
+    start = data.find(MAGIC)
+    while start >= 0:
+        try:
+            dumps.append(parse_dump(data, start))
+        except (ValueError, struct.error) as e:
+            print(f"Skipping dump at offset {start}: {e}")
+        start = data.find(MAGIC, start + 1)
+    return dumps
+
+
+def percentile(sorted_values, pct):
+    index = min(len(sorted_values) - 1, (len(sorted_values) * pct) // 100)
+    return sorted_values[index]
+
+
+def print_histogram(values, bins):
+    low = min(values)
+    high = max(values)
+    if low == high:
+        print(f"    {low:>10}  all {len(values)} frames")
+        return
+    step = (high - low) / bins
+    counts = [0] * bins
+    for v in values:
+        counts[min(bins - 1, int((v - low) / step))] += 1
+    peak = max(counts)
+    for i, count in enumerate(counts):
+        bar = "#" * ((count * HISTOGRAM_WIDTH + peak - 1) // peak)
+        print(f"    {low + i * step:>10.0f}  {count:>4} {bar}")
+
+
+def print_metric(name, values, unit, bins):
+    ordered = sorted(values)
+    mean = sum(values) / len(values)
+    print(
+        f"{name} ({unit}): min {ordered[0]:.0f}  avg {mean:.1f}  "
+        f"p50 {percentile(ordered, 50):.0f}  p95 {percentile(ordered, 95):.0f}  "
+        f"max {ordered[-1]:.0f}"
+    )
+    print_histogram(values, bins)
+    print()
+
+
+def print_dump(dump, bins):
+    frames = dump["frames"]
+    counters = dump["counters"]
+    cycles_per_us = dump["clk_hz"] / 1000000.0
+    print(
+        f"{len(frames)} frames (last of {dump['total_frames']}), "
+        f"clk_sys {dump['clk_hz'] / 1000000.0:.0f} MHz"
+    )
+    print()
+    if not frames:
+        return
+    for i, name in enumerate(counters):
+        print_metric(name, [f[i] for f in frames], "per frame", bins)
+    for i, name in enumerate(dump["timers"]):
+        values = [f[len(counters) + i] / cycles_per_us for f in frames]
+        print_metric(name, values, "us per frame", bins)
+        mean = sum(values) / len(values)
+        print(f"    {name}: {mean * 100.0 / FRAME_US:.1f}% of a {FRAME_US} us frame")
+        print()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Print the hot path statistics dumped by a PERF_MODE build."
+    )
+    parser.add_argument(
+        "--input",
+        required=True,
+        default="",
+        help="Path to the raw UART capture.",
+    )
+    parser.add_argument(
+        "--all",
+        required=False,
+        action="store_true",
+        help="Print every dump found in the capture, not only the last one.",
+    )
+    parser.add_argument(
+        "--bins",
+        required=False,
+        type=int,
+        default=10,
+        help="Number of histogram bins.",
+    )
+
+    args = parser.parse_args()
+    dumps = find_dumps(read_binary_from_file(args.input))
+    if not dumps:
+        print("No dump found")
+    for dump in dumps if args.all else dumps[-1:]:
+        print_dump(dump, args.bins)
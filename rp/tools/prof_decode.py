@@ -0,0 +1,164 @@
+import argparse
+import struct
+
+# Decode the PC profile written by oric_prof_save_sdcard()
+# (rp/src/reload/devices/oric_prof.h) and print the hottest pages, routines
+# and addresses.
+#
+# Build with PROFILE_MODE=1, press Ctrl+keypad * on the ST to start sampling
+# and again to save profile.bin in the app folder, then run:
+#   python3 prof_decode.py --input profile.bin --symbols basic11.sym
+#
+# A symbol file has one "ADDRESS NAME" pair per line, the address in hex with
+# an optional $ or 0x prefix. Lines starting with ; or # are comments. Every
+# sample is charged to the closest symbol at or below its address.
+
+MAGIC = b"OPRF"
+SUPPORTED_VERSION = 1
+HEADER = "<4sBBHII"
+ROM_BASE = 0xC000
+
+
+def read_binary_from_file(file_path):
+    with open(file_path, "rb") as file:
+        return file.read()
+
+
+def parse_profile(data):
+    magic, version, _, interval, samples, dropped = struct.unpack_from(HEADER, data, 0)
+    if magic != MAGIC:
+        raise ValueError("Not an Oric profile")
+    if version != SUPPORTED_VERSION:
+        raise ValueError(f"Unsupported profile version {version}")
+    pos = struct.calcsize(HEADER)
+    pages = struct.unpack_from("<256I", data, pos)
+    pos += 256 * 4
+    (num_addrs,) = struct.unpack_from("<I", data, pos)
+    pos += 4
+    if pos + num_addrs * 6 > len(data):
+        raise ValueError("Truncated profile")
+    addrs = {}
+    for _ in range(num_addrs):
+        addr, count = struct.unpack_from("<HI", data, pos)
+        addrs[addr] = count
+        pos += 6
+    return {
+        "interval": interval,
+        "samples": samples,
+        "dropped": dropped,
+        "pages": pages,
+        "addrs": addrs,
+    }
+
+
+def read_symbols(file_path):
+    symbols = []
+    with open(file_path, "r") as file:
+        for line in file:
+            fields = line.split()
+            if not fields or fields[0][0] in ";#" or len(fields) < 2:
+                continue
+            text = fields[0].lstrip("$")
+            try:
+                addr = int(text, 16)
+            except ValueError:
+                continue
+            symbols.append((addr, fields[1]))
+    symbols.sort()
+    return symbols
+
+
+def find_symbol(symbols, addr):
+    # Binary search for the last symbol at or below addr
+    low, high = 0, len(symbols)
+    while low < high:
+        mid = (low + high) // 2
+        if symbols[mid][0] <= addr:
+            low = mid + 1
+        else:
+            high = mid
+    if low == 0:
+        return None
+    return symbols[low - 1]
+
+
+def percent(count, total):
+    return count * 100.0 / total if total else 0.0
+
+
+def region(addr):
+    # With a Microdisc the ROM may be paged out for the overlay RAM
+    return "ROM/overlay" if addr >= ROM_BASE else "RAM"
+
+
+def print_profile(profile, symbols, top):
+    samples = profile["samples"]
+    print(
+        f"{samples} samples, one every {profile['interval']} instructions, "
+        f"{profile['dropped']} counted by page only"
+    )
+    print()
+    if not samples:
+        return
+
+    print("Hottest pages:")
+    pages = sorted(enumerate(profile["pages"]), key=lambda p: -p[1])
+    for page, count in pages[:top]:
+        if not count:
+            break
+        print(
+            f"  ${page << 8:04X}-${(page << 8) | 0xFF:04X}  {count:>8}  "
+            f"{percent(count, samples):5.1f}%  {region(page << 8)}"
+        )
+    print()
+
+    addrs = profile["addrs"]
+    if symbols:
+        routines = {}
+        for addr, count in addrs.items():
+            symbol = find_symbol(symbols, addr)
+            name = f"${symbol[0]:04X} {symbol[1]}" if symbol else "(no symbol)"
+            routines[name] = routines.get(name, 0) + count
+        print("Hottest routines:")
+        for name, count in sorted(routines.items(), key=lambda r: -r[1])[:top]:
+            print(f"  {count:>8}  {percent(count, samples):5.1f}%  {name}")
+        print()
+
+    print("Hottest addresses:")
+    for addr, count in sorted(addrs.items(), key=lambda a: -a[1])[:top]:
+        symbol = find_symbol(symbols, addr) if symbols else None
+        name = f"{symbol[1]}+{addr - symbol[0]}" if symbol else ""
+        print(
+            f"  ${addr:04X}  {count:>8}  {percent(count, samples):5.1f}%  "
+            f"{region(addr):<11}  {name}"
+        )
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(
+        description="Print the PC profile saved by a PROFILE_MODE build."
+    )
+    parser.add_argument(
+        "--input",
+        required=True,
+        default="",
+        help="Path to profile.bin.",
+    )
+    parser.add_argument(
+        "--symbols",
+        required=False,
+        default="",
+        help="Path to a symbol file of the ROM or the program.",
+    )
+    parser.add_argument(
+        "--top",
+        required=False,
+        type=int,
+        default=20,
+        help="Number of entries printed per table.",
+    )
+
+    args = parser.parse_args()
+    profile = parse_profile(read_binary_from_file(args.input))
+    symbols = read_symbols(args.symbols) if args.symbols else []
+    print_profile(profile, symbols, args.top)